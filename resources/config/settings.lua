@@ -91,6 +91,7 @@ healthBar = {
 
 }
 enemies = {
+	animStorage = "dense", -- "sparse" or "dense". dense only applies to animations listed in the resample table of the model
 	models = {
 		{name = "e1", modelName = "paladin", characterProfile = "profile3"},
 		{name = "e2", modelName = "paladin", characterProfile = "profile3"},
@@ -102,7 +103,31 @@ enemies = {
 }
 
 animation = {
-	blendTime = 0.15 -- seconds
+	blendTime = 0.15, -- seconds
+	-- instances whose animation time falls in the same bucket of this many seconds share one sampled pose. 0 disables sharing
+	poseCacheStep = 0.016
+}
+
+-- threads shared by the parallel stages (IK, cpu skinning)
+workerPool = {
+	-- threads next to the main thread. -1 uses one less than the number of cores, 0 runs everything on the main thread
+	workers = -1
+}
+
+bonePalette = {
+	-- bone matrices all the skinned draws of a frame may use together. The ring holds three frames of them
+	capacity = 16384
+}
+
+renderQueue = {
+	-- instances, model matrix and palette base each, all the draws of a frame may use together. The ring holds three frames of them
+	instanceCapacity = 4096
+}
+
+occlusion = {
+	-- cpu depth buffer the occluder models are rasterized into. 0 disables occlusion culling
+	width = 256,
+	height = 128
 }
 
 
@@ -124,6 +149,8 @@ characterProfiles = {
 				ikType = "local",
 				chainLength = 5,
 				maxTries = 5,
+				solver = "ccd", -- optional. "ccd", "twoBone" or "fabrik". defaults to ccd
+				warmStartDistance = 0.25, -- optional. start from the last solved rotations if the target moved less than this. defaults to 0 (off)
 				position = {x = 0.6, y = 1.3, z = 0.2},
 				speed = 2.0,
 				numSamples = 50,
@@ -162,6 +189,8 @@ characterProfiles = {
 				ikType = "local",
 				chainLength = 2,
 				maxTries = 2,
+				solver = "twoBone",
+				warmStartDistance = 0.25,
 				position = {x = 0.6, y = 1.3, z = 0.2},
 				speed = 1.2,
 				numSamples = 10,
@@ -200,6 +229,8 @@ characterProfiles = {
 				ikType = "local",
 				chainLength = 2,
 				maxTries = 2,
+				solver = "twoBone",
+				warmStartDistance = 0.25,
 				position = {x = 0.6, y = 1.3, z = 0.2},
 				speed = 1.2,
 				numSamples = 10,
@@ -255,11 +286,22 @@ models = {
 		modelDir = "models/battleArena/exported/battleArena2.dae",
 		vertexShader = "skybox",
 		fragmentShader = "skybox",	
+		occluder = true,
+		-- optional. weld duplicate vertices, reorder the triangles for the vertex cache and the vertices for fetching,
+		-- and use 16 bit indices for meshes with fewer than 65536 vertices. Every stage is on unless set to false
+		optimize = {
+			weld = true,
+			vertexCache = true,
+			vertexFetch = true,
+			shortIndices = true
+		}
 	},
 	gate = {
 		modelDir = "models/battleArena/exported/gate.dae",
 		vertexShader = "skybox",
 		fragmentShader = "skybox",	
+		occluder = true,
+		optimize = {}
 	},
 	smallBall = {
 		modelDir = "models/debug/smallBall/smallBall.obj",
@@ -338,9 +380,22 @@ skinnedModels = {
 	},
 	barbarian = {
 		modelDir = "models/barbarian/exported/barbarian7.dae",
-		vertexShader = "skinning",
+		vertexShader = "skinning_3x4",
 		fragmentShader = "texture_d",
 		animationName = "wait", -- default idle animation
+		influenceThreshold = 0.01, -- optional. bone weights below this fraction of the vertex total are dropped
+		optimize = {}, -- optional. same as for the static models
+		-- optional. coarser levels of detail made by edge collapse. A level keeps ratio of the triangles and is drawn
+		-- once the bounds cover less than screenSize of the screen height. The size has to move hysteresis (a fraction)
+		-- past a threshold before the level changes. Needs welded vertices so keep the optimize table
+		lod = {
+			hysteresis = 0.15,
+			levels = {
+				{ratio = 0.5, screenSize = 0.25},
+				{ratio = 0.25, screenSize = 0.12},
+				{ratio = 0.12, screenSize = 0.06}
+			}
+		},
 		additionalAnimations = {
 			{animationName = "dance" , fileDir = "models/barbarian/exported/animations/dance.dae"},
 			{animationName = "run" , fileDir = "models/barbarian/exported/animations/run.dae"},
@@ -352,16 +407,41 @@ skinnedModels = {
 			{animationName = "walkBackward" , fileDir = "models/barbarian/exported/animations/walkBackward.dae"},
 
 		},
+		-- lossy animation compression. keys are dropped and the rest quantized while the error stays below the tolerance
+		-- of their channel (model units for positions, radians for rotations, factor for scales). remove the table to keep the raw keys
+		compression = {
+			position = 0.001,
+			rotation = 0.001,
+			scale = 0.001
+		},
+		-- resample these animations into dense frames for objects sampling with animStorage = "dense".
+		-- framesPerTick is optional, 1 by default. the rate follows the ticks per second of each clip and the collada exports tick once per second.
+		-- leave out the animations list to resample all of them
+		resample = {
+			framesPerTick = 30,
+			animations = {"run", "wait", "lie"}
+		},
 		aabb = {
 			min = {x = -0.5, y = 0.0, z = -0.5},
-			max = {x = 0.5, y = 2.2, z = 0.5}
+			max = {x = 0.5, y = 2.2, z = 0.5},
+			fromPose = false -- optional, off by default. fit the box to the cpu skinned mesh every frame. costs a full cpu skinning pass per character
 		}
 	},
 	paladin = {
 		modelDir = "models/barbarian/exported/paladin/paladin.dae",
-		vertexShader = "skinning",
+		vertexShader = "skinning_3x4",
 		fragmentShader = "texture_d",
 		animationName = "wait", -- default idle animation
+		influenceThreshold = 0.01,
+		optimize = {},
+		lod = {
+			hysteresis = 0.15,
+			levels = {
+				{ratio = 0.5, screenSize = 0.25},
+				{ratio = 0.25, screenSize = 0.12},
+				{ratio = 0.12, screenSize = 0.06}
+			}
+		},
 		additionalAnimations = {
 			{animationName = "dance" , fileDir = "models/barbarian/exported/animations/dance.dae"},
 			{animationName = "run" , fileDir = "models/barbarian/exported/animations/run.dae"},
@@ -373,6 +453,15 @@ skinnedModels = {
 			{animationName = "walkBackward" , fileDir = "models/barbarian/exported/animations/walkBackward.dae"},
 
 		},
+		compression = {
+			position = 0.001,
+			rotation = 0.001,
+			scale = 0.001
+		},
+		resample = {
+			framesPerTick = 30,
+			animations = {"run", "wait", "lie"}
+		},
 		aabb = {
 			min = {x = -0.5, y = 0.0, z = -0.5},
 			max = {x = 0.5, y = 2.2, z = 0.5}
@@ -386,6 +475,11 @@ vertexShaders = {
 	simple =  "shaders/simpleVS.glsl",
 	skinning = "shaders/skinningVS.glsl",
 	phong_skinning = "shaders/phong_skinningVS.glsl",
+	-- compact bone palettes. palette is mat4 (64 bytes a bone) when left out, mat3x4 (48) or dualQuat (32, uniform scale only)
+	skinning_3x4 = {shaderDir = "shaders/skinning_3x4VS.glsl", palette = "mat3x4"},
+	phong_skinning_3x4 = {shaderDir = "shaders/phong_skinning_3x4VS.glsl", palette = "mat3x4"},
+	skinning_dq = {shaderDir = "shaders/skinning_dqVS.glsl", palette = "dualQuat"},
+	phong_skinning_dq = {shaderDir = "shaders/phong_skinning_dqVS.glsl", palette = "dualQuat"},
 	phong = "shaders/phongVS.glsl",
 	skybox = "shaders/skyboxVS.glsl"
 }
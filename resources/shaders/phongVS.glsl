@@ -6,21 +6,38 @@ in vec2 texCoord;
 out vec2 fsTexCoord;
 out vec3 fsNormal;
 out vec3 fsPosition; // in world space
-out vec3 fsViewPos;
 
-layout (location = 0) uniform mat4 M;
-layout (location = 1) uniform mat4 V;
-layout (location = 2) uniform mat4 P;
-//layout (location = 3) uniform vec3 viewPos;
+// camera and time of the frame, written once per frame by FrameConstants
+layout (std140, binding = 0) uniform FrameConstants
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec3 cameraPosition; // world space
+	float time; // seconds
+};
+
+// first instance of the draw. Set per command by StaticBatch, 0 everywhere else
+layout (location = 15) in uint drawInstance;
+
+// per instance data written by RenderQueue
+struct Instance
+{
+	mat4 model;
+	uvec4 palette;
+};
+layout (std430, binding = 1) readonly buffer Instances
+{
+	Instance instances[];
+};
 
 void main()
 {
+	mat4 M = instances[drawInstance + gl_InstanceID].model;
 	vec4 positionWorld = M * vec4(position, 1.0f);
-    gl_Position = P * V * positionWorld;
+    gl_Position = VP * positionWorld;
     fsPosition = vec3(positionWorld);
     
     fsTexCoord = texCoord;
     fsNormal = mat3(transpose(inverse(M))) * normal;
-
-    fsViewPos = V[3].xyz;
 }
\ No newline at end of file
@@ -11,7 +11,6 @@ struct Material
 in vec2 fsTexCoord;
 in vec3 fsNormal;
 in vec3 fsPosition; // in world space
-in vec3 fsViewPos;
 
 out vec4 color;
 
@@ -23,6 +22,16 @@ vec4 lightDiffuse = vec4(0.7f);
 
 uniform Material material;
 
+// camera and time of the frame, written once per frame by FrameConstants
+layout (std140, binding = 0) uniform FrameConstants
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec3 cameraPosition; // world space
+	float time; // seconds
+};
+
 void main()
 {    
     vec4 finalAmbient = material.ambient;
@@ -33,7 +42,7 @@ void main()
 	float diffuse = max(dot(norm, lightDir), 0.0);
     vec4 finalDiffuse = diffuse *  material.diffuse;
 
-    vec3 viewDir = normalize(fsPosition - fsViewPos);
+    vec3 viewDir = normalize(cameraPosition - fsPosition);
     vec3 reflectDir = reflect(-lightDir, norm);
     float specular = pow(max(dot(viewDir,reflectDir), 0.0), material.shininess);
     vec4 finalSpecular = specular * material.specular;
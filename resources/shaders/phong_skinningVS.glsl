@@ -1,33 +1,67 @@
 #version 440
 in vec3 position;
-in vec3 normal;
+in vec2 normalOct; // octahedral encoded normal
 in vec2 texCoord;
 in uvec4 boneIndices;
 in vec4 boneWeights;
 
-layout (location = 0) uniform mat4 M;
-layout (location = 1) uniform mat4 V;
-layout (location = 2) uniform mat4 P;
+// camera and time of the frame, written once per frame by FrameConstants
+layout (std140, binding = 0) uniform FrameConstants
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec3 cameraPosition; // world space
+	float time; // seconds
+};
+
+// per instance data written by RenderQueue. palette.x is the index of the first bone of the instance in BonePalette
+struct Instance
+{
+	mat4 model;
+	uvec4 palette;
+};
+layout (std430, binding = 1) readonly buffer Instances
+{
+	Instance instances[];
+};
 
-uniform mat4 boneTransform[100]; // transforms the vertex from bone space to model space
+// transforms the vertex from bone space to model space. The palettes of every instance in the frame, back to back
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+	mat4 boneTransform[];
+};
 
 out vec2 fsTexCoord;
 out vec3 fsNormal;
 out vec3 fsPosition; // in world space
 
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // unfold the lower hemisphere
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
-    mat4 blendedMatrix =  boneTransform[boneIndices[0]] * boneWeights[0]
-    			     	+ boneTransform[boneIndices[1]] * boneWeights[1]
-    			     	+ boneTransform[boneIndices[2]] * boneWeights[2]
-    			     	+ boneTransform[boneIndices[3]] * boneWeights[3];
+    mat4 M = instances[gl_InstanceID].model;
+    uvec4 bones = boneIndices + uvec4(instances[gl_InstanceID].palette.x);
+    vec3 normal = decodeNormal(normalOct);
+    mat4 blendedMatrix =  boneTransform[bones[0]] * boneWeights[0]
+    			     	+ boneTransform[bones[1]] * boneWeights[1]
+    			     	+ boneTransform[bones[2]] * boneWeights[2]
+    			     	+ boneTransform[bones[3]] * boneWeights[3];
 
     mat4 modelBoneMatrix = M * blendedMatrix;
     vec4 positionWorld = modelBoneMatrix * vec4(position, 1.0f);
-    gl_Position = P * V * positionWorld;
+    gl_Position = VP * positionWorld;
     fsPosition = vec3(positionWorld);
     fsNormal = mat3(transpose(inverse(modelBoneMatrix))) * normal;
     // fsNormal = normal;
-    // gl_Position = P * V * M * vec4(position, 1.0);
+    // gl_Position = VP * M * vec4(position, 1.0);
     fsTexCoord = texCoord;	
 }
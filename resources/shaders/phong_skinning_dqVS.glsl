@@ -0,0 +1,98 @@
+#version 440
+in vec3 position;
+in vec2 normalOct; // octahedral encoded normal
+in vec2 texCoord;
+in uvec4 boneIndices;
+in vec4 boneWeights;
+
+// camera and time of the frame, written once per frame by FrameConstants
+layout (std140, binding = 0) uniform FrameConstants
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec3 cameraPosition; // world space
+	float time; // seconds
+};
+
+// per instance data written by RenderQueue. palette.x is the index of the first bone of the instance in BonePalette
+struct Instance
+{
+	mat4 model;
+	uvec4 palette;
+};
+layout (std430, binding = 1) readonly buffer Instances
+{
+	Instance instances[];
+};
+
+// two entries per bone: the rotation quaternion and (translation, uniform scale) of the bone to model space transform
+layout (std430, binding = 0) readonly buffer BonePalette
+{
+	vec4 boneDualQuat[];
+};
+
+out vec2 fsTexCoord;
+out vec3 fsNormal;
+out vec3 fsPosition; // in world space
+
+vec3 decodeNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // unfold the lower hemisphere
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec4 blendReal;
+vec4 blendDual;
+float blendScale;
+
+void addInfluence(vec4 pivot, uint bone, float weight)
+{
+    vec4 real = boneDualQuat[2 * bone];
+    vec4 translationScale = boneDualQuat[2 * bone + 1];
+    // q and -q are the same rotation. Keep all influences on the side of the first one or the blend takes the long way around
+    if (dot(real, pivot) < 0.0)
+        real = -real;
+    vec3 t = translationScale.xyz;
+    vec4 dual = 0.5 * vec4(real.w * t + cross(t, real.xyz), -dot(t, real.xyz));
+    blendReal += real * weight;
+    blendDual += dual * weight;
+    blendScale += translationScale.w * weight;
+}
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    mat4 M = instances[gl_InstanceID].model;
+    uvec4 bones = boneIndices + uvec4(instances[gl_InstanceID].palette.x);
+    vec3 normal = decodeNormal(normalOct);
+    vec4 pivot = boneDualQuat[2 * bones[0]];
+    blendReal = vec4(0.0);
+    blendDual = vec4(0.0);
+    blendScale = 0.0;
+    addInfluence(pivot, bones[0], boneWeights[0]);
+    addInfluence(pivot, bones[1], boneWeights[1]);
+    addInfluence(pivot, bones[2], boneWeights[2]);
+    addInfluence(pivot, bones[3], boneWeights[3]);
+
+    float len = length(blendReal);
+    vec4 real = blendReal / len;
+    vec4 dual = blendDual / len;
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    vec3 positionModel = rotate(real, position * blendScale) + translation;
+
+    vec4 positionWorld = M * vec4(positionModel, 1.0);
+    gl_Position = VP * positionWorld;
+    fsPosition = vec3(positionWorld);
+    // the bones only rotate and scale uniformly so the normal just has to follow the rotation
+    fsNormal = mat3(transpose(inverse(M))) * rotate(real, normal);
+    fsTexCoord = texCoord;	
+}
\ No newline at end of file
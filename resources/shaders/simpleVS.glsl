@@ -5,12 +5,33 @@ in vec2 texCoord;
 
 out vec2 fsTexCoord;
 
-layout (location = 0) uniform mat4 M;
-layout (location = 1) uniform mat4 V;
-layout (location = 2) uniform mat4 P;
+// camera and time of the frame, written once per frame by FrameConstants
+layout (std140, binding = 0) uniform FrameConstants
+{
+	mat4 V;
+	mat4 P;
+	mat4 VP;
+	vec3 cameraPosition; // world space
+	float time; // seconds
+};
+
+// first instance of the draw. Set per command by StaticBatch, 0 everywhere else
+layout (location = 15) in uint drawInstance;
+
+// per instance data written by RenderQueue
+struct Instance
+{
+	mat4 model;
+	uvec4 palette;
+};
+layout (std430, binding = 1) readonly buffer Instances
+{
+	Instance instances[];
+};
 
 void main()
 {
-    gl_Position = P * V * M * vec4(position, 1.0f);
+    mat4 M = instances[drawInstance + gl_InstanceID].model;
+    gl_Position = VP * M * vec4(position, 1.0f);
     fsTexCoord = texCoord;
 }
\ No newline at end of file
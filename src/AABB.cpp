@@ -2,6 +2,7 @@
 #include "GameWorld.hpp"
 #include "ShaderProgram.hpp"
 #include "ShaderManager.hpp"
+#include "RenderQueue.hpp"
 #include "math_utilities.h"
 
 #include <luapath\luapath.hpp>
@@ -116,6 +117,45 @@ void AABB::transform(const glm::mat4 &modelMatrix)
 
 }
 
+void AABB::fit(const std::vector<glm::vec3> &points)
+{
+	if (points.empty())
+		return;
+	m_Min = points[0];
+	m_Max = points[0];
+	for (unsigned int i = 1; i < points.size(); i++)
+	{
+		const glm::vec3 &point = points[i];
+		if(point.x < m_Min.x) m_Min.x = point.x;
+		if(point.x > m_Max.x) m_Max.x = point.x;
+		if(point.y < m_Min.y) m_Min.y = point.y;
+		if(point.y > m_Max.y) m_Max.y = point.y;
+		if(point.z < m_Min.z) m_Min.z = point.z;
+		if(point.z > m_Max.z) m_Max.z = point.z;
+	}
+	setCubePoints();
+
+	//the display box was built from the initial bounds. Map them onto the new ones
+	glm::vec3 initialSize = m_InitialMax - m_InitialMin;
+	glm::vec3 scale(1.0f);
+	for (int i = 0; i < 3; i++)
+		if (initialSize[i] > 0.0f)
+			scale[i] = (m_Max[i] - m_Min[i]) / initialSize[i];
+	m_ModelMatrix = glm::translate(glm::mat4(), m_Min) * glm::scale(glm::mat4(), scale) * glm::translate(glm::mat4(), -m_InitialMin);
+}
+
+void AABB::setCubePoints()
+{
+	m_CubePoints.resize(8);
+	m_CubePoints[0] = m_Min;
+	m_CubePoints[1] = glm::vec3(m_Max.x, m_Min.y, m_Min.z);
+	m_CubePoints[2] = glm::vec3(m_Max.x, m_Min.y, m_Max.z);
+	m_CubePoints[3] = glm::vec3(m_Min.x, m_Min.y, m_Max.z);
+	m_CubePoints[4] = glm::vec3(m_Min.x, m_Max.y, m_Max.z);
+	m_CubePoints[5] = glm::vec3(m_Min.x, m_Max.y, m_Min.z);
+	m_CubePoints[6] = glm::vec3(m_Max.x, m_Max.y, m_Min.z);
+	m_CubePoints[7] = m_Max;
+}
 
 void AABB::generateDisplayBox()
 {
@@ -132,15 +172,7 @@ void AABB::generateDisplayBox()
 	m_InitialMax = m_Max;
 	
 	m_Display = isEnabled;
-	m_CubePoints.resize(8);
-	m_CubePoints[0] = m_Min;
-	m_CubePoints[1] = glm::vec3(m_Max.x, m_Min.y, m_Min.z);
-	m_CubePoints[2] = glm::vec3(m_Max.x, m_Min.y, m_Max.z);
-	m_CubePoints[3] = glm::vec3(m_Min.x, m_Min.y, m_Max.z);
-	m_CubePoints[4] = glm::vec3(m_Min.x, m_Max.y, m_Max.z);
-	m_CubePoints[5] = glm::vec3(m_Min.x, m_Max.y, m_Min.z);
-	m_CubePoints[6] = glm::vec3(m_Max.x, m_Max.y, m_Min.z);
-	m_CubePoints[7] = m_Max;
+	setCubePoints();
 	m_InitialCubePoints = m_CubePoints;
 	m_LastPoint = m_CubePoints[0];
 
@@ -199,11 +231,7 @@ void AABB::render()
 {
 	if(m_Display)
 	{
-		glUseProgram(m_Shader->m_Id);
-		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(m_ModelMatrix)); 
-		glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getViewMatrix())); 
-		glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getProjectionMatrix()));
-		m_CubeMesh.render(m_Shader, GL_LINES, false);
+		RenderQueue::get().drawImmediate(&m_CubeMesh, m_Shader, m_ModelMatrix, GL_LINES, false);
 	}
 }
 
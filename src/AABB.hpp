@@ -19,6 +19,8 @@ public:
 	void render();
 	void generateDisplayBox();
 	void transform(const glm::mat4 &modelMatrix);
+	/**@brief Set the bounds to enclose @param points which are already in world space. The display box is stretched to follow*/
+	void fit(const std::vector<glm::vec3> &points);
 public:
 	bool m_Enabled;
 	bool m_Display;
@@ -33,5 +35,7 @@ public:
 	Mesh m_CubeMesh;
 	glm::mat4 m_ModelMatrix;
 private:
+	/**@brief Put the 8 corners of m_Min, m_Max in m_CubePoints*/
+	void setCubePoints();
 
 };
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include <algorithm>
+
 BoneAnim::BoneAnim()
 {
 
@@ -43,110 +45,750 @@ BoneAnim::BoneAnim(const aiNodeAnim *boneAnim)
 	}
 }
 
+Animation::Animation()
+	:m_Compressed(false)
+{
+
+}
+
 Animation::~Animation()
 {
-	std::map<unsigned int, BoneAnim*>::iterator it = m_BoneAnim.begin();
-	for (; it != m_BoneAnim.end(); ++it)
-		delete it->second;
+
+}
+
+static void storeBone(BoneArray<SQTTransform> &pose, unsigned int bone, const SQTTransform &transform)
+{
+	pose[bone] = transform;
+}
+
+static void storeBone(PoseBuffer &pose, unsigned int bone, const SQTTransform &transform)
+{
+	pose.setBone(bone, transform);
+}
+
+/**@brief Samples every bone of @param clip into @param pose. Works for both AnimClip and CompressedClip and both pose types*/
+template <typename ClipType, typename PoseType>
+static void samplePose(const ClipType &clip, double expiredTicks, PoseType &pose, AnimCursor *cursor)
+{
+	//bones are visited in the order they are laid out in the clip
+	for(unsigned int i = 0 ; i < clip.m_NumBones; i++)
+	{
+		//without a cursor every channel starts the search from the first key
+		unsigned int scaleKey = 0, positionKey = 0, rotationKey = 0;
+		unsigned int &scaleCursor = cursor ? cursor->m_ScaleKeys[i] : scaleKey;
+		unsigned int &positionCursor = cursor ? cursor->m_PositionKeys[i] : positionKey;
+		unsigned int &rotationCursor = cursor ? cursor->m_RotationKeys[i] : rotationKey;
+
+		glm::vec3 resultScale = clip.sampleScale(i, expiredTicks, scaleCursor);
+		glm::vec3 resultPosition = clip.samplePosition(i, expiredTicks, positionCursor);
+		glm::quat resultRotation = clip.sampleRotation(i, expiredTicks, rotationCursor);
+
+		storeBone(pose, i, SQTTransform(resultPosition,resultScale,resultRotation));
+	}
 }
 
-bool Animation::getTransforms(double deltaTime,	std::map<unsigned int, SQTTransform> &boneLocalTransforms) const
+bool Animation::getTransforms(double deltaTime,	BoneArray<SQTTransform> &boneLocalTransforms, AnimCursor *cursor, AnimStorage storage) const
 {
-	//boneLocalTransforms.resize(m_NumBones);
 	//see if reached the end of the animation
 	double leftover = deltaTime - m_TotalDuration;
 	//upper bound of ticks is the total ticks
 	double expiredTicks = fmod(deltaTime*m_TicksPerSecond, m_TotalTicks);
 
-	for(int i = 0 ; i < m_NumBones; i++)
+	if(storage == AnimStorage::DENSE && hasDenseClip())
 	{
-		glm::vec3 resultScale = m_BoneAnim.at(i)->interpolateScale(expiredTicks);
-		glm::vec3 resultPosition = m_BoneAnim.at(i)->interpolatePosition(expiredTicks);
-		glm::quat resultRotation = m_BoneAnim.at(i)->interpolateRotation(expiredTicks);
+		m_DenseClip.samplePose(expiredTicks, boneLocalTransforms);
+		return leftover > 0;
+	}
 
-		SQTTransform resultTransform(resultPosition,resultScale,resultRotation);
-		boneLocalTransforms[i] = resultTransform;
+	if(cursor && cursor->m_Anim != this)
+		cursor->reset(this);
+
+	boneLocalTransforms.resize(m_NumBones);
+	if(m_Compressed)
+		samplePose(m_CompressedClip, expiredTicks, boneLocalTransforms, cursor);
+	else
+		samplePose(m_Clip, expiredTicks, boneLocalTransforms, cursor);
 
-	}
 	if(leftover > 0)
 		return true;
 	return false;
 }
 
-glm::vec3 BoneAnim::interpolateScale(double expiredTicks) const
+bool Animation::getTransforms(double deltaTime, PoseBuffer &pose, AnimCursor *cursor, AnimStorage storage) const
+{
+	double leftover = deltaTime - m_TotalDuration;
+	double expiredTicks = fmod(deltaTime*m_TicksPerSecond, m_TotalTicks);
+
+	if(storage == AnimStorage::DENSE && hasDenseClip())
+	{
+		m_DenseClip.samplePose(expiredTicks, pose);
+		return leftover > 0;
+	}
+
+	if(cursor && cursor->m_Anim != this)
+		cursor->reset(this);
+
+	pose.resize(m_NumBones);
+	if(m_Compressed)
+		samplePose(m_CompressedClip, expiredTicks, pose, cursor);
+	else
+		samplePose(m_Clip, expiredTicks, pose, cursor);
+
+	return leftover > 0;
+}
+
+void Animation::compress(const CompressionTolerance &tolerance)
+{
+	m_CompressedClip.compress(m_Clip, m_TotalTicks, tolerance);
+	m_Compressed = true;
+	//release the uncompressed keys
+	m_Clip.clear();
+}
+
+size_t Animation::getMemorySize() const
+{
+	return m_Compressed ? m_CompressedClip.getMemorySize() : m_Clip.getMemorySize();
+}
+
+void Animation::resample(unsigned int framesPerTick)
+{
+	if(framesPerTick == 0 || m_TotalTicks <= 0)
+		return;
+	//evenly spaced frames with the last one landing exactly on the end of the animation
+	unsigned int numFrames = (unsigned int)ceil(m_TotalTicks * framesPerTick) + 1;
+	m_DenseClip.m_NumBones = m_NumBones;
+	m_DenseClip.m_NumFrames = numFrames;
+	m_DenseClip.m_Stride = PoseBuffer::getStride(m_NumBones);
+	m_DenseClip.m_FramesPerTick = (numFrames - 1) / m_TotalTicks;
+	unsigned int frameSize = PoseBuffer::NUM_COMPONENTS * m_DenseClip.m_Stride;
+	m_DenseClip.m_Frames.resize(numFrames * frameSize);
+
+	AnimCursor cursor;
+	cursor.reset(this);
+	PoseBuffer pose;
+	pose.resize(m_NumBones);
+	for(unsigned int frame = 0; frame < numFrames; frame++)
+	{
+		double ticks = frame / (double)m_DenseClip.m_FramesPerTick;
+		if(m_Compressed)
+			samplePose(m_CompressedClip, ticks, pose, &cursor);
+		else
+			samplePose(m_Clip, ticks, pose, &cursor);
+		std::copy(pose.m_Data.begin(), pose.m_Data.end(), m_DenseClip.m_Frames.begin() + frame * frameSize);
+	}
+}
+
+bool Animation::hasDenseClip() const
 {
-	if(m_NumScaleKeys == 0)
-		return glm::vec3(); // return identity
-	else if(m_NumScaleKeys == 1)
-		return m_ScaleKeys.at(0).m_Value;
-	//else interpolate
-	//find the two closest keys
-	ScaleKey leftKey, rightKey;
-	//find left key
-	for(int i = 0; i < m_NumScaleKeys - 1; i++)
-	{//search as long as the expired time is less than the next key
-		if(expiredTicks < m_ScaleKeys.at(i+1).m_Time)
+	return m_DenseClip.m_NumFrames > 0;
+}
+
+//how many keys a cursor may walk forward before it is cheaper to just binary search
+static const unsigned int MAX_CURSOR_STEPS = 4;
+
+/**@brief Finds the left key of the pair of keys surrounding @param expiredTicks. The right key is always the one after it.
+	@details Walks forward from @param cursor which is the common case during playback. If the time went backwards (loop or seek)
+	or is too far ahead it binary searches the whole channel instead. Needs at least 2 keys.
+*/
+template <typename TimeType>
+static unsigned int findLeftKey(const TimeType *times, unsigned int numKeys, double expiredTicks, unsigned int cursor)
+{
+	unsigned int lastPair = numKeys - 2;
+	if(cursor > lastPair)
+		cursor = lastPair;
+	if(expiredTicks >= times[cursor])
+	{
+		for(unsigned int step = 0; step < MAX_CURSOR_STEPS; step++)
 		{
-			leftKey = m_ScaleKeys.at(i);
-			rightKey = m_ScaleKeys.at(i+1);
-			break;
+			if(cursor == lastPair || expiredTicks < times[cursor + 1])
+				return cursor;
+			cursor++;
 		}
 	}
-	double diff = rightKey.m_Time - leftKey.m_Time;
-	double factor = (expiredTicks - leftKey.m_Time)/ diff; // the weighting factor
-	//linear interpolation
-	return glm::vec3(1 - factor)*leftKey.m_Value + glm::vec3(factor)*rightKey.m_Value;
+	//the last key whose time is not after the expired ticks
+	unsigned int low = 0;
+	unsigned int high = lastPair;
+	while(low < high)
+	{
+		unsigned int mid = (low + high + 1) / 2;
+		if(times[mid] <= expiredTicks)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return low;
 }
 
-glm::vec3 BoneAnim::interpolatePosition(double expiredTicks) const
+/**@brief the weighting factor between two keys. Clamped so we never extrapolate past the first or the last key*/
+static float keyFactor(double leftTime, double rightTime, double expiredTicks)
 {
-	if(m_NumPositionKeys == 0)
-		return glm::vec3(); // return identity
-	else if(m_NumPositionKeys == 1)
-		return m_PositionKeys.at(0).m_Value;
-	
-	PositionKey leftKey, rightKey;
-	//find left key
-	for(int i = 0; i < m_NumPositionKeys - 1; i++)
-	{//search as long as the expired time is less than the next key
-		if(expiredTicks < m_PositionKeys.at(i+1).m_Time)
+	double diff = rightTime - leftTime;
+	if(diff <= 0)
+		return 0.0f;
+	double factor = (expiredTicks - leftTime) / diff;
+	if(factor < 0) factor = 0;
+	if(factor > 1) factor = 1;
+	return (float)factor;
+}
+
+/**@brief Appends the keys of a single channel to the back of the clip arrays.
+	@details Channels without keys get a single key holding @param bindValue so sampling never has to special case them
+*/
+template <typename KeyType, typename ValueType>
+static AnimClip::Channel appendChannel(const std::vector<KeyType> *keys, const ValueType &bindValue,
+	std::vector<float> &times, std::vector<ValueType> &values)
+{
+	AnimClip::Channel channel;
+	channel.m_First = times.size();
+	if(keys && keys->size())
+	{
+		for(unsigned int i = 0; i < keys->size(); i++)
 		{
-			leftKey = m_PositionKeys.at(i);
-			rightKey = m_PositionKeys.at(i+1);
-			break;
+			times.push_back((float)(*keys)[i].m_Time);
+			values.push_back((*keys)[i].m_Value);
 		}
 	}
-	double diff = rightKey.m_Time - leftKey.m_Time;
-	double factor = (expiredTicks - leftKey.m_Time)/ diff; // the weighting factor
-	return glm::vec3(1 - factor)*leftKey.m_Value + glm::vec3(factor)*rightKey.m_Value;
+	else
+	{
+		times.push_back(0.0f);
+		values.push_back(bindValue);
+	}
+	channel.m_Count = times.size() - channel.m_First;
+	return channel;
+}
+
+AnimClip::AnimClip()
+	:m_NumBones(0)
+{
+
+}
+
+void AnimClip::compile(const std::vector<const BoneAnim*> &boneAnims, const BoneArray<SQTTransform> &bindPose)
+{
+	m_NumBones = boneAnims.size();
+	m_ScaleChannels.resize(m_NumBones);
+	m_PositionChannels.resize(m_NumBones);
+	m_RotationChannels.resize(m_NumBones);
+
+	//size the arrays up front so they are allocated once
+	unsigned int numScaleKeys = 0, numPositionKeys = 0, numRotationKeys = 0;
+	for(unsigned int i = 0; i < m_NumBones; i++)
+	{
+		const BoneAnim *boneAnim = boneAnims[i];
+		numScaleKeys += boneAnim && boneAnim->m_NumScaleKeys ? boneAnim->m_NumScaleKeys : 1;
+		numPositionKeys += boneAnim && boneAnim->m_NumPositionKeys ? boneAnim->m_NumPositionKeys : 1;
+		numRotationKeys += boneAnim && boneAnim->m_NumRotationKeys ? boneAnim->m_NumRotationKeys : 1;
+	}
+	m_ScaleTimes.reserve(numScaleKeys);
+	m_ScaleValues.reserve(numScaleKeys);
+	m_PositionTimes.reserve(numPositionKeys);
+	m_PositionValues.reserve(numPositionKeys);
+	m_RotationTimes.reserve(numRotationKeys);
+	m_RotationValues.reserve(numRotationKeys);
+
+	for(unsigned int i = 0; i < m_NumBones; i++)
+	{
+		const BoneAnim *boneAnim = boneAnims[i];
+		SQTTransform bind;
+		if(i < bindPose.size())
+			bind = bindPose[i];
+
+		m_ScaleChannels[i] = appendChannel(boneAnim ? &boneAnim->m_ScaleKeys : NULL, bind.getScale(), m_ScaleTimes, m_ScaleValues);
+		m_PositionChannels[i] = appendChannel(boneAnim ? &boneAnim->m_PositionKeys : NULL, bind.getPosition(), m_PositionTimes, m_PositionValues);
+		m_RotationChannels[i] = appendChannel(boneAnim ? &boneAnim->m_RotationKeys : NULL, bind.getOrientation(), m_RotationTimes, m_RotationValues);
+	}
+}
+
+glm::vec3 AnimClip::sampleScale(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const Channel &channel = m_ScaleChannels[bone];
+	const glm::vec3 *values = &m_ScaleValues[channel.m_First];
+	if(channel.m_Count == 1)
+		return values[0];
+	//else interpolate between the two closest keys
+	const float *times = &m_ScaleTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, expiredTicks, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], expiredTicks);
+	//linear interpolation
+	return glm::vec3(1 - factor)*values[cursor] + glm::vec3(factor)*values[cursor + 1];
+}
+
+glm::vec3 AnimClip::samplePosition(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const Channel &channel = m_PositionChannels[bone];
+	const glm::vec3 *values = &m_PositionValues[channel.m_First];
+	if(channel.m_Count == 1)
+		return values[0];
+
+	const float *times = &m_PositionTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, expiredTicks, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], expiredTicks);
+	return glm::vec3(1 - factor)*values[cursor] + glm::vec3(factor)*values[cursor + 1];
+}
+
+glm::quat AnimClip::sampleRotation(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const Channel &channel = m_RotationChannels[bone];
+	const glm::quat *values = &m_RotationValues[channel.m_First];
+	if(channel.m_Count == 1)
+		return values[0];
+
+	const float *times = &m_RotationTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, expiredTicks, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], expiredTicks);
+	////slerpy derpy
+	return glm::slerp(values[cursor], values[cursor + 1], factor);
+}
+
+size_t AnimClip::getMemorySize() const
+{
+	return (m_ScaleChannels.size() + m_PositionChannels.size() + m_RotationChannels.size()) * sizeof(Channel)
+		+ (m_ScaleTimes.size() + m_PositionTimes.size() + m_RotationTimes.size()) * sizeof(float)
+		+ (m_ScaleValues.size() + m_PositionValues.size()) * sizeof(glm::vec3)
+		+ m_RotationValues.size() * sizeof(glm::quat);
+}
+
+void AnimClip::clear()
+{
+	m_NumBones = 0;
+	//swap with empty vectors so the memory is actually released
+	std::vector<Channel>().swap(m_ScaleChannels);
+	std::vector<Channel>().swap(m_PositionChannels);
+	std::vector<Channel>().swap(m_RotationChannels);
+	std::vector<float>().swap(m_ScaleTimes);
+	std::vector<glm::vec3>().swap(m_ScaleValues);
+	std::vector<float>().swap(m_PositionTimes);
+	std::vector<glm::vec3>().swap(m_PositionValues);
+	std::vector<float>().swap(m_RotationTimes);
+	std::vector<glm::quat>().swap(m_RotationValues);
+}
+
+static const float QUAT_COMPONENT_RANGE = 0.70710678f; //!< components other than the largest are within +- 1/sqrt(2)
+static const float MAX_15BIT = 32767.0f;
+static const float MAX_16BIT = 65535.0f;
+static const double MAX_32BIT = 4294967295.0;
+//the three stored components of a packed rotation are off by up to half a step each and the rebuilt largest one, which is at least 0.5,
+//by up to 3 * sqrt(2) times that. the angle is at most twice the length of the difference
+static const float ROTATION_QUANTIZATION_ERROR = 2.0f * sqrt(21.0f) * QUAT_COMPONENT_RANGE / MAX_15BIT;
+
+static glm::vec3 interpolateKey(const glm::vec3 &left, const glm::vec3 &right, float factor)
+{
+	return glm::vec3(1 - factor)*left + glm::vec3(factor)*right;
+}
+
+static glm::quat interpolateKey(const glm::quat &left, const glm::quat &right, float factor)
+{
+	return glm::slerp(left, right, factor);
+}
+
+static float keyError(const glm::vec3 &a, const glm::vec3 &b)
+{
+	return glm::length(a - b);
+}
+
+/**@brief the angle between two rotations in radians*/
+static float keyError(const glm::quat &a, const glm::quat &b)
+{
+	float cosHalfAngle = fabs(glm::dot(a, b));
+	if(cosHalfAngle >= 1.0f)
+		return 0.0f;
+	return 2.0f * acos(cosHalfAngle);
 }
 
-glm::quat BoneAnim::interpolateRotation(double expiredTicks) const
+/**@brief Picks the keys of a channel that have to stay so every dropped key can be rebuilt by interpolation within @param tolerance.
+	@details Greedy: grows the span from the last kept key for as long as all the keys inside it are still close enough to the interpolated value
+*/
+template <typename ValueType>
+static void reduceKeys(const float *times, const ValueType *values, unsigned int numKeys, float tolerance, std::vector<unsigned int> &kept)
 {
-	if(m_NumRotationKeys == 0)
-		return glm::quat(); // return identity
-	else if(m_NumRotationKeys == 1)
-		return m_RotationKeys.at(0).m_Value;
+	kept.clear();
+	kept.push_back(0);
+	//constant channels collapse to a single key
+	bool constant = true;
+	for(unsigned int i = 1; i < numKeys && constant; i++)
+		constant = keyError(values[0], values[i]) <= tolerance;
+	if(constant)
+		return;
 
-	
-	RotationKey leftKey, rightKey;
-	//find left key
-	for(int i = 0; i < m_NumRotationKeys - 1; i++)
-	{//search as long as the expired time is less than the next key
-		if(expiredTicks < m_RotationKeys.at(i+1).m_Time)
+	unsigned int left = 0;
+	for(unsigned int right = 2; right < numKeys; right++)
+	{
+		bool fits = true;
+		for(unsigned int i = left + 1; i < right && fits; i++)
+		{
+			float factor = keyFactor(times[left], times[right], times[i]);
+			fits = keyError(interpolateKey(values[left], values[right], factor), values[i]) <= tolerance;
+		}
+		if(!fits)
 		{
-			leftKey = m_RotationKeys.at(i);
-			rightKey = m_RotationKeys.at(i+1);
-			break;
+			left = right - 1;
+			kept.push_back(left);
 		}
 	}
-	double diff = rightKey.m_Time - leftKey.m_Time;
-	float factor = (expiredTicks - leftKey.m_Time)/ diff; // the weighting factor
-	////slerpy derpy
-	glm::quat result = glm::slerp(leftKey.m_Value, rightKey.m_Value, factor);
+	kept.push_back(numKeys - 1);
+}
+
+/**@brief The largest change per tick between two keys of a channel. Rounding the key times moves the values by up to this much per tick*/
+template <typename ValueType>
+static float maxKeySpeed(const float *times, const ValueType *values, unsigned int numKeys)
+{
+	float speed = 0;
+	for(unsigned int i = 1; i < numKeys; i++)
+	{
+		float duration = times[i] - times[i - 1];
+		if(duration > 0)
+			speed = std::max(speed, keyError(values[i - 1], values[i]) / duration);
+	}
+	return speed;
+}
+
+static unsigned short quantizeTime(float time, float ticksPerStep)
+{
+	float step = floor(time / ticksPerStep + 0.5f);
+	if(step < 0) step = 0;
+	if(step > MAX_16BIT) step = MAX_16BIT;
+	return (unsigned short)step;
+}
+
+static PackedVec3 packVec3(const glm::vec3 &value, const glm::vec3 &min, const glm::vec3 &extent)
+{
+	PackedVec3 result;
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		float normalized = extent[i] > 0 ? (value[i] - min[i]) / extent[i] : 0.0f;
+		normalized = glm::clamp(normalized, 0.0f, 1.0f);
+		result.m_Data[i] = (unsigned short)floor(normalized * MAX_16BIT + 0.5f);
+	}
+	return result;
+}
+
+static glm::vec3 unpackVec3(const PackedVec3 &value, const glm::vec3 &min, const glm::vec3 &extent)
+{
+	return min + extent * glm::vec3(value.m_Data[0], value.m_Data[1], value.m_Data[2]) * (1.0f / MAX_16BIT);
+}
+
+/**@brief 32 bit version of packVec3. The high halves go to @param high and the low ones to @param low*/
+static void packVec3Wide(const glm::vec3 &value, const glm::vec3 &min, const glm::vec3 &extent, PackedVec3 &high, PackedVec3 &low)
+{
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		double normalized = extent[i] > 0 ? ((double)value[i] - min[i]) / extent[i] : 0.0;
+		normalized = glm::clamp(normalized, 0.0, 1.0);
+		unsigned int packed = (unsigned int)floor(normalized * MAX_32BIT + 0.5);
+		high.m_Data[i] = (unsigned short)(packed >> 16);
+		low.m_Data[i] = (unsigned short)(packed & 0xffff);
+	}
+}
+
+static glm::vec3 unpackVec3Wide(const PackedVec3 &high, const PackedVec3 &low, const glm::vec3 &min, const glm::vec3 &extent)
+{
+	glm::vec3 result;
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		unsigned int packed = ((unsigned int)high.m_Data[i] << 16) | low.m_Data[i];
+		result[i] = min[i] + extent[i] * (float)(packed / MAX_32BIT);
+	}
 	return result;
 }
 
+/**@brief The value of @param key of a scale or position channel whose values start at @param values*/
+static glm::vec3 unpackKey(const CompressedClip::RangedChannel &channel, const PackedVec3 *values, unsigned int key)
+{
+	if(channel.m_Wide)
+		return unpackVec3Wide(values[2 * key], values[2 * key + 1], channel.m_Min, channel.m_Extent);
+	return unpackVec3(values[key], channel.m_Min, channel.m_Extent);
+}
+
+static PackedQuat packQuat(const glm::quat &rotation)
+{
+	glm::quat q = glm::normalize(rotation);
+	float components[4] = {q.x, q.y, q.z, q.w};
+	unsigned int largest = 0;
+	for(unsigned int i = 1; i < 4; i++)
+	{
+		if(fabs(components[i]) > fabs(components[largest]))
+			largest = i;
+	}
+	//q and -q are the same rotation so flip it to make the dropped component positive
+	float sign = components[largest] < 0 ? -1.0f : 1.0f;
+
+	PackedQuat result;
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		if(i == largest)
+			continue;
+		float normalized = (components[i] * sign / QUAT_COMPONENT_RANGE) * 0.5f + 0.5f;
+		normalized = glm::clamp(normalized, 0.0f, 1.0f);
+		result.m_Data[j++] = (unsigned short)floor(normalized * MAX_15BIT + 0.5f);
+	}
+	result.m_Data[0] |= (largest & 1) << 15;
+	result.m_Data[1] |= (largest >> 1) << 15;
+	return result;
+}
+
+static glm::quat unpackQuat(const PackedQuat &rotation)
+{
+	unsigned int largest = (rotation.m_Data[0] >> 15) | ((rotation.m_Data[1] >> 15) << 1);
+	float components[4];
+	float sumSquares = 0;
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		if(i == largest)
+			continue;
+		float normalized = (rotation.m_Data[j++] & 0x7fff) / MAX_15BIT;
+		components[i] = (normalized * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+		sumSquares += components[i] * components[i];
+	}
+	float largestSquared = 1.0f - sumSquares;
+	components[largest] = largestSquared > 0 ? sqrt(largestSquared) : 0.0f;
+	return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+/**@brief Reduce and quantize a single scale or position channel
+	@details Interpolating the packed keys is off from interpolating the exact ones by at most the rounding of the values and the times,
+	so the keys are dropped against what is left of @param tolerance after that. Values take 32 bits when 16 would leave less than half of it
+*/
+static CompressedClip::RangedChannel compressChannel(const float *times, const glm::vec3 *values, unsigned int numKeys, float tolerance, float ticksPerStep,
+	std::vector<unsigned short> &resultTimes, std::vector<PackedVec3> &resultValues)
+{
+	//the range of all the keys bounds the range of the kept ones and so the rounding of their values
+	glm::vec3 min = values[0], max = values[0];
+	for(unsigned int i = 1; i < numKeys; i++)
+	{
+		min = glm::min(min, values[i]);
+		max = glm::max(max, values[i]);
+	}
+	float timeError = maxKeySpeed(times, values, numKeys) * 0.5f * ticksPerStep;
+	float valueError = 0.5f * glm::length(max - min) / MAX_16BIT;
+	bool wide = timeError + valueError > 0.5f * tolerance;
+	if(wide)
+		valueError = 0.5f * glm::length(max - min) / (float)MAX_32BIT;
+
+	std::vector<unsigned int> kept;
+	reduceKeys(times, values, numKeys, std::max(tolerance - timeError - valueError, 0.0f), kept);
+
+	CompressedClip::RangedChannel channel;
+	channel.m_First = resultTimes.size();
+	channel.m_Count = kept.size();
+	channel.m_FirstValue = resultValues.size();
+	channel.m_Wide = wide;
+	max = values[kept[0]];
+	channel.m_Min = values[kept[0]];
+	for(unsigned int i = 1; i < kept.size(); i++)
+	{
+		channel.m_Min = glm::min(channel.m_Min, values[kept[i]]);
+		max = glm::max(max, values[kept[i]]);
+	}
+	channel.m_Extent = max - channel.m_Min;
+
+	for(unsigned int i = 0; i < kept.size(); i++)
+	{
+		resultTimes.push_back(quantizeTime(times[kept[i]], ticksPerStep));
+		if(wide)
+		{
+			PackedVec3 high, low;
+			packVec3Wide(values[kept[i]], channel.m_Min, channel.m_Extent, high, low);
+			resultValues.push_back(high);
+			resultValues.push_back(low);
+		}
+		else
+			resultValues.push_back(packVec3(values[kept[i]], channel.m_Min, channel.m_Extent));
+	}
+	return channel;
+}
+
+/**@brief Reduce and quantize a single rotation channel. Same bound as the scale and position channels with the fixed rounding of PackedQuat.
+	@details A @param tolerance below ROTATION_QUANTIZATION_ERROR keeps every key that is not exactly on the way between its neighbours
+	and cannot be met
+*/
+static AnimClip::Channel compressChannel(const float *times, const glm::quat *values, unsigned int numKeys, float tolerance, float ticksPerStep,
+	std::vector<unsigned short> &resultTimes, std::vector<PackedQuat> &resultValues)
+{
+	float timeError = maxKeySpeed(times, values, numKeys) * 0.5f * ticksPerStep;
+	std::vector<unsigned int> kept;
+	reduceKeys(times, values, numKeys, std::max(tolerance - timeError - ROTATION_QUANTIZATION_ERROR, 0.0f), kept);
+
+	AnimClip::Channel channel;
+	channel.m_First = resultTimes.size();
+	channel.m_Count = kept.size();
+	for(unsigned int i = 0; i < kept.size(); i++)
+	{
+		resultTimes.push_back(quantizeTime(times[kept[i]], ticksPerStep));
+		resultValues.push_back(packQuat(values[kept[i]]));
+	}
+	return channel;
+}
+
+CompressionTolerance::CompressionTolerance()
+	:m_Position(0), m_Rotation(0), m_Scale(0)
+{
+
+}
+
+bool CompressionTolerance::isEnabled() const
+{
+	return m_Position > 0 || m_Rotation > 0 || m_Scale > 0;
+}
+
+CompressedClip::CompressedClip()
+	:m_NumBones(0), m_TicksPerStep(1.0f)
+{
+
+}
+
+void CompressedClip::compress(const AnimClip &clip, float totalTicks, const CompressionTolerance &tolerance)
+{
+	m_NumBones = clip.m_NumBones;
+	m_TicksPerStep = totalTicks > 0 ? totalTicks / MAX_16BIT : 1.0f;
+	m_ScaleChannels.resize(m_NumBones);
+	m_PositionChannels.resize(m_NumBones);
+	m_RotationChannels.resize(m_NumBones);
+
+	for(unsigned int i = 0; i < m_NumBones; i++)
+	{
+		const AnimClip::Channel &scale = clip.m_ScaleChannels[i];
+		m_ScaleChannels[i] = compressChannel(&clip.m_ScaleTimes[scale.m_First], &clip.m_ScaleValues[scale.m_First], scale.m_Count,
+			tolerance.m_Scale, m_TicksPerStep, m_ScaleTimes, m_ScaleValues);
+
+		const AnimClip::Channel &position = clip.m_PositionChannels[i];
+		m_PositionChannels[i] = compressChannel(&clip.m_PositionTimes[position.m_First], &clip.m_PositionValues[position.m_First], position.m_Count,
+			tolerance.m_Position, m_TicksPerStep, m_PositionTimes, m_PositionValues);
+
+		const AnimClip::Channel &rotation = clip.m_RotationChannels[i];
+		m_RotationChannels[i] = compressChannel(&clip.m_RotationTimes[rotation.m_First], &clip.m_RotationValues[rotation.m_First], rotation.m_Count,
+			tolerance.m_Rotation, m_TicksPerStep, m_RotationTimes, m_RotationValues);
+	}
+}
+
+glm::vec3 CompressedClip::sampleScale(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const RangedChannel &channel = m_ScaleChannels[bone];
+	const PackedVec3 *values = &m_ScaleValues[channel.m_FirstValue];
+	if(channel.m_Count == 1)
+		return unpackKey(channel, values, 0);
+
+	double steps = expiredTicks / m_TicksPerStep;
+	const unsigned short *times = &m_ScaleTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, steps, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], steps);
+	return interpolateKey(unpackKey(channel, values, cursor), unpackKey(channel, values, cursor + 1), factor);
+}
+
+glm::vec3 CompressedClip::samplePosition(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const RangedChannel &channel = m_PositionChannels[bone];
+	const PackedVec3 *values = &m_PositionValues[channel.m_FirstValue];
+	if(channel.m_Count == 1)
+		return unpackKey(channel, values, 0);
+
+	double steps = expiredTicks / m_TicksPerStep;
+	const unsigned short *times = &m_PositionTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, steps, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], steps);
+	return interpolateKey(unpackKey(channel, values, cursor), unpackKey(channel, values, cursor + 1), factor);
+}
+
+glm::quat CompressedClip::sampleRotation(unsigned int bone, double expiredTicks, unsigned int &cursor) const
+{
+	const AnimClip::Channel &channel = m_RotationChannels[bone];
+	const PackedQuat *values = &m_RotationValues[channel.m_First];
+	if(channel.m_Count == 1)
+		return unpackQuat(values[0]);
+
+	double steps = expiredTicks / m_TicksPerStep;
+	const unsigned short *times = &m_RotationTimes[channel.m_First];
+	cursor = findLeftKey(times, channel.m_Count, steps, cursor);
+	float factor = keyFactor(times[cursor], times[cursor + 1], steps);
+	glm::quat left = unpackQuat(values[cursor]);
+	glm::quat right = unpackQuat(values[cursor + 1]);
+	//packing may have flipped one of them to the other hemisphere
+	if(glm::dot(left, right) < 0)
+		right = -right;
+	return glm::slerp(left, right, factor);
+}
+
+size_t CompressedClip::getMemorySize() const
+{
+	return (m_ScaleChannels.size() + m_PositionChannels.size()) * sizeof(RangedChannel)
+		+ m_RotationChannels.size() * sizeof(AnimClip::Channel)
+		+ (m_ScaleTimes.size() + m_PositionTimes.size() + m_RotationTimes.size()) * sizeof(unsigned short)
+		+ (m_ScaleValues.size() + m_PositionValues.size()) * sizeof(PackedVec3)
+		+ m_RotationValues.size() * sizeof(PackedQuat);
+}
+
+DenseClip::DenseClip()
+	:m_NumBones(0), m_NumFrames(0), m_Stride(0), m_FramesPerTick(0)
+{
+
+}
+
+void DenseClip::findFrames(double expiredTicks, unsigned int &frame, unsigned int &nextFrame, float &factor) const
+{
+	double framePosition = expiredTicks * m_FramesPerTick;
+	frame = framePosition > 0 ? (unsigned int)framePosition : 0;
+	if(frame > m_NumFrames - 1)
+		frame = m_NumFrames - 1;
+	nextFrame = frame + 1 < m_NumFrames ? frame + 1 : frame;
+	factor = glm::clamp((float)(framePosition - frame), 0.0f, 1.0f);
+}
+
+void DenseClip::samplePose(double expiredTicks, PoseBuffer &pose) const
+{
+	unsigned int frame, nextFrame;
+	float factor;
+	findFrames(expiredTicks, frame, nextFrame, factor);
+
+	pose.resize(m_NumBones);
+	PoseKernel::get().blend(getFrame(frame), getFrame(nextFrame), factor, &pose.m_Data[0], m_Stride);
+}
+
+void DenseClip::samplePose(double expiredTicks, BoneArray<SQTTransform> &pose) const
+{
+	unsigned int frame, nextFrame;
+	float factor;
+	findFrames(expiredTicks, frame, nextFrame, factor);
+
+	//MAX_BONES is a multiple of the kernel width so it holds the padded stride of any skeleton
+	float blended[PoseBuffer::NUM_COMPONENTS * MAX_BONES];
+	PoseKernel::get().blend(getFrame(frame), getFrame(nextFrame), factor, blended, m_Stride);
+
+	pose.resize(m_NumBones);
+	for(unsigned int i = 0; i < m_NumBones; i++)
+	{
+		const float *data = &blended[i];
+		pose[i] = SQTTransform(glm::vec3(data[PoseBuffer::POSITION_X * m_Stride], data[PoseBuffer::POSITION_Y * m_Stride], data[PoseBuffer::POSITION_Z * m_Stride]),
+			glm::vec3(data[PoseBuffer::SCALE_X * m_Stride], data[PoseBuffer::SCALE_Y * m_Stride], data[PoseBuffer::SCALE_Z * m_Stride]),
+			glm::quat(data[PoseBuffer::ROTATION_W * m_Stride], data[PoseBuffer::ROTATION_X * m_Stride], data[PoseBuffer::ROTATION_Y * m_Stride], data[PoseBuffer::ROTATION_Z * m_Stride]));
+	}
+}
+
+const float* DenseClip::getFrame(unsigned int frame) const
+{
+	return &m_Frames[frame * PoseBuffer::NUM_COMPONENTS * m_Stride];
+}
+
+size_t DenseClip::getMemorySize() const
+{
+	return m_Frames.size() * sizeof(float);
+}
+
+AnimCursor::AnimCursor()
+	:m_Anim(NULL)
+{
+
+}
+
+void AnimCursor::reset(const Animation *anim)
+{
+	m_Anim = anim;
+	unsigned int numBones = anim ? anim->m_NumBones : 0;
+	m_ScaleKeys.assign(numBones, 0);
+	m_PositionKeys.assign(numBones, 0);
+	m_RotationKeys.assign(numBones, 0);
+}
+
 AnimInstance::AnimInstance()
 	:m_Anim(NULL), m_TimeExpired(0)
 {
@@ -156,5 +798,4 @@ AnimInstance::AnimInstance()
 AnimInstance::AnimInstance(const Animation *anim, double timeExpired)
 	:m_Anim(anim), m_TimeExpired(timeExpired)
 {
-}
-
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "stdafx.h"
 #include "SQTTransform.hpp"
+#include "PoseKernel.hpp"
 #include <glm/glm.hpp>
 
 #include <assimp\anim.h>
@@ -26,7 +27,9 @@ struct PositionKey
 	glm::vec3 m_Value;
 };
 
-/**@brief Represents the keyframes for a particular bone */
+/**@brief Represents the keyframes for a particular bone as they come out of assimp.
+	@details Only used while loading. SkinnedModel compiles these into an AnimClip and throws them away
+*/
 struct BoneAnim
 {
 	int m_NumRotationKeys;
@@ -40,16 +43,191 @@ struct BoneAnim
 	BoneAnim();
 	BoneAnim(const aiNodeAnim *boneAnim);
 
-	//@todo consider promoting this logic to Animation class instead
-	glm::vec3 interpolateScale(double expiredTicks) const;
-	glm::vec3 interpolatePosition(double expiredTicks) const;
-	glm::quat interpolateRotation(double expiredTicks) const;
-
 private:
 
 
 };
 
+struct Animation;
+
+/**
+@brief Remembers the last left key of every channel of every bone for a single playing instance
+@details Normal playback only moves forward in time so the next key is almost always the same one or the one after it.
+Each SkinnedObject owns a cursor so the key search starts from where it left off instead of from key 0.
+When the time goes backwards (animation looped or seeked) or jumps too far ahead the search falls back to binary search.
+*/
+struct AnimCursor
+{
+	AnimCursor();
+	/**@brief Point the cursor to @param anim and rewind all the channels to the first key*/
+	void reset(const Animation *anim);
+
+	const Animation *m_Anim; //!< the animation the indices below refer to
+	std::vector<unsigned int> m_ScaleKeys;
+	std::vector<unsigned int> m_PositionKeys;
+	std::vector<unsigned int> m_RotationKeys;
+};
+
+/**
+@brief The compiled keyframes of a single animation
+@details All the channels of the clip live in a handful of contiguous arrays ordered by bone id, with the key times kept apart from the key values.
+Sampling a full pose walks through the bones in order so it streams through memory linearly instead of hopping between
+per bone allocations. Every bone has exactly one channel of each type with at least one key. Bones that were not animated get their bind pose
+*/
+struct AnimClip
+{
+	/**@brief Where the keys of a single channel start in the key arrays and how many there are*/
+	struct Channel
+	{
+		unsigned int m_First;
+		unsigned int m_Count;
+	};
+
+	AnimClip();
+
+	/**@brief Build the clip from the raw assimp keys.
+		@param boneAnims indexed by bone id. NULL for bones the animation does not touch
+		@param bindPose used for the bones (or channels) without keys
+	*/
+	void compile(const std::vector<const BoneAnim*> &boneAnims, const BoneArray<SQTTransform> &bindPose);
+
+	glm::vec3 sampleScale(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+	glm::vec3 samplePosition(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+	glm::quat sampleRotation(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+
+	/**@brief Bytes taken by the keys and channel tables*/
+	size_t getMemorySize() const;
+	/**@brief Release all the keys*/
+	void clear();
+
+	unsigned int m_NumBones;
+	std::vector<Channel> m_ScaleChannels; //!< indexed by bone id
+	std::vector<Channel> m_PositionChannels;
+	std::vector<Channel> m_RotationChannels;
+
+	std::vector<float> m_ScaleTimes; //!< all the scale key times of all the bones back to back
+	std::vector<glm::vec3> m_ScaleValues;
+	std::vector<float> m_PositionTimes;
+	std::vector<glm::vec3> m_PositionValues;
+	std::vector<float> m_RotationTimes;
+	std::vector<glm::quat> m_RotationValues;
+};
+
+/**@brief Smallest three quaternion packed in 48 bits
+	@details The largest component is dropped and rebuilt from the other three when decoding. The other three are stored in 15 bits each
+	and the index of the dropped one goes in the top bit of the first two shorts
+*/
+struct PackedQuat
+{
+	unsigned short m_Data[3];
+};
+
+/**@brief vec3 quantized to 16 bits per component within the range of its channel*/
+struct PackedVec3
+{
+	unsigned short m_Data[3];
+};
+
+/**@brief How far the keys of a CompressedClip may be from the raw ones, per type of channel.
+	@details The bound covers both the dropped keys and the quantization of the kept ones. A channel with a tolerance of 0 only loses
+	the keys that lie exactly on the line between their neighbours. Key times always take 16 bits, so a channel moving so fast that
+	rounding its key times alone goes past the tolerance keeps all its keys and still misses it
+*/
+struct CompressionTolerance
+{
+	CompressionTolerance();
+	/**@brief true when any of the tolerances is above 0*/
+	bool isEnabled() const;
+
+	float m_Position; //!< model units
+	float m_Rotation; //!< radians
+	float m_Scale; //!< plain factor
+};
+
+/**
+@brief Lossy version of AnimClip
+@details Built from an AnimClip at load time when the model asks for compression. Keys that can be rebuilt by interpolating their neighbours
+within the tolerance are dropped. Key times are stored as 16 bit steps of the clip length, rotations as smallest three quaternions,
+scales and positions are quantized within the range of their channel, in 16 bits or in 32 when 16 would not meet the tolerance.
+The channel layout is the same as AnimClip so AnimCursor works with both
+*/
+struct CompressedClip
+{
+	/**@brief Same as AnimClip::Channel plus the range the values are quantized in*/
+	struct RangedChannel
+	{
+		unsigned int m_First; //!< first key time
+		unsigned int m_Count;
+		unsigned int m_FirstValue; //!< first key value. Ahead of m_First once a wide channel came before
+		bool m_Wide; //!< 32 bits per component: every key takes two PackedVec3, the high halves then the low ones
+		glm::vec3 m_Min;
+		glm::vec3 m_Extent;
+	};
+
+	CompressedClip();
+
+	/**@brief Build from @param clip dropping keys while the error stays below @param tolerance*/
+	void compress(const AnimClip &clip, float totalTicks, const CompressionTolerance &tolerance);
+
+	glm::vec3 sampleScale(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+	glm::vec3 samplePosition(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+	glm::quat sampleRotation(unsigned int bone, double expiredTicks, unsigned int &cursor) const;
+
+	/**@brief Bytes taken by the keys and channel tables*/
+	size_t getMemorySize() const;
+
+	unsigned int m_NumBones;
+	float m_TicksPerStep; //!< ticks between two quantized time steps
+
+	std::vector<RangedChannel> m_ScaleChannels; //!< indexed by bone id
+	std::vector<RangedChannel> m_PositionChannels;
+	std::vector<AnimClip::Channel> m_RotationChannels;
+
+	std::vector<unsigned short> m_ScaleTimes;
+	std::vector<PackedVec3> m_ScaleValues;
+	std::vector<unsigned short> m_PositionTimes;
+	std::vector<PackedVec3> m_PositionValues;
+	std::vector<unsigned short> m_RotationTimes;
+	std::vector<PackedQuat> m_RotationValues;
+};
+
+/**
+@brief The animation resampled at a fixed rate into full poses
+@details Frame major: every frame is a whole pose in the PoseBuffer layout. Sampling is a direct index into the two frames around the time
+and a single PoseKernel blend between them, no key search at all. Takes a lot more memory than the sparse keys
+so it is only built for the clips that ask for it
+*/
+struct DenseClip
+{
+	DenseClip();
+
+	/**@brief Blend the two frames around @param expiredTicks into @param pose with the PoseKernel*/
+	void samplePose(double expiredTicks, PoseBuffer &pose) const;
+	/**@brief Same as above writing to an array of transforms. The blend goes through a buffer on the stack so nothing is allocated*/
+	void samplePose(double expiredTicks, BoneArray<SQTTransform> &pose) const;
+
+	/**@brief The pose of @param frame laid out like PoseBuffer::m_Data*/
+	const float* getFrame(unsigned int frame) const;
+
+	/**@brief Bytes taken by the frames*/
+	size_t getMemorySize() const;
+
+	unsigned int m_NumBones;
+	unsigned int m_NumFrames; //!< 0 when the animation has not been resampled
+	unsigned int m_Stride; //!< PoseBuffer stride of a frame
+	float m_FramesPerTick;
+	std::vector<float> m_Frames; //!< m_NumFrames structure of arrays poses back to back
+private:
+	/**@brief The two frames around @param expiredTicks and the blend factor between them*/
+	void findFrames(double expiredTicks, unsigned int &frame, unsigned int &nextFrame, float &factor) const;
+};
+
+/**@brief Which of the keyframe representations of an Animation to sample from
+	@details SPARSE is the default everywhere. Only the objects that ask for DENSE use the resampled frames.
+	Asking for DENSE on an animation that has not been resampled falls back to the sparse keys
+*/
+enum class AnimStorage{ SPARSE, DENSE };
+
 /**
 @brief Represents a single animation for a particular bone structure of a model
 */
@@ -57,12 +235,29 @@ struct Animation
 {
 public:
 
-	/**@brief Calculates the local bone transformations for the given bones. 
+	/**@brief Calculates the local bone transformations for the given bones.
 	   @param deltaTime the time from the last call to animate
 	   @param boneLocalTransforms returns the updated bones here
+	   @param cursor optional per instance key cursor. Reset automatically if it belongs to another animation. Not used by the dense frames
+	   @param storage sample from the sparse (possibly compressed) keys or the resampled dense frames
 	*/
-	bool getTransforms(double deltaTime, std::map<unsigned int, SQTTransform> &boneLocalTransforms) const;
+	bool getTransforms(double deltaTime, BoneArray<SQTTransform> &boneLocalTransforms, AnimCursor *cursor = NULL,
+		AnimStorage storage = AnimStorage::SPARSE) const;
+	/**@brief Same as above writing to a structure of arrays pose. This is the fast path for the dense frames*/
+	bool getTransforms(double deltaTime, PoseBuffer &pose, AnimCursor *cursor = NULL, AnimStorage storage = AnimStorage::SPARSE) const;
+
+	/**@brief Replace the keys with a CompressedClip built with @param tolerance. The uncompressed keys are released*/
+	void compress(const CompressionTolerance &tolerance);
+
+	/**@brief Build the DenseClip by sampling the sparse keys @param framesPerTick times per tick, so the rate follows m_TicksPerSecond.
+		The sparse keys are kept*/
+	void resample(unsigned int framesPerTick);
+	bool hasDenseClip() const;
+
+	/**@brief Bytes taken by the sparse keys of the animation*/
+	size_t getMemorySize() const;
 
+	Animation();
 	~Animation();
 public:
 	unsigned int m_Id; //!< int id used to speed up search
@@ -71,7 +266,10 @@ public:
 	float m_TotalTicks; //!< total ticks
 	float m_TicksPerSecond; //!< tps
 	unsigned int m_NumBones;
-	std::map<unsigned int, BoneAnim*> m_BoneAnim; //!< a single bone anim corresponds to the animation of a single bone
+	AnimClip m_Clip; //!< the keyframes of every bone. Empty when compressed
+	CompressedClip m_CompressedClip; //!< only used when m_Compressed is set
+	bool m_Compressed;
+	DenseClip m_DenseClip; //!< empty unless the animation has been resampled
 
 private:
 };
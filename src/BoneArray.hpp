@@ -0,0 +1,83 @@
+#pragma once
+#include "stdafx.h"
+
+static const unsigned int MAX_BONES = 256; //!< capacity of the cpu side poses. PackedSkinnedVertex stores bone ids in a byte so it may not go above 256
+
+#ifdef _MSC_VER
+#define BONE_ARRAY_ALIGN __declspec(align(16))
+#else
+#define BONE_ARRAY_ALIGN __attribute__((aligned(16)))
+#endif
+
+/**
+@brief Fixed capacity array of per bone data indexed by bone id
+@details Replaces std::map<unsigned int, T> for poses. Bone ids are dense (0..N-1) so a flat array does the same job without the tree.
+The storage lives inside the object and is 16 byte aligned, so filling, copying or indexing it never touches the heap.
+Only the first size() elements are in use
+*/
+template <typename T>
+struct BoneArray
+{
+	BoneArray()
+		:m_Size(0)
+	{
+
+	}
+
+	/**@brief Set the number of bones in use. Clamped to MAX_BONES*/
+	void resize(unsigned int size)
+	{
+		if(size > MAX_BONES)
+		{
+			LOG(ERROR) << "skeleton has " << size << " bones. Only " << MAX_BONES << " are supported";
+			size = MAX_BONES;
+		}
+		m_Size = size;
+	}
+
+	/**@brief resize to @param size and set every bone to @param value*/
+	void assign(unsigned int size, const T &value)
+	{
+		resize(size);
+		for(unsigned int i = 0; i < m_Size; i++)
+			m_Data[i] = value;
+	}
+
+	unsigned int size() const
+	{
+		return m_Size;
+	}
+
+	T& operator[](unsigned int bone)
+	{
+		return m_Data[bone];
+	}
+
+	const T& operator[](unsigned int bone) const
+	{
+		return m_Data[bone];
+	}
+
+	T& at(unsigned int bone)
+	{
+		return m_Data[bone];
+	}
+
+	const T& at(unsigned int bone) const
+	{
+		return m_Data[bone];
+	}
+
+	T* data()
+	{
+		return m_Data;
+	}
+
+	const T* data() const
+	{
+		return m_Data;
+	}
+
+	unsigned int m_Size;
+	BONE_ARRAY_ALIGN T m_Data[MAX_BONES];
+};
\ No newline at end of file
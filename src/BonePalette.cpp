@@ -0,0 +1,138 @@
+#include "BonePalette.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+#include <cstring>
+
+BonePalette& BonePalette::get()
+{
+	static BonePalette singleton;
+	return singleton;
+}
+
+BonePalette::BonePalette()
+	:m_Palettes(0), m_Matrices(0), m_Bytes(0), m_Overflows(0), m_OverflowLogged(false)
+{
+
+}
+
+BonePalette::~BonePalette()
+{
+	//the context may already be gone when the statics are destroyed so the buffer is left to it
+}
+
+void BonePalette::init(unsigned int capacity)
+{
+	m_Ring.init(capacity * sizeof(glm::mat4), "Bone palette");
+}
+
+void BonePalette::beginFrame()
+{
+	m_Ring.beginFrame();
+	m_Palettes = m_Matrices = m_Bytes = m_Overflows = 0;
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING, m_Ring.getBuffer(), m_Ring.getRegionOffset(), m_Ring.getRegionSize());
+}
+
+void BonePalette::endFrame()
+{
+	m_Ring.endFrame();
+	if (m_Overflows && !m_OverflowLogged)
+	{
+		m_OverflowLogged = true;
+		LOG(WARN) << m_Overflows << " bone palettes did not fit in the ring. Raise bonePalette.capacity";
+	}
+}
+
+bool BonePalette::write(const glm::mat4 *matrices, unsigned int count, PaletteFormat format, unsigned int &base)
+{
+	unsigned int stride = getStride(format);
+	GLsizeiptr bytes = count * stride;
+	GLintptr offset;
+	//aligned to the stride so the palette starts on a whole bone of the array the shader declares
+	unsigned char *dest = m_Ring.allocate(bytes, stride, offset);
+	if (!dest)
+	{
+		m_Overflows++;
+		return false;
+	}
+	encode(format, matrices, count, reinterpret_cast<float*>(dest));
+	base = offset / stride;
+	m_Palettes++;
+	m_Matrices += count;
+	m_Bytes += bytes;
+	return true;
+}
+
+unsigned int BonePalette::getStride(PaletteFormat format)
+{
+	switch (format)
+	{
+	case PaletteFormat::MAT3X4:
+		return 12 * sizeof(float);
+	case PaletteFormat::DUAL_QUAT:
+		return 8 * sizeof(float);
+	default:
+		return sizeof(glm::mat4);
+	}
+}
+
+void BonePalette::encode(PaletteFormat format, const glm::mat4 *matrices, unsigned int count, float *dest)
+{
+	switch (format)
+	{
+	case PaletteFormat::MAT4:
+		memcpy(dest, matrices, count * sizeof(glm::mat4));
+		break;
+	case PaletteFormat::MAT3X4:
+		//the rows of the affine part. The shader reads them as the columns of a mat3x4 and multiplies the vertex from the left
+		for (unsigned int i = 0; i < count; i++, dest += 12)
+		{
+			const glm::mat4 &m = matrices[i];
+			for (unsigned int row = 0; row < 3; row++)
+			{
+				dest[row * 4 + 0] = m[0][row];
+				dest[row * 4 + 1] = m[1][row];
+				dest[row * 4 + 2] = m[2][row];
+				dest[row * 4 + 3] = m[3][row];
+			}
+		}
+		break;
+	case PaletteFormat::DUAL_QUAT:
+		//(rotation quaternion) (translation, scale). The shader builds the dual part from them per influence
+		//as the dual part alone would leave no room for the scale
+		for (unsigned int i = 0; i < count; i++, dest += 8)
+		{
+			const glm::mat4 &m = matrices[i];
+			float scale = glm::length(glm::vec3(m[0]));
+			glm::quat real = glm::quat_cast(glm::mat3(m) * (1.0f / scale));
+			dest[0] = real.x;
+			dest[1] = real.y;
+			dest[2] = real.z;
+			dest[3] = real.w;
+			dest[4] = m[3][0];
+			dest[5] = m[3][1];
+			dest[6] = m[3][2];
+			dest[7] = scale;
+		}
+		break;
+	}
+}
+
+unsigned int BonePalette::getPalettes() const
+{
+	return m_Palettes;
+}
+
+unsigned int BonePalette::getMatrices() const
+{
+	return m_Matrices;
+}
+
+unsigned int BonePalette::getBytes() const
+{
+	return m_Bytes;
+}
+
+unsigned int BonePalette::getOverflows() const
+{
+	return m_Overflows;
+}
\ No newline at end of file
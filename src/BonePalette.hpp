@@ -0,0 +1,63 @@
+#pragma once
+#include "stdafx.h"
+#include "StreamBuffer.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/**@brief How a bone matrix is laid out in the palette. Each skinning vertex shader reads exactly one of them
+	@details MAT4 is the full matrix (64 B). MAT3X4 drops the constant last row and stores the three rows of the affine part (48 B).
+	DUAL_QUAT stores the rotation, translation and a uniform scale (32 B) and is blended as a dual quaternion in the shader
+*/
+enum class PaletteFormat{ MAT4, MAT3X4, DUAL_QUAT };
+
+/**
+@brief Persistently mapped shader storage ring that holds the bone palettes of every skinned draw in a frame
+@details The palettes of a frame are copied back to back into the region of the frame in a StreamBuffer, which is bound once at BINDING.
+A draw finds its palette through the base index written with its instance data, so a palette costs one copy and no bind,
+instances with different palettes can share a draw, and its length is not limited by the size of a uniform array
+*/
+class BonePalette
+{
+public:
+	static BonePalette& get();
+	~BonePalette();
+
+	static const GLuint BINDING = 0; //!< the shader storage binding of the BonePalette block in the skinning shaders
+
+	/**@brief Create the buffer. @param capacity is the number of full matrices a single frame may write. The compact formats fit more bones*/
+	void init(unsigned int capacity);
+
+	/**@brief Wait until the gpu is done with the next region, start writing into it and bind it. Called before the first skinned draw of the frame*/
+	void beginFrame();
+	/**@brief Fence the region written this frame. Called after the last skinned draw of the frame*/
+	void endFrame();
+
+	/**@brief Encode @param count matrices as @param format into the current region
+		@param base receives the index of the first bone in the bound region, counted in bones of @param format
+		@return false if the region has no room left
+	*/
+	bool write(const glm::mat4 *matrices, unsigned int count, PaletteFormat format, unsigned int &base);
+
+	/**@brief Bytes a single bone takes in @param format*/
+	static unsigned int getStride(PaletteFormat format);
+	/**@brief Write @param count matrices to @param dest in @param format. The matrices may only hold rotation, translation and scale.
+		DUAL_QUAT expects the scale to be uniform and keeps the one of the x axis
+	*/
+	static void encode(PaletteFormat format, const glm::mat4 *matrices, unsigned int count, float *dest);
+
+	unsigned int getPalettes() const; //!< palettes written this frame
+	unsigned int getMatrices() const; //!< matrices written this frame
+	unsigned int getBytes() const; //!< palette bytes written this frame
+	unsigned int getOverflows() const; //!< palettes that did not fit this frame
+private:
+	BonePalette();
+
+	StreamBuffer m_Ring;
+
+	unsigned int m_Palettes;
+	unsigned int m_Matrices;
+	unsigned int m_Bytes;
+	unsigned int m_Overflows;
+	bool m_OverflowLogged; //!< the overflow warning is only given once
+};
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "ModelManager.hpp"
 #include "GameWorld.hpp"
 #include "Timer.hpp"
+#include "RenderQueue.hpp"
 
 #include <luapath\luapath.hpp>
 #include <limits>
@@ -68,9 +69,13 @@ void Character::render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix)
 void Character::update()
 {
 	SkinnedObject::update();
+}
+
+void Character::lateUpdate()
+{
+	SkinnedObject::lateUpdate();
 	m_Primary.updateAttachment();
 	m_Secondary.updateAttachment();
-
 }
 bool Character::intersect(const AABB &other)
 {
@@ -91,7 +96,7 @@ void Character::playPrimary()
 
 void Attachment::loadAttachment(const luapath::Table &table)
 {
-	m_BoneAttachment = m_Parent->m_SkinnedModel->m_Skeleton->findBone(string(table.getValue(".boneAttach")));
+	m_BoneAttachment = m_Parent->m_SkinnedModel->findBone(string(table.getValue(".boneAttach")));
 	string Name = table.getValue(".modelName");
 	m_Object = new Object(Name, Name);
 	m_Object->generateAABB();
@@ -112,6 +117,24 @@ void Attachment::loadAttachment(const luapath::Table &table)
 		string boneEffector = ikTable.getValue(".boneEffector");
 		int chainLength = ikTable.getValue(".chainLength");
 		int maxTries = ikTable.getValue(".maxTries");
+		//optional. 0 always starts from the animated pose
+		float warmStartDistance = 0.0f;
+		luapath::Value warmStartValue;
+		if (ikTable.getValue(".warmStartDistance", warmStartValue))
+			warmStartDistance = warmStartValue;
+		//optional. defaults to ccd
+		IKObject::Solver solver = IKObject::Solver::CCD;
+		luapath::Value solverValue;
+		if (ikTable.getValue(".solver", solverValue))
+		{
+			string solverStr = solverValue;
+			if (solverStr == "twoBone")
+				solver = IKObject::Solver::TWO_BONE;
+			else if (solverStr == "fabrik")
+				solver = IKObject::Solver::FABRIK;
+			else if (solverStr != "ccd")
+				LOG(WARN) << "unknown IK solver " << solverStr << ". Using ccd";
+		}
 		m_DeltaWeaponOffset = ikTable.getValue(".deltaRotation");
 		glm::vec3 position(ikTable.getValue(".position.x"), ikTable.getValue(".position.y"), ikTable.getValue(".position.z"));
 
@@ -126,9 +149,9 @@ void Attachment::loadAttachment(const luapath::Table &table)
 		m_Curve.m_Type = CubicCurve::CurveType::Bezier;
 		m_Curve.setControlPoints(controlPoints);
 		m_Curve.setNumSamples((int)ikTable.getValue(".numSamples"));
-		m_Parent->attachIK(ikType, boneEffector, position, chainLength, maxTries);
+		m_Parent->attachIK(ikType, boneEffector, position, chainLength, maxTries, solver, warmStartDistance);
 		
-		m_BoneIk = m_Parent->m_SkinnedModel->m_Skeleton->findBone(boneEffector);
+		m_BoneIk = m_Parent->m_SkinnedModel->findBone(boneEffector);
 	}
 
 }
@@ -177,39 +200,25 @@ HealthBar::HealthBar(Character *parent, float yoffset, float width, float height
 
 }
 
-void HealthBar::load(Character *parent)
+/**@brief Build a box of the health bar in @param color. Newed and never deleted as the buffers may not outlive the context*/
+static Mesh* createBox(float width, float height, float breadth, const glm::vec4 &color, const ShaderProgram *shader)
 {
-	m_Parent = parent;
-	m_LastHitTime = 0;
-	luapath::LuaState settings("config/settings.lua");
-	luapath::Table healthBarTable = settings.getGlobalTable("healthBar");
-	m_Width = healthBarTable.getValue(".width");
-	m_Height = healthBarTable.getValue(".height");
-	m_Breadth = healthBarTable.getValue(".breadth");
-	m_Yoffset = healthBarTable.getValue(".yoffset");
-	m_HealthLeft = healthBarTable.getValue(".healthLeft");
-	m_HitTimeDelay = healthBarTable.getValue(".hitTimeDelay");
-	string vertexShader = healthBarTable.getValue(".vertexShader");
-	string fragmentShader = healthBarTable.getValue(".fragmentShader");
-	m_Shader = ShaderManager::get().getShaderProgram(vertexShader, fragmentShader);
-
+	Mesh *box = new Mesh();
 	//vertex spec
-	float factor = m_HealthLeft;
-	float halfWidth = m_Width/2;
-	m_BoxMesh.m_Vertices.resize(8);
-	m_BoxMesh.m_Vertices[0] = glm::vec3(-halfWidth, 0, 0);
-	m_BoxMesh.m_Vertices[1] = glm::vec3(-halfWidth, 0, m_Breadth);
-	m_BoxMesh.m_Vertices[2] = glm::vec3(-halfWidth, m_Height, m_Breadth);
-	m_BoxMesh.m_Vertices[3] = glm::vec3(-halfWidth, m_Height, 0);
-
-	m_BoxMesh.m_Vertices[4] = glm::vec3(halfWidth, 0, 0); 
-	m_BoxMesh.m_Vertices[5] = glm::vec3(halfWidth, 0, m_Breadth); 
-	m_BoxMesh.m_Vertices[6] = glm::vec3(halfWidth, 0, m_Breadth); 
-	m_BoxMesh.m_Vertices[7] = glm::vec3(halfWidth, m_Height, 0); 
-
-	//indices spec
-	vector<GLuint> indices(36);
-	GLuint indicesTemp[36] = 
+	float halfWidth = width/2;
+	box->m_Vertices.resize(8);
+	box->m_Vertices[0] = glm::vec3(-halfWidth, 0, 0);
+	box->m_Vertices[1] = glm::vec3(-halfWidth, 0, breadth);
+	box->m_Vertices[2] = glm::vec3(-halfWidth, height, breadth);
+	box->m_Vertices[3] = glm::vec3(-halfWidth, height, 0);
+
+	box->m_Vertices[4] = glm::vec3(halfWidth, 0, 0); 
+	box->m_Vertices[5] = glm::vec3(halfWidth, 0, breadth); 
+	box->m_Vertices[6] = glm::vec3(halfWidth, height, breadth); 
+	box->m_Vertices[7] = glm::vec3(halfWidth, height, 0); 
+
+	//indices spec. A triangle list
+	GLuint indices[36] = 
 	{
 	0,1,2,
 	0,2,3,
@@ -224,11 +233,29 @@ void HealthBar::load(Character *parent)
 	1,2,6,
 	1,5,6,
 	};
-	for (int i = 0; i < 36; i++)
-	{
-		indices[i] = indicesTemp[i];
-	}
-	m_BoxMesh.m_Indices = indices;
+	box->m_Indices.assign(indices, indices + 36);
+	box->m_Material.diffuse = color;
+
+	box->createVAO(shader);
+	box->retrieveMaterialLocations(shader);
+	return box;
+}
+
+void HealthBar::load(Character *parent)
+{
+	m_Parent = parent;
+	m_LastHitTime = 0;
+	luapath::LuaState settings("config/settings.lua");
+	luapath::Table healthBarTable = settings.getGlobalTable("healthBar");
+	m_Width = healthBarTable.getValue(".width");
+	m_Height = healthBarTable.getValue(".height");
+	m_Breadth = healthBarTable.getValue(".breadth");
+	m_Yoffset = healthBarTable.getValue(".yoffset");
+	m_HealthLeft = healthBarTable.getValue(".healthLeft");
+	m_HitTimeDelay = healthBarTable.getValue(".hitTimeDelay");
+	string vertexShader = healthBarTable.getValue(".vertexShader");
+	string fragmentShader = healthBarTable.getValue(".fragmentShader");
+	m_Shader = ShaderManager::get().getShaderProgram(vertexShader, fragmentShader);
 
 	m_GoodColor = glm::vec4(healthBarTable.getValue(".goodColor.r"),
 		healthBarTable.getValue(".goodColor.g"),
@@ -236,9 +263,12 @@ void HealthBar::load(Character *parent)
 	m_BadColor = glm::vec4(healthBarTable.getValue(".badColor.r"),
 		healthBarTable.getValue(".badColor.g"),
 		healthBarTable.getValue(".badColor.b"),1.0f);
-	
-	m_BoxMesh.createVAO(m_Shader);
-	m_BoxMesh.retrieveMaterialLocations(m_Shader);
+
+	//all health bars come from the same settings so the boxes are built once
+	static Mesh *goodBox = createBox(m_Width, m_Height, m_Breadth, m_GoodColor, m_Shader);
+	static Mesh *badBox = createBox(m_Width, m_Height, m_Breadth, m_BadColor, m_Shader);
+	m_GoodBox = goodBox;
+	m_BadBox = badBox;
 }
 
 void HealthBar::updateHealth(float factor)
@@ -264,23 +294,10 @@ void HealthBar::render()
 		SQTTransform goodBar = m_Parent->getTransform();
 		goodBar.translateLocal(0, m_Yoffset, 0);
 		goodBar.scaleUniform(m_HealthLeft);
-
-		glUseProgram(m_Shader->m_Id);
-		m_BoxMesh.m_Material.diffuse = m_GoodColor;
-		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(goodBar.getMatrix()));
-		glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getViewMatrix()));
-		glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getProjectionMatrix()));
-		m_BoxMesh.render(m_Shader, GL_TRIANGLE_STRIP, true);
+		RenderQueue::get().submit(m_GoodBox, m_Shader, goodBar.getMatrix());
 	}
 
 	SQTTransform badBar = m_Parent->getTransform();
 	badBar.scaleUniform(1 - m_HealthLeft);
-	glUseProgram(m_Shader->m_Id);
-	m_BoxMesh.m_Material.diffuse = m_BadColor;
-	//m_BoxMesh.m_Material.diffuse = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f);
-	glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(badBar.getMatrix())); 
-	glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getViewMatrix())); 
-	glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(GameWorld::get().getProjectionMatrix()));
-	m_BoxMesh.render(m_Shader, GL_TRIANGLE_STRIP, true);
-
+	RenderQueue::get().submit(m_BadBox, m_Shader, badBar.getMatrix());
 }
\ No newline at end of file
@@ -42,7 +42,8 @@ struct HealthBar
 	float m_HitTimeDelay;
 	glm::vec4 m_GoodColor, m_BadColor;
 	float m_LastHitTime;
-	Mesh m_BoxMesh;
+	Mesh *m_GoodBox; //!< shared by every health bar so the render queue draws them instanced
+	Mesh *m_BadBox;
 	const ShaderProgram *m_Shader;
 	//glm::vec3 m_GoodColor, m_BadColor;
 	HealthBar();
@@ -66,6 +67,8 @@ public:
 	virtual ~Character();
 	virtual void render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
 	virtual void update();
+	/**@brief Moves the attachments to the final pose of the bones they are attached to*/
+	virtual void lateUpdate();
 	void playPrimary();
 	void playSecondary();
 	virtual bool intersect(const AABB &other);
@@ -2,6 +2,7 @@
 #include "GameWorld.hpp"
 #include "GameObject.hpp"
 #include "ShaderProgram.hpp"
+#include "RenderQueue.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -80,11 +81,9 @@ void CubicCurve::render() const
 			curvePoint->getTransform().setPosition(position);
 			curvePoint->render(gameWorld.getViewMatrix(), gameWorld.getProjectionMatrix());
 		}
-		//render curve line
-		glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(m_Transform.getMatrix())); //overwrite the model matrix that was set by rendering the points
-
+		//render curve line. The points are only queued so it brings its own program
 		const ShaderProgram *shader = curvePoint->m_Model->getShaderProgram();
-		m_LineMesh.render(shader, GL_LINE_STRIP, false);// false means don't draw elements just arrays
+		RenderQueue::get().drawImmediate(&m_LineMesh, shader, m_Transform.getMatrix(), GL_LINE_STRIP, false);// false means don't draw elements just arrays
 	}
 }
 
@@ -12,7 +12,8 @@ Enemy::Enemy(const std::string &profile,
 					const std::string &modelName,
 					const SQTTransform &transform /*= SQTTransform()*/
 )
-:Character(profile, objectName, modelName, transform), m_State(State::RUNNING), m_DistanceCovered(0), m_rotationTime(0)
+:Character(profile, objectName, modelName, transform), m_State(State::RUNNING), m_DistanceCovered(0), m_rotationTime(0),
+m_RunCommand(objectName, Direction::FORWARD)
 {
 	m_LastPosition = getTransform().getPosition();
 }
@@ -27,7 +28,7 @@ void Enemy::update()
 	{ // AI
 		if(getCurrentAnim()->m_Name != "lie")
 		{
-			CommandQueue::get().addCommandDisposable(new CommandCharacterRun(this->m_Name, Direction::FORWARD));
+			CommandQueue::get().addCommand(&m_RunCommand);
 			glm::vec3 currPosition = getTransform().getPosition();
 			float distanceOffset = glm::length(currPosition - m_LastPosition);
 			m_DistanceCovered += distanceOffset;
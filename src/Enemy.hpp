@@ -1,5 +1,6 @@
 #pragma once
 #include "Character.hpp"
+#include "Command.hpp"
 #include "stdafx.h"
 #include <glm/glm.hpp>
 
@@ -20,5 +21,6 @@ public:
 	float m_rotationTime;
 	float m_Rotation;
 private:
+	CommandCharacterRun m_RunCommand; //!< queued every frame through the non disposable queue so running does not allocate
 
 };
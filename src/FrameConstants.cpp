@@ -0,0 +1,44 @@
+#include "FrameConstants.hpp"
+
+FrameConstants& FrameConstants::get()
+{
+	static FrameConstants singleton;
+	return singleton;
+}
+
+FrameConstants::FrameConstants()
+	:m_Buffer(0)
+{
+	m_Block.m_Time = 0.0f;
+}
+
+void FrameConstants::init()
+{
+	glGenBuffers(1, &m_Buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	//stays bound. Nothing else uses this binding
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_Buffer);
+}
+
+void FrameConstants::setViewMatrix(const glm::mat4 &view)
+{
+	m_Block.m_View = view;
+	//the camera sits at the origin of view space
+	m_Block.m_CameraPosition = glm::vec3(glm::inverse(view)[3]);
+}
+
+void FrameConstants::setProjectionMatrix(const glm::mat4 &projection)
+{
+	m_Block.m_Projection = projection;
+}
+
+void FrameConstants::upload(float time)
+{
+	m_Block.m_ViewProjection = m_Block.m_Projection * m_Block.m_View;
+	m_Block.m_Time = time;
+	glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &m_Block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
\ No newline at end of file
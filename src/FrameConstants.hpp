@@ -0,0 +1,41 @@
+#pragma once
+#include "stdafx.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/**
+@brief The per frame camera and time every shader reads from the FrameConstants uniform block
+@details GameWorld hands over the view and projection matrices as they change and upload writes the block once per frame,
+so the programs no longer get the camera as uniforms of their own
+*/
+class FrameConstants
+{
+public:
+	static FrameConstants& get();
+
+	static const GLuint BINDING = 0; //!< the uniform buffer binding of the FrameConstants block
+
+	/**@brief Create the uniform buffer and bind it at BINDING*/
+	void init();
+
+	void setViewMatrix(const glm::mat4 &view);
+	void setProjectionMatrix(const glm::mat4 &projection);
+	/**@brief Write the block for this frame. @param time is the absolute time in seconds*/
+	void upload(float time);
+private:
+	FrameConstants();
+
+	/**@brief std140 layout of the block*/
+	struct Block
+	{
+		glm::mat4 m_View;
+		glm::mat4 m_Projection;
+		glm::mat4 m_ViewProjection;
+		glm::vec3 m_CameraPosition; //!< world space
+		float m_Time;
+	};
+
+	Block m_Block;
+	GLuint m_Buffer;
+};
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "FrustumCuller.hpp"
+#include "SimdDispatch.hpp"
+
+using std::string;
+
+FrustumCuller& FrustumCuller::get()
+{
+	static FrustumCuller singleton;
+	return singleton;
+}
+
+FrustumCuller::FrustumCuller()
+	:m_NumVisible(0), m_NumCulled(0)
+{
+	m_Cull = selectSimdPath("cull", SIMD_PATHS(&FrustumCuller::cullScalar, &FrustumCuller::cullSSE, &FrustumCuller::cullAVX2), m_Name);
+}
+
+void FrustumCuller::extractPlanes(const glm::mat4 &viewProjection, glm::vec4 *planes)
+{
+	//a point is inside if -w <= x,y,z <= w in clip space. Each bound is a plane in world space built from the rows of the matrix
+	glm::vec4 rows[4];
+	for (unsigned int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	planes[0] = rows[3] + rows[0]; //left
+	planes[1] = rows[3] - rows[0]; //right
+	planes[2] = rows[3] + rows[1]; //bottom
+	planes[3] = rows[3] - rows[1]; //top
+	planes[4] = rows[3] + rows[2]; //near
+	planes[5] = rows[3] - rows[2]; //far
+	for (unsigned int p = 0; p < NUM_PLANES; p++)
+		planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+void FrustumCuller::beginFrame(const glm::mat4 &viewProjection)
+{
+	extractPlanes(viewProjection, m_Planes);
+	m_Min.clear();
+	m_Max.clear();
+}
+
+unsigned int FrustumCuller::add(const glm::vec3 &min, const glm::vec3 &max)
+{
+	m_Min.push_back(min);
+	m_Max.push_back(max);
+	return m_Min.size() - 1;
+}
+
+void FrustumCuller::cull()
+{
+	unsigned int count = m_Min.size();
+	unsigned int stride = (count + CULL_BOX_ALIGNMENT - 1) / CULL_BOX_ALIGNMENT * CULL_BOX_ALIGNMENT;
+	//the padding boxes are points at the origin. Their result is never read
+	m_Boxes.assign(NUM_COMPONENTS * stride, 0.0f);
+	m_Visible.resize(stride);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			m_Boxes[(MIN_X + c) * stride + i] = m_Min[i][c];
+			m_Boxes[(MAX_X + c) * stride + i] = m_Max[i][c];
+		}
+	}
+	m_NumVisible = 0;
+	if (count)
+	{
+		m_Cull(&m_Boxes[0], stride, m_Planes, &m_Visible[0]);
+		for (unsigned int i = 0; i < count; i++)
+			m_NumVisible += m_Visible[i];
+	}
+	m_NumCulled = count - m_NumVisible;
+}
+
+bool FrustumCuller::isVisible(unsigned int box) const
+{
+	return m_Visible[box] != 0;
+}
+
+unsigned int FrustumCuller::getVisible() const
+{
+	return m_NumVisible;
+}
+
+unsigned int FrustumCuller::getCulled() const
+{
+	return m_NumCulled;
+}
+
+const string& FrustumCuller::getName() const
+{
+	return m_Name;
+}
+
+void FrustumCuller::cullScalar(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible)
+{
+	for (unsigned int i = 0; i < stride; i++)
+	{
+		bool inside = true;
+		for (unsigned int p = 0; p < NUM_PLANES && inside; p++)
+		{
+			const glm::vec4 &plane = planes[p];
+			//the corner furthest along the normal. If it is behind the plane the whole box is
+			float x = boxes[(plane.x >= 0.0f ? MAX_X : MIN_X) * stride + i];
+			float y = boxes[(plane.y >= 0.0f ? MAX_Y : MIN_Y) * stride + i];
+			float z = boxes[(plane.z >= 0.0f ? MAX_Z : MIN_Z) * stride + i];
+			//summed in the order of the simd paths
+			inside = (plane.x * x + plane.y * y) + (plane.z * z + plane.w) >= 0.0f;
+		}
+		visible[i] = inside ? 1 : 0;
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2
+void FrustumCuller::cullSSE(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible)
+{
+	//the corner is picked per plane so the same component array is read for all the boxes of a register
+	const float *cornerX[NUM_PLANES], *cornerY[NUM_PLANES], *cornerZ[NUM_PLANES];
+	for (unsigned int p = 0; p < NUM_PLANES; p++)
+	{
+		cornerX[p] = boxes + (planes[p].x >= 0.0f ? MAX_X : MIN_X) * stride;
+		cornerY[p] = boxes + (planes[p].y >= 0.0f ? MAX_Y : MIN_Y) * stride;
+		cornerZ[p] = boxes + (planes[p].z >= 0.0f ? MAX_Z : MIN_Z) * stride;
+	}
+	for (unsigned int i = 0; i < stride; i += 4)
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (unsigned int p = 0; p < NUM_PLANES; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(cornerX[p] + i)),
+				_mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(cornerY[p] + i))),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(cornerZ[p] + i)), _mm_set1_ps(planes[p].w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (unsigned int b = 0; b < 4; b++)
+			visible[i + b] = (mask >> b) & 1;
+	}
+}
+
+SIMD_TARGET_AVX2
+void FrustumCuller::cullAVX2(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible)
+{
+	const float *cornerX[NUM_PLANES], *cornerY[NUM_PLANES], *cornerZ[NUM_PLANES];
+	for (unsigned int p = 0; p < NUM_PLANES; p++)
+	{
+		cornerX[p] = boxes + (planes[p].x >= 0.0f ? MAX_X : MIN_X) * stride;
+		cornerY[p] = boxes + (planes[p].y >= 0.0f ? MAX_Y : MIN_Y) * stride;
+		cornerZ[p] = boxes + (planes[p].z >= 0.0f ? MAX_Z : MIN_Z) * stride;
+	}
+	for (unsigned int i = 0; i < stride; i += 8)
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (unsigned int p = 0; p < NUM_PLANES; p++)
+		{
+			//no fma here so the distances round exactly like the other paths
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].x), _mm256_loadu_ps(cornerX[p] + i)),
+				_mm256_mul_ps(_mm256_set1_ps(planes[p].y), _mm256_loadu_ps(cornerY[p] + i))),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[p].z), _mm256_loadu_ps(cornerZ[p] + i)), _mm256_set1_ps(planes[p].w)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (unsigned int b = 0; b < 8; b++)
+			visible[i + b] = (mask >> b) & 1;
+	}
+}
+
+#endif
\ No newline at end of file
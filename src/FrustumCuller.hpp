@@ -0,0 +1,62 @@
+#pragma once
+#include "stdafx.h"
+
+#include <glm/glm.hpp>
+
+static const unsigned int CULL_BOX_ALIGNMENT = 8; //!< widest kernel tests 8 boxes at a time
+
+/**
+@brief Tests world space bounding boxes against the view frustum with SIMD
+@details The boxes are stored as a structure of arrays, one array per min/max component padded to a multiple of CULL_BOX_ALIGNMENT,
+so the kernels test 4 or 8 boxes against a plane at a time. For every plane only the corner furthest along its normal is tested
+which keeps boxes that straddle a corner of the frustum. The AVX2, SSE and scalar paths give the same result.
+The widest path the cpu supports is picked once at startup
+*/
+class FrustumCuller
+{
+public:
+	enum Component{ MIN_X, MIN_Y, MIN_Z, MAX_X, MAX_Y, MAX_Z, NUM_COMPONENTS };
+	static const unsigned int NUM_PLANES = 6;
+
+	/**@brief signature of the cull kernels. @param stride floats between two components which is also the number of boxes tested.
+		@param planes (normal, distance) with the normal pointing inside. @param visible gets 1 for every box at least partly inside and 0 otherwise
+	*/
+	typedef void (*CullFunction)(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible);
+
+	static FrustumCuller& get();
+
+	/**@brief Forget the boxes of the last frame and take the planes of @param viewProjection*/
+	void beginFrame(const glm::mat4 &viewProjection);
+	/**@brief Queue a box for the next cull. @return its index for isVisible*/
+	unsigned int add(const glm::vec3 &min, const glm::vec3 &max);
+	/**@brief Test every box added since beginFrame*/
+	void cull();
+	bool isVisible(unsigned int box) const;
+
+	unsigned int getVisible() const; //!< boxes inside the frustum at the last cull
+	unsigned int getCulled() const; //!< boxes outside the frustum at the last cull
+
+	/**@brief name of the selected path for logging*/
+	const std::string& getName() const;
+
+	/**@brief The planes of the frustum of @param viewProjection, normalized and pointing inside*/
+	static void extractPlanes(const glm::mat4 &viewProjection, glm::vec4 *planes);
+
+	static void cullScalar(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible);
+	//only on x86, see SIMD_X86
+	static void cullSSE(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible);
+	static void cullAVX2(const float *boxes, unsigned int stride, const glm::vec4 *planes, unsigned char *visible);
+private:
+	FrustumCuller();
+
+	CullFunction m_Cull;
+	std::string m_Name;
+
+	glm::vec4 m_Planes[NUM_PLANES];
+	std::vector<glm::vec3> m_Min; //!< boxes as they are added. Packed into m_Boxes by cull
+	std::vector<glm::vec3> m_Max;
+	std::vector<float> m_Boxes; //!< NUM_COMPONENTS arrays one after the other
+	std::vector<unsigned char> m_Visible;
+	unsigned int m_NumVisible;
+	unsigned int m_NumCulled;
+};
\ No newline at end of file
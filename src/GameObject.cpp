@@ -6,7 +6,12 @@
 #include "ModelManager.hpp"
 #include "Timer.hpp"
 #include "Animation.hpp"
+#include "PoseKernel.hpp"
+#include "PoseCache.hpp"
 #include "GameWorld.hpp"
+#include "IKBatch.hpp"
+#include "BonePalette.hpp"
+#include "RenderQueue.hpp"
 #include "math_utilities.h"
 
 // GLM Mathemtics
@@ -17,14 +22,18 @@
 using std::vector;
 using  std::map;
 
+//squared distance between the end effector and the target under which an IK chain counts as solved
+static const float IK_DISTANCE_THRESH = 0.01f;
+
 Object::Object()
+	:m_Lod(0)
 {
 
 }
 Object::Object(const std::string &objectName,
 	const std::string &modelName,
 	const SQTTransform &transform)
-	:m_Name(objectName), m_Model(ModelManager::get().getModel(modelName)), m_Transform(transform), m_State(State::ACTIVE)
+	:m_Name(objectName), m_Model(ModelManager::get().getModel(modelName)), m_Transform(transform), m_State(State::ACTIVE), m_Lod(0)
 
 	
 {
@@ -33,7 +42,7 @@ Object::Object(const std::string &objectName,
 Object::Object(const std::string &objectName,
 	const Model *model,
 	const SQTTransform &transform)
-	: m_Name(objectName), m_Model(model), m_Transform(transform), m_State(State::ACTIVE)
+	: m_Name(objectName), m_Model(model), m_Transform(transform), m_State(State::ACTIVE), m_Lod(0)
 
 {
 
@@ -72,16 +81,40 @@ bool Object::intersect(const AABB &other)
 
 void Object::render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) 
 {
-	glUseProgram(m_Model->m_ShaderProgram->m_Id);
-	glm::mat4 modelMatrix = getTransform().getMatrix();
+	//the camera goes to the shaders once per frame through FrameConstants
+	selectLod(viewMatrix, projMatrix);
+	RenderQueue::get().submit(m_Model, getTransform().getMatrix(), 0, m_Lod);
+	m_AABB.render();
+}
 
-	glUniformMatrix4fv(0, 1, GL_FALSE, glm::value_ptr(modelMatrix)); // well known locations of uniforms
-	glUniformMatrix4fv(1, 1, GL_FALSE, glm::value_ptr(viewMatrix)); //@todo change later
-	glUniformMatrix4fv(2, 1, GL_FALSE, glm::value_ptr(projMatrix));
+void Object::selectLod(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix)
+{
+	const std::vector<Model::LodLevel> &levels = m_Model->m_LodLevels;
+	if (levels.empty() || !m_AABB.m_Enabled)
+	{
+		m_Lod = 0;
+		return;
+	}
+	glm::vec3 center = (m_AABB.m_Min + m_AABB.m_Max) * 0.5f;
+	float radius = glm::length(m_AABB.m_Max - center);
+	float distance = -(viewMatrix * glm::vec4(center, 1.0f)).z;
+	//the camera is inside the bounds
+	if (distance <= radius)
+	{
+		m_Lod = 0;
+		return;
+	}
+	//diameter over the height of the view at that distance
+	float screenSize = radius * projMatrix[1][1] / distance;
 
-	//glUniform3fv(3,1, glm::value_ptr(glm::vec3(viewMatrix[3]))); // position of camera; straight to fragment shader
-	m_Model->render();
-	m_AABB.render();
+	//coarser once the size is well below the threshold of the next level, finer once it is well above the one of the current level
+	float hysteresis = m_Model->m_LodHysteresis;
+	if (m_Lod > levels.size())
+		m_Lod = levels.size();
+	while (m_Lod < levels.size() && screenSize < levels[m_Lod].m_ScreenSize * (1.0f - hysteresis))
+		m_Lod++;
+	while (m_Lod > 0 && screenSize > levels[m_Lod - 1].m_ScreenSize * (1.0f + hysteresis))
+		m_Lod--;
 }
 
 void Object::update()
@@ -89,18 +122,30 @@ void Object::update()
 	m_AABB.transform(m_Transform.getMatrix());
 }
 
+void Object::lateUpdate()
+{
+
+}
+
 SkinnedObject::SkinnedObject(const std::string &objectName,
 	const std::string &modelName,
 	const SQTTransform &transform)
-	:Object(objectName, ModelManager::get().getSkinnedModel(modelName), SQTTransform()),
-	m_alreadyCalculated(false),m_AnimSpeed(1.0)
+	:SkinnedObject(objectName, ModelManager::get().getSkinnedModel(modelName), transform)
+{
+
+}
+
+SkinnedObject::SkinnedObject(const std::string &objectName,
+	const SkinnedModel *model,
+	const SQTTransform &transform)
+	:Object(objectName, model, SQTTransform()),
+	m_AnimSpeed(1.0), m_AnimStorage(AnimStorage::SPARSE), m_PoseBounds(false), m_IKSubtreeUpdate(true)
 	
 {
 	m_SkinnedModel = static_cast<const SkinnedModel*>(m_Model);
 	m_SkeletonId = m_SkinnedModel->m_Skeleton->m_Id;
 	//m_AnimStopped = !m_SkinnedModel->hasAnimation();
 	setTransform(transform);
-	m_BoneLocation = glGetUniformLocation(m_Model->m_ShaderProgram->m_Id, "boneTransform");
 
 	if(m_SkinnedModel->hasAnimation())
 	{
@@ -149,160 +194,284 @@ SQTTransform SkinnedObject::getBoneGlobalTransform(const Bone *bone)
 
 void SkinnedObject::render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) 
 {
-	glUseProgram(m_Model->m_ShaderProgram->m_Id);
-
-	//write the bone matrices to the gpu
-	for (int i = 0; i < m_BoneAbsoluteTransforms.size(); i++)
-	{
-		glUniformMatrix4fv(m_BoneLocation + i, 1, GL_FALSE, glm::value_ptr(m_BoneAbsoluteTransforms.at(i)));
-		//m_BoneAbsoluteTransforms[i] = getTransform().getMatrix() * m_BoneAbsoluteTransforms[i];
-	}
-
-	//call base class for transformations and such
-	Object::render(viewMatrix, projMatrix);
-
+	//encode the bone matrices as the shader wants them into this frame's palette ring. The instance carries where they start
+	//and without a palette the mesh would be skinned with someone else's
+	unsigned int paletteBase;
+	if (!m_BoneAbsoluteTransforms.size() || !BonePalette::get().write(m_BoneAbsoluteTransforms.data(), m_BoneAbsoluteTransforms.size(),
+		m_Model->m_ShaderProgram->m_PaletteFormat, paletteBase))
+		return;
+	selectLod(viewMatrix, projMatrix);
+	RenderQueue::get().submit(m_Model, getTransform().getMatrix(), paletteBase, m_Lod);
+	m_AABB.render();
 }
 
-vector<SQTTransform> SkinnedObject::getSelectedBonesInWorld( const SkinnedModel::AbsoluteTransformMap bones,
-	const std::vector<int> bonePos)
+void SkinnedObject::getSelectedBonesInWorld(const SkinnedModel::AbsolutePose &bones, const BoneArray<int> &bonePos,
+	unsigned int numLinks, BoneArray<SQTTransform> &bonesWorld)
 {
-	std::vector<SQTTransform> bonesWorld;
+	bonesWorld.resize(bonePos.size());
+	glm::mat4 modelMatrix = getTransform().getMatrix();
 	//get the SQT representation as it is easier to work with
-	for (int i = 0; i < bonePos.size(); i++)
-	{
-		SQTTransform transform;
-		transform = convertToSQTTransform(getTransform().getMatrix() * bones.at(bonePos[i]));
-		bonesWorld.push_back(transform);
-	}
-	return bonesWorld;
+	for (unsigned int i = 0; i < numLinks; i++)
+		bonesWorld[i] = convertToSQTTransform(modelMatrix * bones.at(bonePos[i]));
 }
 
 
 
-void SkinnedObject::calculateIK(const glm::vec3 &dest, const std::string &boneName, unsigned int linkLen, unsigned int maxTries)
+void SkinnedObject::calculateIK(IKObject &ik, const std::string &boneName)
 {
-	if (linkLen == 0)
+	ik.m_Iterations = 0;
+	ik.m_Residual = 0;
+	ik.m_Skipped = false;
+	ik.m_Converged = false;
+	if (ik.m_ChainLength == 0)
 		return;
 
 	//get the actual bone
-	const Bone* currBone = m_SkinnedModel->m_Skeleton->findBone(boneName);
+	const Bone* currBone = m_SkinnedModel->findBone(boneName);
 	if (!currBone)
 	{
 		LOG(ERROR) << "Could not find bone : " << boneName;
 		return;
 	}
 
-	int numBones = linkLen;
-	//tell the render function not to recalculate transforms
-	if(/*!m_alreadyCalculated*/ true)//very important if more than one influence
-	{
-		m_alreadyCalculated = true;
-		//calculate here instead of render function but do not include the inverse bind pose calculation
-		// because we want to apply IK in world space. For this reason, convert the absolute matrix that is returned to world space
-		// until the IK finishes. Then we revert back to mesh space with the inverse model transform and finally
-		// apply the inverse bind pose as usual. Remember that the Inverse Bind Pose moves the vertex from Mesh(Model) space
-		// IN bind pose to the local space of the bone. We don't want that until the IK has finished calculating.
-		m_BoneAbsoluteTransforms = m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms,m_ParentTransforms, false);
-	}
-	
-	SkinnedModel::AbsoluteTransformMap &bones = m_BoneAbsoluteTransforms;
-	
+	int numBones = ik.m_ChainLength;
+	SkinnedModel::AbsolutePose &bones = m_BoneAbsoluteTransforms;
+
 
 	// build a list of the bone chain. Left most position is end effector and each subsequent child is a parent
 	//we need this because the bone map does not store the bones in a hierarchical order necessarily
-	std::vector<int> bonePos;
-	std::vector<SQTTransform> bonesWorld;
-	glm::mat4 globalTransform;
+	//fixed size arrays so solving does not allocate
+	IKChain chain;
 	do
 	{
-		bonePos.push_back(currBone->m_Id);
+		chain.m_Bones.resize(chain.m_Bones.size() + 1);
+		chain.m_Bones[chain.m_Bones.size() - 1] = currBone->m_Id;
 		numBones--;
 		currBone = currBone->m_Parent;
 
 	} while (numBones && currBone->m_Id != -1);
 
-	numBones = bonePos.size();
-
-	bonesWorld = getSelectedBonesInWorld(bones, bonePos);
+	numBones = chain.m_Bones.size();
+	getSelectedBonesInWorld(bones, chain.m_Bones, numBones, chain.m_World);
+	chain.m_InverseModel = glm::inverse(getTransform().getMatrix());
 
-	float totalLength = 0;
-	vector<float> boneLength(numBones);
-	//gather the bone lengths. Very handy when projecting the bones on new axis
+	const glm::vec3 desiredPos = ik.getPosition();
+	//nothing to do if the animation (or the warm start) already put the effector there
+	if (glm::distance2(chain.m_World[0].getPosition(), desiredPos) <= IK_DISTANCE_THRESH)
+		ik.m_Skipped = true;
+	else if (numBones > 1)
+	{
+		switch (ik.m_Solver)
+		{
+		case IKObject::Solver::TWO_BONE:
+			ik.m_Iterations = solveTwoBone(chain, desiredPos);
+			break;
+		case IKObject::Solver::FABRIK:
+			ik.m_Iterations = solveFABRIK(chain, desiredPos, ik.m_MaxTries);
+			break;
+		default:
+			ik.m_Iterations = solveCCD(chain, desiredPos, ik.m_MaxTries);
+			break;
+		}
+	}
+	//every rotation already brought the model space transforms of the moved bones up to date so there is nothing to write back
+	ik.m_Residual = glm::distance(chain.m_World[0].getPosition(), desiredPos);
+	ik.m_Converged = ik.m_Residual * ik.m_Residual <= IK_DISTANCE_THRESH;
+
+	//remember the solution for the next frame. The effector itself is never rotated by the solvers
+	ik.m_LastTarget = desiredPos;
+	ik.m_WarmBones.resize(numBones - 1);
+	ik.m_WarmRotations.resize(numBones - 1);
 	for (int i = 1; i < numBones; i++)
 	{
-		float length = glm::length(bonesWorld[i].getPosition() - bonesWorld[i - 1].getPosition());
-		totalLength += length;
-		boneLength[i-1] = length;
-
+		ik.m_WarmBones[i - 1] = chain.m_Bones[i];
+		ik.m_WarmRotations[i - 1] = m_BoneLocalTransforms[chain.m_Bones[i]].getOrientation();
 	}
+}
+
+void SkinnedObject::warmStartIK(IKObject &ik)
+{
+	ik.m_WarmStarted = false;
+	if (ik.m_WarmStartDistance <= 0 || !ik.m_WarmBones.size())
+		return;
+	if (glm::distance(ik.getPosition(), ik.m_LastTarget) > ik.m_WarmStartDistance)
+		return;
+	//only the rotations. Scale and position keep following the animation
+	for (unsigned int i = 0; i < ik.m_WarmBones.size(); i++)
+		m_BoneLocalTransforms[ik.m_WarmBones[i]].setRotation(ik.m_WarmRotations[i]);
+	ik.m_WarmStarted = true;
+}
 
-	//------------do the actual CCD---------------------------
-	static const float IK_DISTANCE_THRESH = 0.01f;
-	int tries = 0;
-	int currLink = 1; //leftmost pos in vector is effector
+void SkinnedObject::rotateLink(IKChain &chain, unsigned int link, float angle, const glm::vec3 &axis)
+{
+	chain.m_World[link].pivotOnAngleAxis(angle, axis);
+	
+	glm::mat4 currMatW = chain.m_World[link].getMatrix(); //world
+	glm::mat4 currMatM = chain.m_InverseModel * currMatW;//good
+	int boneId = chain.m_Bones[link];
+	glm::mat4 currMatL = glm::inverse(m_ParentTransforms[boneId]) * currMatM; // bone local
+
+	m_BoneLocalTransforms[boneId] = convertToSQTTransform(currMatL);
+	//only the rotated link and the bones below it moved. In the chain those are the links closer to the effector
+	if (m_IKSubtreeUpdate)
+		m_SkinnedModel->updateBoneSubtree(boneId, m_BoneLocalTransforms, m_ParentTransforms, m_BoneAbsoluteTransforms);
+	else
+		m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms, m_ParentTransforms, m_BoneAbsoluteTransforms, false);
+	getSelectedBonesInWorld(m_BoneAbsoluteTransforms, chain.m_Bones, link + 1, chain.m_World);
+}
 
-	glm::vec3 effectorPos; // the position of the end effector
-	glm::vec3 currPos;// the position of the bone that we are currently rotating
+bool SkinnedObject::aimLink(IKChain &chain, unsigned int link, unsigned int child, const glm::vec3 &target)
+{
+	glm::vec3 currPos = chain.m_World[link].getPosition();// the position of the bone that we are currently rotating
+	//vector to current child pos
+	glm::vec3 currDir = chain.m_World[child].getPosition() - currPos;
+	//desired child position
+	glm::vec3 targetDir = target - currPos;
+	if (glm::length2(currDir) < 1e-12f || glm::length2(targetDir) < 1e-12f)
+		return false;
 
-	const glm::vec3 &desiredPos = dest;
-	do
-	{
-		effectorPos = bonesWorld[0].getPosition(); //lower number -> closer to effectorPos
-		currPos = bonesWorld[currLink].getPosition();
+	currDir = glm::normalize(currDir);
+	targetDir = glm::normalize(targetDir);
 
-		//quit if close enough
-		float distance = glm::distance2(effectorPos, desiredPos);
-		if (distance > IK_DISTANCE_THRESH)
-		{
-			//vector to current effectorPos pos
-			glm::vec3 currDir = effectorPos - currPos;
-			//desired effectorPos position
-			glm::vec3 targetDir = desiredPos - currPos;
+	//how much of the current vector lies on the target vector (how much of it is projected onto the other)
+	float cosAngle = glm::dot(currDir, targetDir);
 
-			currDir = glm::normalize(currDir);
-			targetDir = glm::normalize(targetDir);
+	//if the dot product over some threshold then don't rotate
+	if (cosAngle >= 0.99999)
+		return false;
 
-			//how much of the current vector lies on the target vector (how much of it is projected onto the other)
-			float cosAngle = glm::dot(currDir, targetDir);
+	float turnAngle = acos(glm::clamp(cosAngle, -1.0f, 1.0f)); // radians
+	//get the axis of rotation
+	glm::vec3 rotAxis = glm::cross(currDir, targetDir);
+	//directions pointing exactly away from each other. Any perpendicular axis will do
+	if (glm::length2(rotAxis) < 1e-12f)
+	{
+		rotAxis = glm::cross(currDir, glm::vec3(1.0f, 0.0f, 0.0f));
+		if (glm::length2(rotAxis) < 1e-12f)
+			rotAxis = glm::cross(currDir, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	rotateLink(chain, link, turnAngle, glm::normalize(rotAxis));
+	return true;
+}
 
-			//if the dot product over some threshold then don't rotate
-			if (cosAngle < 0.99999)
-			{
+unsigned int SkinnedObject::solveCCD(IKChain &chain, const glm::vec3 &desiredPos, unsigned int maxTries)
+{
+	unsigned int numBones = chain.m_Bones.size();
+	unsigned int tries = 0;
+	unsigned int currLink = 1; //leftmost pos in vector is effector
+	do
+	{
+		//quit if close enough
+		if (glm::distance2(chain.m_World[0].getPosition(), desiredPos) <= IK_DISTANCE_THRESH)
+			break;
+		aimLink(chain, currLink, 0, desiredPos);
+		currLink++;
+		if (currLink > numBones - 1) // start again
+			currLink = 1;
+	} while (++tries <= maxTries);
+	return tries;
+}
 
-				float turnAngle = acos(cosAngle); // radians
-				//get the axis of rotation
-				glm::vec3 rotAxis = glm::cross(currDir, targetDir);
-				//rotate the current bone
-				bonesWorld[currLink].pivotOnAngleAxis(turnAngle, rotAxis);
-				//dampen
-				//bonesWorld[currLink].setRotation(dampen(bonesWorld[currLink].getOrientation(), glm::vec3(90.0f)));
-				
-				glm::mat4 currMatW = bonesWorld[currLink].getMatrix(); //world
-				glm::mat4 currMatM = glm::inverse(getTransform().getMatrix()) * currMatW;//good
-				glm::mat4 currMatL = glm::inverse(m_ParentTransforms[bonePos[currLink]]) * currMatM; // bone local
-
-				m_BoneLocalTransforms[bonePos[currLink]] = convertToSQTTransform(currMatL);
-				bones = m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms, m_ParentTransforms, false);
-				bonesWorld = getSelectedBonesInWorld(bones, bonePos);
-				//----------------------
-			}
-			currLink++;
-			if (currLink > numBones - 1) // start again
-				currLink = 1;
-		}
-	} while (/*currLink != 1||*/ tries++ < maxTries && glm::distance2(effectorPos, desiredPos) > IK_DISTANCE_THRESH);
-	
+unsigned int SkinnedObject::solveTwoBone(IKChain &chain, const glm::vec3 &desiredPos)
+{
+	//a chain of a single link can only point at the target, which is exact in one step
+	if (chain.m_Bones.size() < 3)
+	{
+		aimLink(chain, 1, 0, desiredPos);
+		return 1;
+	}
+
+	//links 2 (root), 1 (middle) and 0 (effector). Links further up are left alone
+	glm::vec3 root = chain.m_World[2].getPosition();
+	glm::vec3 middle = chain.m_World[1].getPosition();
+	glm::vec3 effector = chain.m_World[0].getPosition();
+	float upperLength = glm::length(middle - root);
+	float lowerLength = glm::length(effector - middle);
+	if (upperLength < 1e-6f || lowerLength < 1e-6f)
+		return 0;
+
+	//the distance the root and effector will be at. Kept slightly inside the reach so the triangle does not degenerate
+	float targetLength = glm::length(desiredPos - root);
+	float minLength = fabs(upperLength - lowerLength) + 1e-4f;
+	float maxLength = upperLength + lowerLength - 1e-4f;
+	targetLength = glm::clamp(targetLength, minLength, maxLength);
+
+	//law of cosines gives the angle the middle joint has to open to
+	float cosDesired = (upperLength * upperLength + lowerLength * lowerLength - targetLength * targetLength) / (2.0f * upperLength * lowerLength);
+	float desiredAngle = acos(glm::clamp(cosDesired, -1.0f, 1.0f));
+	glm::vec3 toRoot = glm::normalize(root - middle);
+	glm::vec3 toEffector = glm::normalize(effector - middle);
+	float currAngle = acos(glm::clamp(glm::dot(toRoot, toEffector), -1.0f, 1.0f));
+
+	//rotating the lower bone about this axis opens the angle between the two bones
+	glm::vec3 bendAxis = glm::cross(toRoot, toEffector);
+	if (glm::length2(bendAxis) < 1e-12f) //fully stretched or folded. bend towards the target instead
+		bendAxis = glm::cross(toRoot, desiredPos - middle);
+	if (glm::length2(bendAxis) > 1e-12f && fabs(desiredAngle - currAngle) > 1e-5f)
+		rotateLink(chain, 1, desiredAngle - currAngle, glm::normalize(bendAxis));
+
+	//with the right distance between root and effector, swing the root so the effector lands on the target
+	aimLink(chain, 2, 0, desiredPos);
+	return 1;
+}
+
+unsigned int SkinnedObject::solveFABRIK(IKChain &chain, const glm::vec3 &desiredPos, unsigned int maxTries)
+{
+	unsigned int numBones = chain.m_Bones.size();
+	BoneArray<glm::vec3> positions;
+	BoneArray<float> boneLength;
+	positions.resize(numBones);
+	boneLength.resize(numBones);
+	float totalLength = 0;
+	for (unsigned int i = 0; i < numBones; i++)
+		positions[i] = chain.m_World[i].getPosition();
+	//gather the bone lengths. boneLength[i] is the distance between link i and its parent
+	for (unsigned int i = 0; i + 1 < numBones; i++)
+	{
+		boneLength[i] = glm::length(positions[i + 1] - positions[i]);
+		totalLength += boneLength[i];
+	}
 
-	//we had worked the CCD in world space. Now revert back from world to model 
-	for (int i = 0; i < numBones; i++)
+	const glm::vec3 rootPos = positions[numBones - 1];
+	unsigned int tries = 0;
+	if (glm::length(desiredPos - rootPos) >= totalLength)
 	{
-		bones[bonePos[i]] = glm::inverse(getTransform().getMatrix()) * bonesWorld[i].getMatrix();
+		//out of reach. the best is a straight chain pointing at the target
+		glm::vec3 direction = glm::normalize(desiredPos - rootPos);
+		for (int i = numBones - 2; i >= 0; i--)
+			positions[i] = positions[i + 1] + direction * boneLength[i];
+		tries = 1;
 	}
-	//... and from model to bone space (for ALL bones of skeleton)
-	for (int i = 0; i < bones.size(); i++)
+	else
 	{
-		bones[i] *= m_SkinnedModel->m_Skeleton->findBone(i)->m_InverseBindPose;
+		while (tries < maxTries && glm::distance2(positions[0], desiredPos) > IK_DISTANCE_THRESH)
+		{
+			//backward pass: pin the effector on the target and pull the parents after it
+			positions[0] = desiredPos;
+			for (unsigned int i = 1; i < numBones; i++)
+			{
+				glm::vec3 direction = positions[i] - positions[i - 1];
+				float length = glm::length(direction);
+				if (length > 1e-6f)
+					positions[i] = positions[i - 1] + direction * (boneLength[i - 1] / length);
+			}
+			//forward pass: pin the root back in place and push the children out again
+			positions[numBones - 1] = rootPos;
+			for (int i = numBones - 2; i >= 0; i--)
+			{
+				glm::vec3 direction = positions[i] - positions[i + 1];
+				float length = glm::length(direction);
+				if (length > 1e-6f)
+					positions[i] = positions[i + 1] + direction * (boneLength[i] / length);
+			}
+			tries++;
+		}
 	}
+
+	//turn the solved positions into rotations from the root down so every link is aimed from its final place
+	for (unsigned int i = numBones - 1; i > 0; i--)
+		aimLink(chain, i, i - 1, positions[i - 1]);
+	return tries;
 }
 
 //@todo cleanup Id lookup. Currently this function is not used
@@ -335,9 +504,17 @@ glm::mat4 SkinnedObject::calculateGlobalTransform(const Bone *currBone)
 }
 
 
-void SkinnedObject::attachIK(IKObject::IkType ikType, const std::string &boneName, glm::vec3 position, unsigned int chainLength, unsigned int maxTries)
+void SkinnedObject::attachIK(IKObject::IkType ikType, const std::string &boneName, glm::vec3 position, unsigned int chainLength, unsigned int maxTries,
+	IKObject::Solver solver, float warmStartDistance)
 {
 	IKObject newIK;
+	newIK.m_Solver = solver;
+	newIK.m_Iterations = 0;
+	newIK.m_Residual = 0;
+	newIK.m_Skipped = false;
+	newIK.m_Converged = false;
+	newIK.m_WarmStarted = false;
+	newIK.m_WarmStartDistance = warmStartDistance;
 	newIK.m_ChainLength = chainLength;
 	newIK.m_MaxTries = maxTries;
 	newIK.m_Position = position;
@@ -358,11 +535,21 @@ IKObject& SkinnedObject::getIK(const std::string &boneName)
 
 void SkinnedObject::calculateIKs()
 {
-	IKObjectMap::const_iterator it = m_IKObjectMap.begin();
+	//do not include the inverse bind pose calculation because we want to apply IK in world space.
+	// The chain is converted to world space until the IK finishes. Then we revert back to mesh space with the inverse model transform and finally
+	// apply the inverse bind pose as usual. Remember that the Inverse Bind Pose moves the vertex from Mesh(Model) space
+	// IN bind pose to the local space of the bone. We don't want that until every IK has finished calculating.
+	//warm starts go in before so the single evaluation already includes them
+	IKObjectMap::iterator it = m_IKObjectMap.begin();
 	for (; it != m_IKObjectMap.end(); ++it)
+		warmStartIK(it->second);
+	m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms, m_ParentTransforms, m_BoneAbsoluteTransforms, false);
+	for (it = m_IKObjectMap.begin(); it != m_IKObjectMap.end(); ++it)
 	{
-			calculateIK(it->second.getPosition(), it->first, it->second.m_ChainLength, it->second.m_MaxTries);
+			calculateIK(it->second, it->first);
 	}
+	//... and from model to bone space (for ALL bones of skeleton)
+	m_SkinnedModel->applyInverseBindPose(m_BoneAbsoluteTransforms);
 }
 
 SkinnedObject::IKObjectMap& SkinnedObject::getAllIKs()
@@ -382,21 +569,22 @@ void SkinnedObject::calculateAnimation()
 		//save off the last frame of the current animation
 		m_TimeExpired = 0;
 		m_TransitionTime = 0;
-		m_CurrBlendPallete = m_BoneLocalTransforms;
+		m_CurrBlendPose.load(m_BoneLocalTransforms);
 		if(m_AnimQueue.size() > 0)
 			m_AnimQueue.pop_front();
 		if(m_AnimQueue.size() == 0)
 			m_AnimQueue.push_back(m_SkinnedModel->getIdleAnimation());
 		m_Blending = true;
-		m_AnimQueue.front()->getTransforms(0, m_NextBlendPallete);
+		m_NextBlendPose = PoseCache::get().getPose(m_SkinnedModel, m_AnimQueue.front(), 0, m_AnimStorage, &m_AnimCursor);
 	}
 
 	if(m_Blending)
 	{
 		m_SwapAnim = false;
 		float blendFactor = m_TransitionTime/blendTime;
-		for(int i = 0; i < m_NextBlendPallete.size(); i++)
-			m_BoneLocalTransforms[i] = m_CurrBlendPallete.at(i).interpolate(m_NextBlendPallete.at(i), blendFactor); 
+		//all the bones in one go
+		PoseKernel::get().blend(m_CurrBlendPose, m_NextBlendPose, blendFactor, m_Pose);
+		m_Pose.store(m_BoneLocalTransforms);
 		
 		m_TransitionTime += deltaTime;
 		if(m_TransitionTime >= blendTime)
@@ -407,11 +595,13 @@ void SkinnedObject::calculateAnimation()
 		if(m_TimeExpired >= m_AnimQueue.front()->m_TotalDuration)
 		{
 			m_SwapAnim = true;
-			m_AnimQueue.front()->getTransforms(m_AnimQueue.front()->m_TotalDuration - 0.01, m_BoneLocalTransforms);
+			const Animation *anim = m_AnimQueue.front();
+			PoseCache::get().getPose(m_SkinnedModel, anim, anim->m_TotalDuration - 0.01, m_AnimStorage, &m_AnimCursor).store(m_BoneLocalTransforms);
 		}
 		else
 		{
-			m_AnimQueue.front()->getTransforms(m_TimeExpired,m_BoneLocalTransforms);
+			//instances playing the same animation at about the same time share the sampled pose
+			PoseCache::get().getPose(m_SkinnedModel, m_AnimQueue.front(), m_TimeExpired, m_AnimStorage, &m_AnimCursor).store(m_BoneLocalTransforms);
 			m_TimeExpired += deltaTime*m_AnimSpeed;
 		}
 	}
@@ -419,6 +609,11 @@ void SkinnedObject::calculateAnimation()
 }
 
 
+void SkinnedObject::setAnimStorage(AnimStorage storage)
+{
+	m_AnimStorage = storage;
+}
+
 const Animation* SkinnedObject::getCurrentAnim()
 {
 	if(m_AnimQueue.size()>0)
@@ -460,20 +655,42 @@ void SkinnedObject::generateAABB()
 		m_AABB.add(max);
 		m_AABB.m_Enabled = true;
 		m_AABB.generateDisplayBox();
+		//optional. the box above is still used for the display mesh and until the first frame
+		luapath::Value fromPose;
+		if(aabbTable.getValue(".fromPose", fromPose))
+			m_PoseBounds = fromPose;
 	}
 }
 
+void SkinnedObject::lateUpdate()
+{
+	Object::lateUpdate();
+	if (m_PoseBounds)
+		m_AABB.fit(skinVertices(true).m_Positions);
+}
+
+const SkinnedBuffer& SkinnedObject::skinVertices(bool parallel)
+{
+	//skin straight into world space
+	BoneArray<glm::mat4> palette;
+	palette.resize(m_BoneAbsoluteTransforms.size());
+	glm::mat4 modelMatrix = getTransform().getMatrix();
+	for (unsigned int i = 0; i < palette.size(); i++)
+		palette[i] = modelMatrix * m_BoneAbsoluteTransforms[i];
+	SkinningKernel::get().skin(*m_SkinnedModel, palette, m_SkinnedVertices, parallel);
+	return m_SkinnedVertices;
+}
+
 
 void SkinnedObject::update()
 {
 	Object::update();
 	calculateAnimation();
-	calculateIKs();
-	SkinnedModel::AbsoluteTransformMap dummy; // fix later.
-	if (!m_alreadyCalculated)
-		m_BoneAbsoluteTransforms = m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms, dummy, true);
-
-	m_alreadyCalculated = false;
+	//the IKs are solved for all objects together once everyone has updated
+	if (m_IKObjectMap.empty())
+		m_SkinnedModel->getAbsoluteBoneTransforms(m_BoneLocalTransforms, m_ParentTransforms, m_BoneAbsoluteTransforms, true);
+	else
+		IKBatch::get().add(this);
 
 }
 
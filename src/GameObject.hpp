@@ -4,6 +4,8 @@
 #include "Model.hpp"
 #include "SQTTransform.hpp"
 #include "AABB.hpp"
+#include "SkinningKernel.hpp"
+#include "BonePalette.hpp"
 
 #include <deque>
 
@@ -46,12 +48,14 @@ public:
 	/** @brief Returns a reference to the local transformation used to update the scale, translation and rotation of the object*/
 	virtual SQTTransform& getTransform();
 
-	/**writes to the uniform matrices to the assigned shader of the underlying model.
-	  Then calls the Model render function to render the primitives
+	/**Queues the meshes of the underlying model in RenderQueue with the model matrix of the object.
+	  The camera comes from FrameConstants
 	  */
 	virtual void render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
 
 	virtual void update();
+	/**@brief Runs after every object has been updated and the IK batch has been solved so the final poses are available*/
+	virtual void lateUpdate();
 	virtual void generateAABB();
 	virtual bool intersect(const AABB &other);
 
@@ -70,18 +74,36 @@ public:
 	float m_AnimationSpeedModifier;
 	float m_LastCollisionTime;
 	State m_State;
+	unsigned int m_Lod; //!< level of detail the model is drawn with. 0 is the full mesh
 protected:
 	SQTTransform m_Transform; //!< the transform changed to move the object around the world
 	Object();
+
+	/**@brief Pick m_Lod from the share of the screen height the bounding sphere of m_AABB covers, with the thresholds of the model.
+		Objects without bounds keep the full mesh*/
+	void selectLod(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
 };
 
 struct IKObject
 {
 public:
 	enum class IkType{LOCAL, GLOBAL};
+	/**@brief CCD handles any chain. TWO_BONE is closed form for a root, a middle joint and the effector. FABRIK moves the joint positions and then aims each link*/
+	enum class Solver{CCD, TWO_BONE, FABRIK};
 	unsigned int m_MaxTries;
 	unsigned int m_ChainLength;
 	IkType m_IkType;
+	Solver m_Solver;
+	unsigned int m_Iterations; //!< iterations the last solve used
+	float m_Residual; //!< distance from the end effector to the target after the last solve
+	bool m_Skipped; //!< the effector was already on the target so the last solve did nothing
+	bool m_Converged; //!< the last solve got the effector within the threshold of the target
+	bool m_WarmStarted; //!< the last solve started from the rotations of the solve before it
+
+	float m_WarmStartDistance; //!< the solve starts from the last solved rotations if the target moved less than this. 0 disables it
+	glm::vec3 m_LastTarget; //!< target of the last solve
+	BoneArray<int> m_WarmBones; //!< the links of the last solve which it could have rotated. Empty until the first solve
+	BoneArray<glm::quat> m_WarmRotations; //!< local rotations of m_WarmBones after the last solve
 	SkinnedObject *m_Parent;
 	void move(float x, float y, float z);
 	glm::vec3 getPosition() const;
@@ -95,7 +117,6 @@ private:
 @todo playAnimPriority - play new anim first and continue from last after its finished
 @todo Allow alternative for IKs that are locally attached to the Model instead of globally
 @todo account for overlapping IKs
-@todo Fix the alreadyCalculated optimization trick (*ahem* necessity) in calculateIK function if more than one IK
 @todo Add biped bone constraints
 */
 class SkinnedObject
@@ -118,9 +139,11 @@ public:
 	SQTTransform& getBoneTransform(const std::string &boneName);
 	SQTTransform getBoneGlobalTransform(const Bone *bone);
 
-	/**Before calling Object render, calculates and writes the bone matrices to the gpu */
+	/**Writes the bone matrices to the BonePalette ring and queues the meshes with them */
 	virtual void render(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
 
+	/**@brief Choose between the sparse keys and the resampled dense frames of the animations this object plays. Sparse unless set*/
+	void setAnimStorage(AnimStorage storage);
 	const Animation* getCurrentAnim();
 	void flushAnimQueue();
 	void playAnimFlushBlend(const std::string &animName, float animSpeed);
@@ -128,12 +151,17 @@ public:
 
 	typedef std::map<std::string, IKObject> IKObjectMap;//!< Helps the object keep track of the IK attachments
 	/**@brief Attach an IK influence to a particular bone */
-	void attachIK(IKObject::IkType ikType, const std::string &boneName, glm::vec3 position, unsigned int chainLength, unsigned int maxTries);
+	void attachIK(IKObject::IkType ikType, const std::string &boneName, glm::vec3 position, unsigned int chainLength, unsigned int maxTries,
+		IKObject::Solver solver = IKObject::Solver::CCD, float warmStartDistance = 0.0f);
 	/**@brief remove IK influence from a bone */
 	void detachIK(const std::string &boneName);
 	/**@brief Retieve IK of a bone so it can be updated */
 	IKObject& getIK(const std::string &boneName);
-	/**@brief Calls all bones with IK influence to be recomputed */
+	/**@brief Calls all bones with IK influence to be recomputed
+		@details The skeleton is evaluated once before the first IK and the inverse bind pose applied once after the last one.
+		The IKs are solved one after the other on the same pose so several of them can share a skeleton.
+		Called by IKBatch, possibly on a worker thread, so it may only touch this object
+	*/
 	void calculateIKs();
 	/**@brief Retrieves all IKs */
 	IKObjectMap& getAllIKs();
@@ -145,8 +173,13 @@ public:
 	glm::mat4 calculateGlobalTransform(const Bone *currBone);
 
 	virtual void update();
+	/**@brief Fits the bounding box to the skinned mesh if the model asks for pose bounds*/
+	virtual void lateUpdate();
 
 	virtual void generateAABB();
+
+	/**@brief Skin the meshes on the cpu with the current pose. The result is in world space and stays valid until the next call*/
+	const SkinnedBuffer& skinVertices(bool parallel = false);
 	
 protected:
 	/**
@@ -157,16 +190,45 @@ protected:
 	*/
 	//void calculateAnimation(double deltaTime);
 	
+	/**@brief Scratch state of a single IK solve. Link 0 is the end effector and every following link is the parent of the previous one*/
+	struct IKChain
+	{
+		BoneArray<int> m_Bones; //!< bone ids of the links
+		BoneArray<SQTTransform> m_World; //!< world transforms of the links
+		glm::mat4 m_InverseModel; //!< world to model space
+	};
+
 	/**
-	@brief Calculates the IK influence for a single bone using CCD
+	@brief Calculates the IK influence of @param ik on the bone @param boneName with the solver it asks for.
+		Expects and leaves m_BoneAbsoluteTransforms in model space without the inverse bind pose.
+		Writes the iterations used and the residual error back to @param ik
 	*/
-	void calculateIK(const glm::vec3 &dest, const std::string &boneName, unsigned int linkLen, unsigned int maxTries);
+	void calculateIK(IKObject &ik, const std::string &boneName);
 
-	/**@brief applies the Model matrix to all the @param bones as specified in @param bonePos 
-		@return the resulting subset
+	/**@brief Put the rotations of the last solve of @param ik back in the local pose if its target has not moved further than its warm start distance*/
+	void warmStartIK(IKObject &ik);
+
+	/**@brief Rotate @param link of @param chain in world space and bring the bones below it up to date*/
+	void rotateLink(IKChain &chain, unsigned int link, float angle, const glm::vec3 &axis);
+	/**@brief Rotate @param link so the link @param child below it points at @param target. Returns false if no rotation was needed*/
+	bool aimLink(IKChain &chain, unsigned int link, unsigned int child, const glm::vec3 &target);
+	/**@brief Cyclic coordinate descent. One link is aimed per iteration. Returns the iterations used*/
+	unsigned int solveCCD(IKChain &chain, const glm::vec3 &desiredPos, unsigned int maxTries);
+	/**@brief Closed form solve of the last two links before the effector. Chains of a single link are aimed. Returns the iterations used*/
+	unsigned int solveTwoBone(IKChain &chain, const glm::vec3 &desiredPos);
+	/**@brief Forward and backward reaching IK over the joint positions. Returns the iterations used*/
+	unsigned int solveFABRIK(IKChain &chain, const glm::vec3 &desiredPos, unsigned int maxTries);
+
+	/**@brief applies the Model matrix to the first @param numLinks @param bones as specified in @param bonePos 
+		and writes the resulting subset to @param bonesWorld. The other entries are left as they are
 	*/
-	std::vector<SQTTransform> getSelectedBonesInWorld(const SkinnedModel::AbsoluteTransformMap bones,
-		const std::vector<int> bonePos);
+	void getSelectedBonesInWorld(const SkinnedModel::AbsolutePose &bones, const BoneArray<int> &bonePos,
+		unsigned int numLinks, BoneArray<SQTTransform> &bonesWorld);
+
+	/**@brief For skinned objects of a model that is not in the ModelManager*/
+	SkinnedObject(const std::string &objectName,
+		const SkinnedModel *model,
+		const SQTTransform &transform = SQTTransform());
 
 
 
@@ -182,23 +244,27 @@ protected:
 	//!< The skinned object pops animation instances from here and plays them. the ...Anim... functions control the queue
 	typedef std::deque<const Animation*> AnimQueue;
 	AnimQueue m_AnimQueue;
+	//!< remembers where the key search for the front animation left off
+	AnimCursor m_AnimCursor;
+	//!< which keyframe representation the animations are sampled from
+	AnimStorage m_AnimStorage;
 
-	//!< the bone matrix location in the shader
-	GLuint m_BoneLocation;
 	//!<that is changeable through the rotateBone function. All else can be stored in SkinnedModel because it does not change
-	SkinnedModel::LocalTransformMap m_BoneLocalTransforms;
+	SkinnedModel::LocalPose m_BoneLocalTransforms;
 	//!<The individual parent transforms for each bone
-	SkinnedModel::AbsoluteTransformMap m_ParentTransforms;
+	SkinnedModel::AbsolutePose m_ParentTransforms;
 	//!<store the bone matrices which go to the shader
-	SkinnedModel::AbsoluteTransformMap m_BoneAbsoluteTransforms;
-	//!< signifies whether the bone absolute transforms have already been computed. That would happen if IK was called before render
-	bool m_alreadyCalculated;
+	SkinnedModel::AbsolutePose m_BoneAbsoluteTransforms;
 
 	float m_TimeExpired;
 	float m_TransitionTime;
 	bool m_Blending;
 	bool m_SwapAnim;
 	float m_AnimSpeed;
-	std::map<unsigned int, SQTTransform> m_CurrBlendPallete;
-	std::map<unsigned int, SQTTransform> m_NextBlendPallete;
+	PoseBuffer m_CurrBlendPose; //!< the pose the blend starts from
+	PoseBuffer m_NextBlendPose; //!< the first pose of the next animation
+	PoseBuffer m_Pose; //!< scratch pose the animation is sampled and blended into
+	bool m_PoseBounds; //!< fit the bounding box to the skinned vertices every frame instead of using the fixed one from the settings
+	bool m_IKSubtreeUpdate; //!< a rotated IK link updates only the bones below it. false recomputes the whole skeleton, as the solver used to
+	SkinnedBuffer m_SkinnedVertices; //!< reused by skinVertices
 };
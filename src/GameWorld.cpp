@@ -8,6 +8,15 @@
 #include "Control.hpp"
 #include "Timer.hpp"
 #include "Curve.hpp"
+#include "PoseCache.hpp"
+#include "IKBatch.hpp"
+#include "WorkerPool.hpp"
+#include "BonePalette.hpp"
+#include "RenderQueue.hpp"
+#include "FrameConstants.hpp"
+#include "FrustumCuller.hpp"
+#include "OcclusionCuller.hpp"
+#include "StaticBatch.hpp"
 #include "math_utilities.h"
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -17,6 +26,7 @@
 
 #include <cstdlib>
 #include <ctime>
+#include <sstream>
 
 using std::vector;
 using std::string;
@@ -42,9 +52,42 @@ GameWorld::GameWorld()
 		setMode(DisplayMode::NORMAL);
 	loadSkybox();
 	loadLevel();
+	StaticBatch::get().add(m_Skybox);
+	StaticBatch::get().add(m_Level);
+	StaticBatch::get().add(m_Gate);
+	StaticBatch::get().build();
 	loadEnemies();
 	luapath::Table animationTable = settings.getGlobalTable("animation");
 	m_BlendTime = animationTable.getValue(".blendTime");
+	luapath::Value poseCacheStep;
+	if(animationTable.getValue(".poseCacheStep", poseCacheStep))
+	{
+		float step = poseCacheStep;
+		PoseCache::get().setStep(step);
+	}
+	//negative picks one worker less than the number of cores as the main thread works too
+	luapath::Table workerTable = settings.getGlobalTable("workerPool");
+	int workers = -1;
+	luapath::Value workersValue;
+	if(workerTable.getValue(".workers", workersValue))
+		workers = (int)(float)workersValue;
+	if(workers < 0)
+		workers = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+	WorkerPool::get().setNumWorkers(workers);
+	luapath::Table paletteTable = settings.getGlobalTable("bonePalette");
+	float paletteCapacity = paletteTable.getValue(".capacity");
+	BonePalette::get().init((unsigned int)paletteCapacity);
+	FrameConstants::get().init();
+	luapath::Table queueTable = settings.getGlobalTable("renderQueue");
+	unsigned int instanceCapacity = 4096;
+	luapath::Value instanceCapacityValue;
+	if(queueTable.getValue(".instanceCapacity", instanceCapacityValue))
+		instanceCapacity = (unsigned int)(float)instanceCapacityValue;
+	RenderQueue::get().init(instanceCapacity);
+	luapath::Table occlusionTable = settings.getGlobalTable("occlusion");
+	float occlusionWidth = occlusionTable.getValue(".width");
+	float occlusionHeight = occlusionTable.getValue(".height");
+	OcclusionCuller::get().init((unsigned int)occlusionWidth, (unsigned int)occlusionHeight);
 
 	//m_Player = new Player();
 
@@ -65,6 +108,8 @@ GameWorld::GameWorld()
 
 GameWorld::~GameWorld()
 {
+	//the workers may be working on objects owned here
+	WorkerPool::get().setNumWorkers(0);
 	std::map<std::string, Object*>::iterator it = m_AllObjects.begin();
 	for (; it != m_AllObjects.end(); ++it)
 		delete it->second;
@@ -230,12 +275,18 @@ void GameWorld::updateWorldIntro()
 		break;
 	}
 	//case independent updates
-	
+	PoseCache::get().newFrame();
 	m_Player.getCharacter()->update();
 	for(enemy = m_Enemies.begin(); enemy != m_Enemies.end(); ++enemy)
 	{
 		enemy->second->update();
 	}
+	IKBatch::get().solve();
+	m_Player.getCharacter()->lateUpdate();
+	for(enemy = m_Enemies.begin(); enemy != m_Enemies.end(); ++enemy)
+	{
+		enemy->second->lateUpdate();
+	}
 	render();
 	CommandQueue::get().process();
 	setViewMatrix(m_Player.getViewMatrix());
@@ -246,6 +297,7 @@ void GameWorld::updateWorldIntro()
 void GameWorld::updateWorld()
 {
 	Timer::get().updateInterval();
+	PoseCache::get().newFrame();
     Control::get().handleInput();
 	CommandQueue::get().process();
 	setViewMatrix(m_Player.getViewMatrix());
@@ -255,17 +307,31 @@ void GameWorld::updateWorld()
 	//magic!
 	std::map<string,string> collisionMap; // keeps track of which objects have collided
 	std::map<std::string, Object*>::const_iterator obj = m_AllObjects.begin();
-	
 	for(;obj != m_AllObjects.end(); ++obj)
 	{
 		if (obj->second->m_State == Object::State::DEACTIVE)
 			continue;
 		obj->second->update(); // please don't forget: don't do updating in the render method
+	}
+	//the skinned objects queued their IKs while updating. Solve them all at once
+	IKBatch::get().solve();
+
+	//every box has to be final before any pair is tested
+	for(obj = m_AllObjects.begin();obj != m_AllObjects.end(); ++obj)
+	{
+		if (obj->second->m_State == Object::State::DEACTIVE)
+			continue;
+		obj->second->lateUpdate();
 		if(glm::length(obj->second->getTransform().getPosition()) > m_LevelRadius)
 		{
 			CommandQueue::get().addCommandDisposable(new CommandLevelCollision(obj->second->m_Name));
 		}
+	}
 
+	for(obj = m_AllObjects.begin();obj != m_AllObjects.end(); ++obj)
+	{
+		if (obj->second->m_State == Object::State::DEACTIVE)
+			continue;
 		std::map<std::string, Object*>::const_iterator obj2 = m_AllObjects.begin();
 		for(;obj2 != m_AllObjects.end(); ++obj2)
 		{
@@ -330,21 +396,68 @@ void GameWorld::updateWorld()
 
 void GameWorld::render() const
 {
-	m_Level->render(m_ViewMatrix, m_ProjMatrix);
-	m_Gate->render(m_ViewMatrix, m_ProjMatrix);
-	m_Skybox->render(m_ViewMatrix, m_ProjMatrix);
+	FrameConstants::get().upload((float)Timer::get().getTime());
+	BonePalette::get().beginFrame();
+	RenderQueue::get().beginFrame(m_ViewMatrix, m_ProjMatrix);
+	StaticBatch::get().render();
 
 
+	//objects outside the view are neither queued nor write their palette. Attachments and health bars go with their character.
+	//objects without bounds are always drawn
+	FrustumCuller &culler = FrustumCuller::get();
+	culler.beginFrame(m_ProjMatrix * m_ViewMatrix);
 	std::map<std::string, Object*>::const_iterator it = m_AllObjects.begin();
 	for (; it != m_AllObjects.end(); ++it)
 	{
+		if (it->second->m_AABB.m_Enabled)
+			culler.add(it->second->m_AABB.m_Min, it->second->m_AABB.m_Max);
+	}
+	culler.cull();
+
+	//the level hides the characters on the far side of it from the low camera
+	OcclusionCuller &occlusion = OcclusionCuller::get();
+	occlusion.beginFrame(m_ProjMatrix * m_ViewMatrix);
+	if (m_Level->m_Model->m_Occluder)
+		occlusion.addOccluder(m_Level->m_Model, m_Level->getTransform().getMatrix());
+	if (m_Gate->m_Model->m_Occluder)
+		occlusion.addOccluder(m_Gate->m_Model, m_Gate->getTransform().getMatrix());
+	occlusion.rasterize();
+
+	unsigned int box = 0;
+	for (it = m_AllObjects.begin(); it != m_AllObjects.end(); ++it)
+	{
+		const AABB &bounds = it->second->m_AABB;
+		if (bounds.m_Enabled && (!culler.isVisible(box++) || occlusion.isOccluded(bounds.m_Min, bounds.m_Max)))
+			continue;
 		it->second->render(m_ViewMatrix, m_ProjMatrix);
 	}
 
 	if(m_DebugEnabled)
 		renderDebug();
+	RenderQueue::get().flush();
+	BonePalette::get().endFrame();
+	if(m_DebugEnabled)
+		reportFrame();
+}
 
-	
+void GameWorld::reportFrame() const
+{
+	const RenderQueue &queue = RenderQueue::get();
+	std::stringstream report;
+	report << "frame : draws " << queue.getDraws() << " (+" << StaticBatch::get().getDraws() << " static)"
+		<< ", instances " << queue.getInstances()
+		<< ", state changes " << queue.getStateChanges()
+		<< ", skipped binds " << queue.getSkippedBinds();
+	report << ", triangles per lod";
+	for(unsigned int lod = 0; lod < Mesh::MAX_LODS; lod++)
+		report << " " << queue.getTriangles(lod);
+	report << ", frustum visible " << FrustumCuller::get().getVisible() << " culled " << FrustumCuller::get().getCulled()
+		<< ", occlusion tested " << OcclusionCuller::get().getTested() << " occluded " << OcclusionCuller::get().getOccluded();
+	report << ", pose cache hits " << PoseCache::get().getHits() << " misses " << PoseCache::get().getMisses();
+	const IKBatch &ik = IKBatch::get();
+	report << ", ik solves " << ik.getSolves() << " skipped " << ik.getSkipped() << " warm starts " << ik.getWarmStarts()
+		<< " iterations " << ik.getIterations() << " failures " << ik.getFailures();
+	LOG(INFO) << report.str();
 }
 
 void GameWorld::renderDebug() const
@@ -452,6 +565,7 @@ void GameWorld::setMode(DisplayMode mode)
 void GameWorld::setViewMatrix(const glm::mat4 &view)
 {
 	m_ViewMatrix = view;
+	FrameConstants::get().setViewMatrix(view);
 }
 glm::mat4 GameWorld::getViewMatrix() const
 {
@@ -461,6 +575,7 @@ glm::mat4 GameWorld::getViewMatrix() const
 void GameWorld::setProjectionMatrix(const glm::mat4 &projection)
 {
 	m_ProjMatrix = projection;
+	FrameConstants::get().setProjectionMatrix(projection);
 }
 glm::mat4 GameWorld::getProjectionMatrix() const
 {
@@ -529,6 +644,17 @@ void GameWorld::loadEnemies()
 {
 	luapath::LuaState settings("config/settings.lua");
 	luapath::Table enemyTable = settings.getGlobalTable("enemies");
+	//the crowd can trade memory for cpu by sampling the resampled dense frames
+	AnimStorage animStorage = AnimStorage::SPARSE;
+	luapath::Value storageValue;
+	if(enemyTable.getValue(".animStorage", storageValue))
+	{
+		string storage = storageValue;
+		if(storage == "sparse")
+			animStorage = AnimStorage::SPARSE;
+		else if(storage == "dense")
+			animStorage = AnimStorage::DENSE;
+	}
 	luapath::Table currEnemy;
 	unsigned int currNum = 1;
  	while(enemyTable.getTable(".models#" + std::to_string(currNum),currEnemy))
@@ -546,6 +672,7 @@ void GameWorld::loadEnemies()
 		Enemy *newEnemy = new Enemy(characterProfile, enemyName, modelName, SQTTransform(position,glm::vec3(1),glm::quat()));
 		//Enemy *newEnemy = new Enemy(characterProfile, enemyName, modelName, SQTTransform());
 		newEnemy->generateAABB();
+		newEnemy->setAnimStorage(animStorage);
 		addEnemy(newEnemy);
 		currNum++;
 	}
@@ -95,5 +95,7 @@ private:
 	void loadEnemies();
 	void loadDebugDisplaySetting(const luapath::Table &debugTable, const std::string &debugSettingName, GameWorld::DebugObject objectType, glm::vec3 position);
 	void renderDebug() const;
+	/**@brief Log the counters of the frame just rendered. Called by render while debugging*/
+	void reportFrame() const;
 	bool loadDebugSettings();
 };
\ No newline at end of file
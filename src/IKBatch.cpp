@@ -0,0 +1,78 @@
+#include "IKBatch.hpp"
+#include "GameObject.hpp"
+
+IKBatch& IKBatch::get()
+{
+	static IKBatch singleton;
+	return singleton;
+}
+
+IKBatch::IKBatch()
+	:m_Solves(0), m_Skipped(0), m_WarmStarts(0), m_Iterations(0), m_Failures(0)
+{
+
+}
+
+void IKBatch::add(SkinnedObject *object)
+{
+	m_Groups.push_back(object);
+}
+
+void IKBatch::solve()
+{
+	m_Solves = m_Skipped = m_WarmStarts = m_Iterations = m_Failures = 0;
+	WorkerPool::get().run(*this, m_Groups.size());
+	gatherCounters();
+	m_Groups.clear();
+}
+
+void IKBatch::execute(unsigned int index)
+{
+	m_Groups[index]->calculateIKs();
+}
+
+void IKBatch::gatherCounters()
+{
+	for (unsigned int i = 0; i < m_Groups.size(); i++)
+	{
+		const SkinnedObject::IKObjectMap &iks = m_Groups[i]->getAllIKs();
+		SkinnedObject::IKObjectMap::const_iterator it = iks.begin();
+		for (; it != iks.end(); ++it)
+		{
+			const IKObject &ik = it->second;
+			m_Solves++;
+			m_Iterations += ik.m_Iterations;
+			if (ik.m_Skipped)
+				m_Skipped++;
+			if (ik.m_WarmStarted)
+				m_WarmStarts++;
+			if (!ik.m_Converged)
+				m_Failures++;
+		}
+	}
+}
+
+unsigned int IKBatch::getSolves() const
+{
+	return m_Solves;
+}
+
+unsigned int IKBatch::getSkipped() const
+{
+	return m_Skipped;
+}
+
+unsigned int IKBatch::getWarmStarts() const
+{
+	return m_WarmStarts;
+}
+
+unsigned int IKBatch::getIterations() const
+{
+	return m_Iterations;
+}
+
+unsigned int IKBatch::getFailures() const
+{
+	return m_Failures;
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+#include "stdafx.h"
+#include "WorkerPool.hpp"
+
+class SkinnedObject;
+
+/**
+@brief Solves the IKs of every skinned object in the world in one stage, spread over the WorkerPool
+@details Objects queue themselves in update once their animation pose is ready. A group is one object with all of its IK targets,
+as they share a skeleton pose and have to be solved one after the other. Groups are independent of each other so each is one index of the
+pool job. solve returns once every group is done
+*/
+class IKBatch
+	: private WorkerJob
+{
+public:
+	static IKBatch& get();
+
+	/**@brief Queue the IKs of @param object to be solved in the next solve call*/
+	void add(SkinnedObject *object);
+
+	/**@brief Solve every queued object and empty the queue*/
+	void solve();
+
+	//counters of the last solve call, so they are per frame
+	unsigned int getSolves() const; //!< IK targets processed
+	unsigned int getSkipped() const; //!< targets whose effector was already there
+	unsigned int getWarmStarts() const; //!< targets that started from the rotations of the previous frame
+	unsigned int getIterations() const; //!< iterations used by all solvers together
+	unsigned int getFailures() const; //!< targets left further than the threshold from the effector
+private:
+	IKBatch();
+
+	/**@brief Solve group @param index. Runs on the pool threads*/
+	virtual void execute(unsigned int index);
+	/**@brief Sum the results the IKObjects of the queued objects report. Called once the batch is done*/
+	void gatherCounters();
+
+	std::vector<SkinnedObject*> m_Groups; //!< only written while the pool is idle
+
+	unsigned int m_Solves;
+	unsigned int m_Skipped;
+	unsigned int m_WarmStarts;
+	unsigned int m_Iterations;
+	unsigned int m_Failures;
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "InfluenceProcessor.hpp"
+
+using std::string;
+
+InfluenceProcessor::InfluenceProcessor()
+	:m_Threshold(0.0f)
+{
+	resetCounters();
+}
+
+void InfluenceProcessor::setThreshold(float threshold)
+{
+	m_Threshold = threshold;
+}
+
+float InfluenceProcessor::getThreshold() const
+{
+	return m_Threshold;
+}
+
+void InfluenceProcessor::process(const aiMesh *mesh, const std::map<std::string, unsigned int> &boneIds)
+{
+	unsigned int numVertices = mesh->mNumVertices;
+
+	//count the influences of every vertex and turn the counts into offsets
+	m_Offsets.assign(numVertices + 1, 0);
+	for (unsigned int b = 0; b < mesh->mNumBones; b++)
+	{
+		const aiBone *bone = mesh->mBones[b];
+		for (unsigned int w = 0; w < bone->mNumWeights; w++)
+			m_Offsets[bone->mWeights[w].mVertexId + 1]++;
+	}
+	for (unsigned int v = 0; v < numVertices; v++)
+		m_Offsets[v + 1] += m_Offsets[v];
+
+	//scatter the weights next to the other weights of their vertex
+	m_Influences.resize(m_Offsets[numVertices]);
+	m_Cursor.assign(m_Offsets.begin(), m_Offsets.end() - 1);
+	for (unsigned int b = 0; b < mesh->mNumBones; b++)
+	{
+		const aiBone *bone = mesh->mBones[b];
+		unsigned int boneId = boneIds.at(bone->mName.data);
+		for (unsigned int w = 0; w < bone->mNumWeights; w++)
+		{
+			Influence &influence = m_Influences[m_Cursor[bone->mWeights[w].mVertexId]++];
+			influence.m_Bone = boneId;
+			influence.m_Weight = bone->mWeights[w].mWeight;
+		}
+	}
+
+	m_Indices.assign(numVertices, glm::uvec4(0, 0, 0, 0));
+	m_Weights.assign(numVertices, glm::vec4(0.0f));
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		//keep the largest ones sorted by insertion
+		Influence top[MAX_INFLUENCES];
+		unsigned int count = 0;
+		unsigned int first = m_Offsets[v], last = m_Offsets[v + 1];
+		float vertexTotal = 0.0f;
+		for (unsigned int i = first; i < last; i++)
+		{
+			const Influence &influence = m_Influences[i];
+			//bones past MAX_BONES are plain nodes of the skeleton with no slot in the palette
+			if (influence.m_Bone >= MAX_BONES)
+				continue;
+			vertexTotal += influence.m_Weight;
+			if (count == MAX_INFLUENCES && influence.m_Weight <= top[count - 1].m_Weight)
+				continue;
+			unsigned int slot = count < MAX_INFLUENCES ? count++ : count - 1;
+			for (; slot > 0 && top[slot - 1].m_Weight < influence.m_Weight; slot--)
+				top[slot] = top[slot - 1];
+			top[slot] = influence;
+		}
+
+		//the threshold is a fraction of every influence of the vertex, including the ones past MAX_INFLUENCES.
+		//the largest influence always stays
+		float minWeight = m_Threshold * vertexTotal;
+		while (count > 1 && top[count - 1].m_Weight < minWeight)
+			count--;
+		//the kept ones are renormalized among themselves
+		float total = 0.0f;
+		for (unsigned int i = 0; i < count; i++)
+			total += top[i].m_Weight;
+		m_Pruned += (last - first) - count;
+		m_VertexCounts[count]++;
+		if (!count || total <= 0.0f)
+			continue;
+
+		//the largest weight takes what is left so the sum is one
+		float rest = 0.0f;
+		for (unsigned int i = 1; i < count; i++)
+		{
+			m_Weights[v][i] = top[i].m_Weight / total;
+			rest += m_Weights[v][i];
+		}
+		m_Weights[v][0] = 1.0f - rest;
+		for (unsigned int i = 0; i < count; i++)
+			m_Indices[v][i] = top[i].m_Bone;
+	}
+}
+
+const glm::uvec4& InfluenceProcessor::getIndices(unsigned int vertex) const
+{
+	return m_Indices[vertex];
+}
+
+const glm::vec4& InfluenceProcessor::getWeights(unsigned int vertex) const
+{
+	return m_Weights[vertex];
+}
+
+unsigned int InfluenceProcessor::getVertexCount(unsigned int influences) const
+{
+	return m_VertexCounts[influences];
+}
+
+unsigned int InfluenceProcessor::getPruned() const
+{
+	return m_Pruned;
+}
+
+void InfluenceProcessor::resetCounters()
+{
+	for (unsigned int i = 0; i <= MAX_INFLUENCES; i++)
+		m_VertexCounts[i] = 0;
+	m_Pruned = 0;
+}
\ No newline at end of file
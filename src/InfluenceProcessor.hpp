@@ -0,0 +1,56 @@
+#pragma once
+#include "stdafx.h"
+#include "BoneArray.hpp"
+
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+
+/**
+@brief Turns the per bone weight lists of an imported mesh into at most MAX_INFLUENCES influences per vertex
+@details The weights are gathered into flat arrays grouped by vertex. Weights on bone ids from MAX_BONES up are dropped first as those bones
+are not animated. Every vertex keeps its MAX_INFLUENCES largest weights,
+drops the ones below the threshold and renormalizes the rest to sum up to one. The influences come out sorted by weight
+so the first one is the largest and unused slots have weight 0, which lets a consumer stop at the first zero.
+The buffers are reused between meshes so loading a model only allocates while they grow
+*/
+class InfluenceProcessor
+{
+public:
+	static const unsigned int MAX_INFLUENCES = 4;
+
+	InfluenceProcessor();
+
+	/**@brief Influences lighter than @param threshold times the total weight of their vertex are dropped*/
+	void setThreshold(float threshold);
+	float getThreshold() const;
+
+	/**@brief Process the bone weights of @param mesh. @param boneIds maps the bone names to the bone ids the indices refer to*/
+	void process(const aiMesh *mesh, const std::map<std::string, unsigned int> &boneIds);
+
+	/**@brief Bone ids influencing @param vertex of the last processed mesh*/
+	const glm::uvec4& getIndices(unsigned int vertex) const;
+	/**@brief Weights matching getIndices*/
+	const glm::vec4& getWeights(unsigned int vertex) const;
+
+	/**@brief Vertices processed since the last resetCounters that ended up with @param influences influences. 0 to MAX_INFLUENCES*/
+	unsigned int getVertexCount(unsigned int influences) const;
+	/**@brief Influences dropped for being past MAX_INFLUENCES, below the threshold or on a bone past MAX_BONES since the last resetCounters*/
+	unsigned int getPruned() const;
+	void resetCounters();
+private:
+	struct Influence
+	{
+		unsigned int m_Bone;
+		float m_Weight;
+	};
+
+	float m_Threshold;
+	std::vector<unsigned int> m_Offsets; //!< vertex v owns m_Influences[m_Offsets[v], m_Offsets[v + 1])
+	std::vector<unsigned int> m_Cursor; //!< write position of every vertex while gathering
+	std::vector<Influence> m_Influences;
+	std::vector<glm::uvec4> m_Indices;
+	std::vector<glm::vec4> m_Weights;
+
+	unsigned int m_VertexCounts[MAX_INFLUENCES + 1];
+	unsigned int m_Pruned;
+};
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "Mesh.hpp"
 #include "ShaderProgram.hpp"
+#include "BoneArray.hpp"
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
 
 using std::vector;
 using std::string;
@@ -19,7 +23,51 @@ void Vertex::operator=(const glm::vec3 &other)
 	m_Position = other;
 }
 
+const VertexAttribute* VertexLayout<Vertex>::getAttributes()
+{
+	static const VertexAttribute attributes[NUM_ATTRIBUTES] = {
+		{ "position", 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, m_Position) },
+		{ "normal", 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, m_Normal) },
+		{ "texCoord", 2, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, m_TexCoord) }
+	};
+	return attributes;
+}
+
+const VertexAttribute* VertexLayout<PackedSkinnedVertex>::getAttributes()
+{
+	static const VertexAttribute attributes[NUM_ATTRIBUTES] = {
+		{ "position", 3, GL_FLOAT, GL_FALSE, false, offsetof(PackedSkinnedVertex, m_Position) },
+		{ "normalOct", 2, GL_SHORT, GL_TRUE, false, offsetof(PackedSkinnedVertex, m_Normal) },
+		{ "texCoord", 2, GL_HALF_FLOAT, GL_FALSE, false, offsetof(PackedSkinnedVertex, m_TexCoord) },
+		{ "boneIndices", 4, GL_UNSIGNED_BYTE, GL_FALSE, true, offsetof(PackedSkinnedVertex, m_BoneIndices) },
+		{ "boneWeights", 4, GL_UNSIGNED_SHORT, GL_TRUE, false, offsetof(PackedSkinnedVertex, m_BoneWeights) }
+	};
+	return attributes;
+}
+
+/**@brief Upload @param vertices into the bound vertex buffer and point the inputs of @param shader at them as VertexLayout describes*/
+template<typename V>
+static void setVertexAttributes(const ShaderProgram *shader, const std::vector<V> &vertices)
+{
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(V), vertices.data(), GL_STATIC_DRAW);
+	const VertexAttribute *attributes = VertexLayout<V>::getAttributes();
+	for (unsigned int i = 0; i < VertexLayout<V>::NUM_ATTRIBUTES; i++)
+	{
+		const VertexAttribute &attribute = attributes[i];
+		GLint location = glGetAttribLocation(shader->m_Id, attribute.m_Name);
+		//the shader does not use it
+		if (location < 0)
+			continue;
+		glEnableVertexAttribArray(location);
+		if (attribute.m_Integer)
+			glVertexAttribIPointer(location, attribute.m_Size, attribute.m_Type, sizeof(V), (GLvoid*)attribute.m_Offset);
+		else
+			glVertexAttribPointer(location, attribute.m_Size, attribute.m_Type, attribute.m_Normalized, sizeof(V), (GLvoid*)attribute.m_Offset);
+	}
+}
+
 Mesh::Mesh()
+	:m_MeshKey(0), m_TextureKey(0), m_IndexType(GL_UNSIGNED_INT)
 {
 
 }
@@ -27,7 +75,7 @@ Mesh::Mesh(const std::vector<Vertex> &vertices,
 	const std::vector<GLuint> &indices,
 	const std::vector<Texture> &textures,
 	ShaderProgram *shader)
-	:m_Vertices(vertices), m_Indices(indices), m_Textures(textures)
+	:m_Vertices(vertices), m_Indices(indices), m_Textures(textures), m_MeshKey(0), m_TextureKey(0), m_IndexType(GL_UNSIGNED_INT)
 {
 	createVAO(shader);
 
@@ -57,56 +105,66 @@ void Mesh::createVAO(const ShaderProgram *shader)
 	glBindVertexArray(m_VAO);
 	// Load data into vertex buffers
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-	glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(Vertex), &m_Vertices[0], GL_STATIC_DRAW);
+	setVertexAttributes(shader, m_Vertices);
 
 	if(m_Indices.size())
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(GLuint), &m_Indices[0], GL_STATIC_DRAW);
+		uploadIndices();
 	}
 
-	// Set the vertex attribute pointers
-	// Vertex Positions
-	GLuint position = glGetAttribLocation(shader->m_Id, "position");
-	glEnableVertexAttribArray(position);
-	glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-	// Vertex Normals
-	GLuint normal = glGetAttribLocation(shader->m_Id, "normal");
-	glEnableVertexAttribArray(normal);
-	glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, m_Normal));
-	// Vertex Texture Coords
-	GLuint texCoord = glGetAttribLocation(shader->m_Id, "texCoord");
-	glEnableVertexAttribArray(texCoord);
-	glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, m_TexCoord));
-
 	glBindVertexArray(0);
 }
 
+void Mesh::uploadIndices() const
+{
+	std::vector<GLuint> indices(m_Indices);
+	indices.insert(indices.end(), m_LodIndices.begin(), m_LodIndices.end());
+	if (m_IndexType == GL_UNSIGNED_SHORT)
+	{
+		std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+}
+
+void Mesh::addLod(const std::vector<GLuint> &indices)
+{
+	Lod lod;
+	lod.m_First = m_Indices.size() + m_LodIndices.size();
+	lod.m_Count = indices.size();
+	m_Lods.push_back(lod);
+	m_LodIndices.insert(m_LodIndices.end(), indices.begin(), indices.end());
+}
+
+unsigned int Mesh::getLodCount() const
+{
+	return m_Lods.size() + 1;
+}
+
+unsigned int Mesh::getTriangles(unsigned int lod) const
+{
+	if (!lod || m_Lods.empty())
+		return m_Indices.size() / 3;
+	return m_Lods[std::min<unsigned int>(lod, m_Lods.size()) - 1].m_Count / 3;
+}
+
 void Mesh::retrieveMaterialLocations(const ShaderProgram *shader)
 {
 	m_DiffuseLoc = glGetUniformLocation(shader->m_Id, "material.diffuse");
 	m_SpecularLoc = glGetUniformLocation(shader->m_Id, "material.specular");
 	m_AmbientLoc = glGetUniformLocation(shader->m_Id, "material.ambient");
 	m_ShininessLoc = glGetUniformLocation(shader->m_Id, "material.shininess");
-}
-
-void Mesh::render(const ShaderProgram *shader, GLenum mode, bool drawElements) const
-{
-	//write material properties to gpu
-	glUniform4fv(m_DiffuseLoc,1, glm::value_ptr(m_Material.diffuse)); 
-	glUniform4fv(m_SpecularLoc,1, glm::value_ptr(m_Material.specular)); 
-	glUniform4fv(m_AmbientLoc,1, glm::value_ptr(m_Material.ambient)); 
-	glUniform1f(m_ShininessLoc, m_Material.shininess); 
-	
 
+	//the n-th texture of a type goes to the n-th sampler name of that type
 	vector<string>::const_iterator diffuseTextures = shader->samplers.at("diffuse").begin();
 	vector<string>::const_iterator specularTextures = shader->samplers.at("specular").begin();
 	vector<string>::const_iterator shininessTextures = shader->samplers.at("shininess").begin();
 	vector<string>::const_iterator ambientTextures = shader->samplers.at("ambient").begin();
-	// Bind appropriate textures
+	m_SamplerLocations.resize(m_Textures.size());
 	for (GLuint i = 0; i < m_Textures.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
 		aiTextureType samplerType = m_Textures[i].m_Type;
 		string textureName;
 		if (samplerType == aiTextureType::aiTextureType_DIFFUSE)
@@ -124,19 +182,72 @@ void Mesh::render(const ShaderProgram *shader, GLenum mode, bool drawElements) c
 		else if (samplerType == aiTextureType::aiTextureType_AMBIENT)
 		{
 			textureName = *ambientTextures++;
-		}		// Now set the sampler to the correct texture unit number i
-		glUniform1i(glGetUniformLocation(shader->m_Id, textureName.c_str()), i);
-		// And finally bind the texture
+		}
+		m_SamplerLocations[i] = glGetUniformLocation(shader->m_Id, textureName.c_str());
+	}
+}
+
+void Mesh::applyMaterial() const
+{
+	//write material properties to gpu
+	glUniform4fv(m_DiffuseLoc,1, glm::value_ptr(m_Material.diffuse)); 
+	glUniform4fv(m_SpecularLoc,1, glm::value_ptr(m_Material.specular)); 
+	glUniform4fv(m_AmbientLoc,1, glm::value_ptr(m_Material.ambient)); 
+	glUniform1f(m_ShininessLoc, m_Material.shininess); 
+	for (GLuint i = 0; i < m_SamplerLocations.size(); i++)
+		glUniform1i(m_SamplerLocations[i], i);
+}
+
+bool Mesh::hasSameMaterial(const Mesh &other) const
+{
+	if (m_Textures.size() != other.m_Textures.size())
+		return false;
+	for (unsigned int i = 0; i < m_Textures.size(); i++)
+		if (m_Textures[i].m_Id != other.m_Textures[i].m_Id)
+			return false;
+	const Material &material = other.m_Material;
+	return m_Material.ambient == material.ambient && m_Material.diffuse == material.diffuse && m_Material.specular == material.specular
+		&& m_Material.shininess == material.shininess;
+}
+
+void Mesh::draw(GLenum mode, bool drawElements, unsigned int instances, unsigned int lod) const
+{
+	if(drawElements)
+	{
+		GLsizei count = m_Indices.size();
+		GLuint first = 0;
+		if (lod && !m_Lods.empty())
+		{
+			const Lod &range = m_Lods[std::min<unsigned int>(lod, m_Lods.size()) - 1];
+			count = range.m_Count;
+			first = range.m_First;
+		}
+		GLuint indexSize = m_IndexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		glDrawElementsInstanced(mode, count, m_IndexType, (const GLvoid*)(first * indexSize), instances);
+	}
+	else
+		glDrawArraysInstanced(mode, 0, m_Vertices.size(), instances);
+}
+
+GLuint Mesh::getVAO() const
+{
+	return m_VAO;
+}
+
+void Mesh::render(const ShaderProgram *shader, GLenum mode, bool drawElements) const
+{
+	applyMaterial();
+	// Bind appropriate textures
+	for (GLuint i = 0; i < m_Textures.size(); i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
 		glBindTexture(GL_TEXTURE_2D, m_Textures[i].m_Id);
 	}
 	glActiveTexture(GL_TEXTURE0); //  set everything back to defaults once configured.
 
 	// Draw mesh
 	glBindVertexArray(m_VAO);
-	if(drawElements)
-		glDrawElements(mode, m_Indices.size(), GL_UNSIGNED_INT, 0);
-	else
-		glDrawArrays(mode, 0, m_Vertices.size());
+	draw(mode, drawElements);
 	glBindVertexArray(0);
 }
 
@@ -158,6 +269,47 @@ SkinnedVertex& SkinnedVertex::operator=(const Vertex &vertex)
 }
 
 
+/**@brief Fold the lower hemisphere over the upper one so a unit vector maps to the [-1,1] square*/
+static glm::vec2 encodeOctahedral(const glm::vec3 &n)
+{
+	float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (length == 0.0f)
+		return glm::vec2(0.0f);
+	glm::vec3 p = n / length;
+	glm::vec2 e(p.x, p.y);
+	if (p.z < 0.0f)
+	{
+		e.x = (1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+		e.y = (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+PackedSkinnedVertex::PackedSkinnedVertex(const SkinnedVertex &vertex)
+	:m_Position(vertex.m_Position)
+{
+	static_assert(MAX_BONES <= 256, "bone ids have to fit in a byte");
+	static_assert(sizeof(PackedSkinnedVertex) == 32, "PackedSkinnedVertex is expected to be tightly packed");
+	m_Normal = glm::packSnorm2x16(encodeOctahedral(vertex.m_Normal));
+	m_TexCoord = glm::packHalf2x16(vertex.m_TexCoord);
+
+	//quantize the weights and hand the rounding error to the largest one so they still add up to one
+	float sum = vertex.m_BoneWeights[0] + vertex.m_BoneWeights[1] + vertex.m_BoneWeights[2] + vertex.m_BoneWeights[3];
+	float scale = sum > 0.0f ? 65535.0f / sum : 0.0f;
+	int total = 0;
+	unsigned int largest = 0;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		m_BoneIndices[i] = static_cast<GLubyte>(vertex.m_BoneIndices[i]);
+		m_BoneWeights[i] = static_cast<GLushort>(vertex.m_BoneWeights[i] * scale + 0.5f);
+		total += m_BoneWeights[i];
+		if (m_BoneWeights[i] > m_BoneWeights[largest])
+			largest = i;
+	}
+	if (sum > 0.0f)
+		m_BoneWeights[largest] = static_cast<GLushort>(m_BoneWeights[largest] + 65535 - total);
+}
+
 SkinnedMesh::SkinnedMesh()
 {
 }
@@ -185,41 +337,21 @@ void SkinnedMesh::createVAO(ShaderProgram *shader)
 	// Create buffers/arrays
 	glGenVertexArrays(1, &m_VAO);
 	glGenBuffers(1, &m_VBO);
-	glGenBuffers(1, &m_EBO);
+	if(m_Indices.size())
+		glGenBuffers(1, &m_EBO);
 
 	glBindVertexArray(m_VAO);
 	// Load data into vertex buffers
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-	glBufferData(GL_ARRAY_BUFFER, m_SkinnedVertices.size() * sizeof(SkinnedVertex), &m_SkinnedVertices[0], GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Indices.size() * sizeof(GLuint), &m_Indices[0], GL_STATIC_DRAW);
-
-	// Set the vertex attribute pointers
-	// Vertex Positions
-	GLuint position = glGetAttribLocation(shader->m_Id, "position");
-	glEnableVertexAttribArray(position);
-	glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (GLvoid*)0);
-	// Vertex Normals
-	GLuint normal = glGetAttribLocation(shader->m_Id, "normal");
-	glEnableVertexAttribArray(normal);
-	glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (GLvoid*)offsetof(SkinnedVertex, m_Normal));
-	// Vertex Texture Coords
-	GLuint texCoord = glGetAttribLocation(shader->m_Id, "texCoord");
-	glEnableVertexAttribArray(texCoord);
-	glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (GLvoid*)offsetof(SkinnedVertex, m_TexCoord));
-
-	// Vertex Bone Indices. For now each vertex can be influenced by 4 bones
-	//!@todo variable length bones
-	GLuint boneIndices = glGetAttribLocation(shader->m_Id, "boneIndices");
-	glEnableVertexAttribArray(boneIndices);
-	glVertexAttribIPointer(boneIndices, 4, GL_UNSIGNED_INT, sizeof(SkinnedVertex), (GLvoid*)offsetof(SkinnedVertex, m_BoneIndices));
-
-	// Vertex Bone Weights
-	GLuint boneWeights = glGetAttribLocation(shader->m_Id, "boneWeights");
-	glEnableVertexAttribArray(boneWeights);
-	glVertexAttribPointer(boneWeights, 4, GL_FLOAT, GL_FALSE, sizeof(SkinnedVertex), (GLvoid*)offsetof(SkinnedVertex, m_BoneWeights));
+	//the gpu only gets the packed copy. m_SkinnedVertices stays for the cpu side (bounding boxes, cpu skinning)
+	std::vector<PackedSkinnedVertex> packedVertices(m_SkinnedVertices.begin(), m_SkinnedVertices.end());
+	setVertexAttributes(shader, packedVertices);
 
+	if(m_Indices.size())
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+		uploadIndices();
+	}
 
 	glBindVertexArray(0);
 }
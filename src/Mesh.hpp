@@ -47,6 +47,8 @@ struct ShaderProgram;
 struct Mesh
 {
 public:
+	static const unsigned int MAX_LODS = 4; //!< levels of detail a mesh may have, the full one included
+
 	/** Construct a Mesh from vertices, indices and textures
 		@param shader is the associated ShaderProgram for that Mesh
 	*/
@@ -62,20 +64,51 @@ public:
 
 	/**@brief Create a VAO for @param shader from the already loaded vertices */
 	virtual void createVAO(const ShaderProgram *shader);
-	/**@brief Retrieve the locations of the material properties in the shader*/
+	/**@brief Retrieve the locations of the material properties and of the samplers of m_Textures in the shader*/
 	void retrieveMaterialLocations(const ShaderProgram *shader);
 	/**@brief Writes material properties, textures and draws the triangles. Defaults to GL_TRIANGLES*/
 	virtual void render(const ShaderProgram *shader) const;	
 	/**@brief Writes material properties, textures and draws the triangles*/
 	virtual void render(const ShaderProgram *shader,GLenum mode, bool drawElements) const;
 
+	/**@brief Writes the material properties and points the samplers at texture units 0.. in the order of m_Textures. The textures are bound by the caller*/
+	void applyMaterial() const;
+	/**@brief true if this mesh and @param other can be drawn with the same material uniforms and textures*/
+	bool hasSameMaterial(const Mesh &other) const;
+	/**@brief Issues the draw call for @param instances instances of level of detail @param lod. Expects the VAO and the instance data to be bound*/
+	void draw(GLenum mode, bool drawElements, unsigned int instances = 1, unsigned int lod = 0) const;
+	GLuint getVAO() const;
+
+	/**@brief Add a coarser level of detail drawing the triangles @param indices of the same vertices. After m_Indices is final and before createVAO*/
+	void addLod(const std::vector<GLuint> &indices);
+	/**@brief Levels of detail including the full mesh. Levels past the last draw the last*/
+	unsigned int getLodCount() const;
+	/**@brief Triangles of level of detail @param lod*/
+	unsigned int getTriangles(unsigned int lod) const;
+
 public:
 	std::vector<Vertex> m_Vertices;
 	std::vector<GLuint> m_Indices;
 	std::vector<Texture> m_Textures;
 	Material m_Material;
+	unsigned int m_MeshKey; //!< sort key id of the mesh given by RenderQueue. Unique per mesh, meshes sharing a material still get their own. 0 until the mesh is first submitted
+	unsigned int m_TextureKey; //!< sort key id of the texture set given by RenderQueue. 0 until the mesh is first submitted
+	GLenum m_IndexType; //!< GL_UNSIGNED_INT, or GL_UNSIGNED_SHORT to upload m_Indices as 16 bit. Set before createVAO
 protected:
+	/**@brief Upload m_Indices followed by m_LodIndices into the bound element buffer as m_IndexType*/
+	void uploadIndices() const;
+
+	/**@brief Where a coarser level of detail is in the element buffer*/
+	struct Lod
+	{
+		GLuint m_First; //!< first index
+		GLuint m_Count; //!< number of indices
+	};
+	std::vector<Lod> m_Lods; //!< level 1 onwards. Level 0 is m_Indices at the start of the element buffer
+	std::vector<GLuint> m_LodIndices; //!< the indices of m_Lods one after the other
+
 	GLuint m_DiffuseLoc, m_AmbientLoc, m_SpecularLoc, m_ShininessLoc;
+	std::vector<GLint> m_SamplerLocations; //!< sampler uniform of each of m_Textures
 	
 	GLuint m_VAO;
 	GLuint m_VBO;//!< single VAO initialised with subbuffer data
@@ -94,7 +127,50 @@ struct SkinnedVertex
 
 };
 
-/**@brief Same structurally as Mesh except the loaded buffer contains SkinnedVertex*/
+/**@brief The compressed form of SkinnedVertex that is written to the gpu. Half the size of SkinnedVertex
+	@details The normal is octahedral encoded into two snorm16, the uvs are half floats, the bone indices a byte each and the weights unorm16 summing up to one.
+	The skinning shaders decode the normal from normalOct
+*/
+struct PackedSkinnedVertex
+{
+	PackedSkinnedVertex(const SkinnedVertex &vertex);
+
+	glm::vec3 m_Position; //!< position in model space
+	GLuint m_Normal; //!< octahedral encoded normal in model space
+	GLuint m_TexCoord; //!< uv coordinates for vertex as two half floats
+	GLubyte m_BoneIndices[4]; //!< the bones influencing the vertex. Bone ids are below MAX_BONES, InfluenceProcessor drops the rest
+	GLushort m_BoneWeights[4]; //!< the weights of the bones
+};
+
+/**@brief Describes a single attribute of a vertex format*/
+struct VertexAttribute
+{
+	const char *m_Name; //!< the name of the input in the vertex shader
+	GLint m_Size; //!< number of components
+	GLenum m_Type; //!< type of a component
+	GLboolean m_Normalized; //!< integer components are mapped to [0,1] or [-1,1]
+	bool m_Integer; //!< the shader reads the components as integers
+	size_t m_Offset; //!< offset in the vertex
+};
+
+/**@brief Compile time description of the gpu layout of a vertex format. Specialized for every format a Mesh uploads.
+	createVAO sets the attribute pointers from it so the offsets live next to the struct instead of in each createVAO
+*/
+template<typename V> struct VertexLayout;
+
+template<> struct VertexLayout<Vertex>
+{
+	static const unsigned int NUM_ATTRIBUTES = 3;
+	static const VertexAttribute* getAttributes();
+};
+
+template<> struct VertexLayout<PackedSkinnedVertex>
+{
+	static const unsigned int NUM_ATTRIBUTES = 5;
+	static const VertexAttribute* getAttributes();
+};
+
+/**@brief Same structurally as Mesh except the loaded buffer contains SkinnedVertex packed as PackedSkinnedVertex*/
 struct SkinnedMesh
 	: public Mesh
 {
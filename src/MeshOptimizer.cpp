@@ -0,0 +1,288 @@
+#include "MeshOptimizer.hpp"
+
+#include <cmath>
+#include <cstring>
+
+using std::vector;
+
+//scoring of Forsyth's linear speed vertex cache optimizer
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+/**@brief Score of a vertex at @param cachePosition (-1 outside the cache) still used by @param remaining triangles*/
+static float getVertexScore(int cachePosition, unsigned int remaining)
+{
+	if (!remaining)
+		return -1.0f;
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		//the vertices of the last triangle get a fixed score so the next triangle does not simply reuse two of them
+		if (cachePosition < 3)
+			score = LAST_TRIANGLE_SCORE;
+		else
+			score = std::pow(1.0f - (cachePosition - 3) / float(MeshOptimizer::CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	//vertices with few triangles left are finished first so they leave the mesh for good
+	score += VALENCE_BOOST_SCALE * std::pow(float(remaining), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+MeshOptimizer::MeshOptimizer()
+{
+	m_Options.m_Enabled = false;
+	m_Options.m_Weld = m_Options.m_VertexCache = m_Options.m_VertexFetch = m_Options.m_ShortIndices = true;
+	resetCounters();
+}
+
+void MeshOptimizer::setOptions(const Options &options)
+{
+	m_Options = options;
+}
+
+const MeshOptimizer::Options& MeshOptimizer::getOptions() const
+{
+	return m_Options;
+}
+
+unsigned int MeshOptimizer::weld(const unsigned char *vertices, unsigned int count, unsigned int stride, std::vector<GLuint> &indices)
+{
+	unsigned int tableSize = 1;
+	while (tableSize < count * 2)
+		tableSize <<= 1;
+	m_Table.assign(tableSize, ~0u);
+	m_Remap.resize(count);
+	unsigned int unique = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		//FNV-1a over the bytes of the vertex
+		const unsigned char *vertex = vertices + i * stride;
+		unsigned int hash = 2166136261u;
+		for (unsigned int b = 0; b < stride; b++)
+			hash = (hash ^ vertex[b]) * 16777619u;
+
+		unsigned int slot = hash & (tableSize - 1);
+		while (true)
+		{
+			GLuint entry = m_Table[slot];
+			if (entry == ~0u)
+			{
+				m_Table[slot] = i;
+				m_Remap[i] = unique++;
+				break;
+			}
+			if (!std::memcmp(vertices + entry * stride, vertex, stride))
+			{
+				m_Remap[i] = m_Remap[entry];
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+	for (unsigned int i = 0; i < indices.size(); i++)
+		indices[i] = m_Remap[indices[i]];
+	return unique;
+}
+
+void MeshOptimizer::reorderCache(std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	unsigned int numTriangles = indices.size() / 3;
+	if (!numTriangles)
+		return;
+
+	//the triangles of every vertex, grouped by vertex
+	m_Remaining.assign(numVertices, 0);
+	for (unsigned int i = 0; i < numTriangles * 3; i++)
+		m_Remaining[indices[i]]++;
+	m_Offsets.resize(numVertices);
+	unsigned int offset = 0;
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		m_Offsets[v] = offset;
+		offset += m_Remaining[v];
+		m_Remaining[v] = 0;
+	}
+	m_Triangles.resize(offset);
+	for (unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		GLuint v = indices[i];
+		m_Triangles[m_Offsets[v] + m_Remaining[v]++] = i / 3;
+	}
+
+	m_CachePosition.assign(numVertices, -1);
+	m_VertexScores.resize(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		m_VertexScores[v] = getVertexScore(-1, m_Remaining[v]);
+	m_TriangleScores.resize(numTriangles);
+	unsigned int bestTriangle = 0;
+	for (unsigned int t = 0; t < numTriangles; t++)
+	{
+		m_TriangleScores[t] = m_VertexScores[indices[t * 3]] + m_VertexScores[indices[t * 3 + 1]] + m_VertexScores[indices[t * 3 + 2]];
+		if (m_TriangleScores[t] > m_TriangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+	m_Emitted.assign(numTriangles, false);
+	m_Result.clear();
+	m_Result.reserve(numTriangles * 3);
+
+	//the last three entries hold what the new triangle pushes out of the cache
+	GLuint cache[CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int scanCursor = 0;
+	for (unsigned int emitted = 0; emitted < numTriangles; emitted++)
+	{
+		//nothing in the cache has triangles left. Take the next triangle in the original order
+		if (bestTriangle == ~0u)
+		{
+			while (m_Emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = scanCursor;
+		}
+		m_Emitted[bestTriangle] = true;
+
+		GLuint newCache[CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[bestTriangle * 3 + k];
+			m_Result.push_back(v);
+			if (!newCount || (newCache[0] != v && newCache[newCount - 1] != v))
+				newCache[newCount++] = v;
+			//take the triangle off the list of the vertex
+			unsigned int *triangles = &m_Triangles[m_Offsets[v]];
+			for (unsigned int i = 0; i < m_Remaining[v]; i++)
+				if (triangles[i] == bestTriangle)
+				{
+					triangles[i] = triangles[--m_Remaining[v]];
+					break;
+				}
+		}
+		unsigned int fresh = newCount;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			GLuint v = cache[i];
+			unsigned int j = 0;
+			while (j < fresh && newCache[j] != v)
+				j++;
+			if (j == fresh)
+				newCache[newCount++] = v;
+		}
+
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			GLuint v = newCache[i];
+			m_CachePosition[v] = i < CACHE_SIZE ? int(i) : -1;
+			m_VertexScores[v] = getVertexScore(m_CachePosition[v], m_Remaining[v]);
+		}
+		//only the triangles of cached vertices changed their score
+		bestTriangle = ~0u;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			GLuint v = newCache[i];
+			const unsigned int *triangles = &m_Triangles[m_Offsets[v]];
+			for (unsigned int j = 0; j < m_Remaining[v]; j++)
+			{
+				unsigned int t = triangles[j];
+				float score = m_VertexScores[indices[t * 3]] + m_VertexScores[indices[t * 3 + 1]] + m_VertexScores[indices[t * 3 + 2]];
+				m_TriangleScores[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+		std::memcpy(cache, newCache, cacheCount * sizeof(GLuint));
+	}
+	indices.swap(m_Result);
+}
+
+unsigned int MeshOptimizer::reorderFetch(std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	m_Remap.assign(numVertices, ~0u);
+	unsigned int next = 0;
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		GLuint &index = indices[i];
+		if (m_Remap[index] == ~0u)
+			m_Remap[index] = next++;
+		index = m_Remap[index];
+	}
+	return next;
+}
+
+void MeshOptimizer::optimizeLod(std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	if (m_Options.m_Enabled && m_Options.m_VertexCache)
+		reorderCache(indices, numVertices);
+}
+
+unsigned int MeshOptimizer::countTransforms(const std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	//a vertex is in the cache if fewer than FIFO_SIZE misses happened since its own
+	vector<unsigned int> missedAt(numVertices, 0);
+	unsigned int transforms = 0;
+	for (unsigned int i = 0; i < indices.size(); i++)
+	{
+		GLuint v = indices[i];
+		if (missedAt[v] && transforms - missedAt[v] < FIFO_SIZE)
+			continue;
+		missedAt[v] = ++transforms;
+	}
+	return transforms;
+}
+
+float MeshOptimizer::getACMR(const std::vector<GLuint> &indices, unsigned int numVertices)
+{
+	if (indices.size() < 3)
+		return 0.0f;
+	return countTransforms(indices, numVertices) / float(indices.size() / 3);
+}
+
+unsigned int MeshOptimizer::getVerticesBefore() const
+{
+	return m_VerticesBefore;
+}
+
+unsigned int MeshOptimizer::getVerticesAfter() const
+{
+	return m_VerticesAfter;
+}
+
+unsigned int MeshOptimizer::getIndicesBefore() const
+{
+	return m_IndicesBefore;
+}
+
+unsigned int MeshOptimizer::getIndicesAfter() const
+{
+	return m_IndicesAfter;
+}
+
+float MeshOptimizer::getACMRBefore() const
+{
+	return m_IndicesBefore < 3 ? 0.0f : m_TransformsBefore / float(m_IndicesBefore / 3);
+}
+
+float MeshOptimizer::getACMRAfter() const
+{
+	return m_IndicesAfter < 3 ? 0.0f : m_TransformsAfter / float(m_IndicesAfter / 3);
+}
+
+unsigned int MeshOptimizer::getShortMeshes() const
+{
+	return m_ShortMeshes;
+}
+
+void MeshOptimizer::resetCounters()
+{
+	m_VerticesBefore = m_VerticesAfter = 0;
+	m_IndicesBefore = m_IndicesAfter = 0;
+	m_TransformsBefore = m_TransformsAfter = 0;
+	m_ShortMeshes = 0;
+}
\ No newline at end of file
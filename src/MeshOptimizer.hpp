@@ -0,0 +1,134 @@
+#pragma once
+#include "stdafx.h"
+
+#include <GL/glew.h>
+
+/**
+@brief Optimizes the vertices and indices of a freshly imported mesh before it is uploaded
+@details Runs up to four stages, each of which can be turned off:
+the weld merges vertices whose bytes are identical, the vertex cache stage reorders the triangles for the post transform cache
+(Forsyth's linear speed optimizer), the vertex fetch stage renumbers the vertices in the order the triangles first use them
+and drops unreferenced ones, and meshes with fewer than 65536 vertices get 16 bit indices.
+The counts before and after, including the ACMR (transformed vertices per triangle), are summed up over the meshes since resetCounters.
+The buffers are reused between meshes so loading a model only allocates while they grow
+*/
+class MeshOptimizer
+{
+public:
+	static const unsigned int CACHE_SIZE = 32; //!< LRU entries the triangle order is optimized for
+	static const unsigned int FIFO_SIZE = 16; //!< FIFO entries the ACMR is measured with
+
+	/**@brief Which stages optimize runs*/
+	struct Options
+	{
+		bool m_Enabled; //!< false skips every stage. Off unless the model asks for it
+		bool m_Weld;
+		bool m_VertexCache;
+		bool m_VertexFetch;
+		bool m_ShortIndices;
+	};
+
+	MeshOptimizer();
+
+	void setOptions(const Options &options);
+	const Options& getOptions() const;
+
+	/**@brief Run the enabled stages on @param vertices and @param indices (a triangle list). Returns the index type the mesh should upload*/
+	template<typename V>
+	GLenum optimize(std::vector<V> &vertices, std::vector<GLuint> &indices);
+
+	/**@brief Reorder the triangles @param indices of a coarser level of detail for the vertex cache if that stage is enabled.
+		The vertices are shared with the full mesh so they stay where they are*/
+	void optimizeLod(std::vector<GLuint> &indices, unsigned int numVertices);
+
+	/**@brief Transformed vertices per triangle of @param indices drawn through a FIFO_SIZE cache. 0 for an empty mesh*/
+	static float getACMR(const std::vector<GLuint> &indices, unsigned int numVertices);
+
+	unsigned int getVerticesBefore() const;
+	unsigned int getVerticesAfter() const;
+	unsigned int getIndicesBefore() const;
+	unsigned int getIndicesAfter() const;
+	float getACMRBefore() const; //!< over all the meshes since resetCounters
+	float getACMRAfter() const;
+	unsigned int getShortMeshes() const; //!< meshes given 16 bit indices since resetCounters
+	void resetCounters();
+private:
+	/**@brief Fill m_Remap with the new index of every one of @param count vertices of @param stride bytes, the duplicates pointing at their first copy.
+		Rewrites @param indices and returns the number of unique vertices*/
+	unsigned int weld(const unsigned char *vertices, unsigned int count, unsigned int stride, std::vector<GLuint> &indices);
+	/**@brief Reorder the triangles of @param indices for a CACHE_SIZE LRU cache*/
+	void reorderCache(std::vector<GLuint> &indices, unsigned int numVertices);
+	/**@brief Fill m_Remap with the order the triangles first use the vertices in, ~0 for unused ones. Rewrites @param indices and returns the number of used vertices*/
+	unsigned int reorderFetch(std::vector<GLuint> &indices, unsigned int numVertices);
+	/**@brief Move every vertex to the place m_Remap gives it. @param count is the number of vertices afterwards*/
+	template<typename V>
+	void remapVertices(std::vector<V> &vertices, unsigned int count);
+	/**@brief Transformed vertices of @param indices through a FIFO_SIZE cache*/
+	static unsigned int countTransforms(const std::vector<GLuint> &indices, unsigned int numVertices);
+
+	Options m_Options;
+	std::vector<GLuint> m_Remap; //!< old vertex to new vertex
+	std::vector<GLuint> m_Order; //!< new vertex to old vertex
+	std::vector<GLuint> m_Table; //!< hash table of the weld
+	//scratch of reorderCache
+	std::vector<unsigned int> m_Offsets; //!< vertex v is used by m_Triangles[m_Offsets[v], m_Offsets[v] + m_Remaining[v])
+	std::vector<unsigned int> m_Remaining; //!< triangles of a vertex not yet emitted
+	std::vector<unsigned int> m_Triangles;
+	std::vector<int> m_CachePosition; //!< -1 when the vertex is not in the cache
+	std::vector<float> m_VertexScores;
+	std::vector<float> m_TriangleScores;
+	std::vector<bool> m_Emitted;
+	std::vector<GLuint> m_Result;
+
+	unsigned int m_VerticesBefore, m_VerticesAfter;
+	unsigned int m_IndicesBefore, m_IndicesAfter;
+	unsigned int m_TransformsBefore, m_TransformsAfter;
+	unsigned int m_ShortMeshes;
+};
+
+template<typename V>
+GLenum MeshOptimizer::optimize(std::vector<V> &vertices, std::vector<GLuint> &indices)
+{
+	if (!m_Options.m_Enabled)
+		return GL_UNSIGNED_INT;
+	m_VerticesBefore += vertices.size();
+	m_IndicesBefore += indices.size();
+	m_TransformsBefore += countTransforms(indices, vertices.size());
+
+	if (m_Options.m_Weld && !vertices.empty())
+	{
+		unsigned int count = weld(reinterpret_cast<const unsigned char*>(vertices.data()), vertices.size(), sizeof(V), indices);
+		remapVertices(vertices, count);
+	}
+	if (m_Options.m_VertexCache)
+		reorderCache(indices, vertices.size());
+	if (m_Options.m_VertexFetch)
+	{
+		unsigned int count = reorderFetch(indices, vertices.size());
+		remapVertices(vertices, count);
+	}
+
+	m_VerticesAfter += vertices.size();
+	m_IndicesAfter += indices.size();
+	m_TransformsAfter += countTransforms(indices, vertices.size());
+	if (m_Options.m_ShortIndices && vertices.size() < 65536)
+	{
+		m_ShortMeshes++;
+		return GL_UNSIGNED_SHORT;
+	}
+	return GL_UNSIGNED_INT;
+}
+
+template<typename V>
+void MeshOptimizer::remapVertices(std::vector<V> &vertices, unsigned int count)
+{
+	m_Order.resize(count);
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		if (m_Remap[i] != ~0u)
+			m_Order[m_Remap[i]] = i;
+	std::vector<V> result;
+	result.reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+		result.push_back(vertices[m_Order[i]]);
+	vertices.swap(result);
+}
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+using std::vector;
+
+//collapses between vertices of different strongest bones cost this much more per fourth power of their distance,
+//the units of the area weighted quadrics
+static const float SKIN_PENALTY = 0.5f;
+
+MeshSimplifier::Quadric::Quadric()
+{
+	std::fill(m_A, m_A + 10, 0.0f);
+}
+
+void MeshSimplifier::Quadric::setTriangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+	glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+	float length = glm::length(normal);
+	if (length == 0.0f)
+	{
+		std::fill(m_A, m_A + 10, 0.0f);
+		return;
+	}
+	normal /= length;
+	float d = -glm::dot(normal, p0);
+	float area = 0.5f * length;
+	float plane[4] = { normal.x, normal.y, normal.z, d };
+	unsigned int k = 0;
+	for (unsigned int i = 0; i < 4; i++)
+		for (unsigned int j = i; j < 4; j++)
+			m_A[k++] = area * plane[i] * plane[j];
+}
+
+void MeshSimplifier::Quadric::add(const Quadric &other)
+{
+	for (unsigned int i = 0; i < 10; i++)
+		m_A[i] += other.m_A[i];
+}
+
+float MeshSimplifier::Quadric::evaluate(const glm::vec3 &p) const
+{
+	float x = p.x, y = p.y, z = p.z;
+	return m_A[0] * x * x + 2.0f * m_A[1] * x * y + 2.0f * m_A[2] * x * z + 2.0f * m_A[3] * x
+		+ m_A[4] * y * y + 2.0f * m_A[5] * y * z + 2.0f * m_A[6] * y
+		+ m_A[7] * z * z + 2.0f * m_A[8] * z
+		+ m_A[9];
+}
+
+MeshSimplifier::MeshSimplifier()
+	:m_LiveIndices(0), m_Error(0.0f)
+{
+
+}
+
+/**@brief Orders vertex ids by the position they point at*/
+struct PositionLess
+{
+	const vector<glm::vec3> &m_Positions;
+	bool operator()(GLuint a, GLuint b) const
+	{
+		const glm::vec3 &pa = m_Positions[a], &pb = m_Positions[b];
+		if (pa.x != pb.x)
+			return pa.x < pb.x;
+		if (pa.y != pb.y)
+			return pa.y < pb.y;
+		return pa.z < pb.z;
+	}
+};
+
+void MeshSimplifier::start(const std::vector<GLuint> &indices)
+{
+	unsigned int numVertices = m_Positions.size();
+	unsigned int numTriangles = indices.size() / 3;
+	m_Indices.assign(indices.begin(), indices.begin() + numTriangles * 3);
+	m_LiveIndices = m_Indices.size();
+	m_Error = 0.0f;
+	m_Dead.assign(numTriangles, false);
+	m_Removed.assign(numVertices, false);
+	m_Versions.assign(numVertices, 0);
+	m_Locked.assign(numVertices, false);
+	m_Queue = std::priority_queue<Collapse>();
+	m_VertexTriangles.assign(numVertices, vector<unsigned int>());
+	for (unsigned int t = 0; t < numTriangles; t++)
+		for (unsigned int k = 0; k < 3; k++)
+			m_VertexTriangles[m_Indices[t * 3 + k]].push_back(t);
+
+	//vertices sharing a position sit on a seam. The position class is the first of them
+	PositionLess less = { m_Positions };
+	vector<GLuint> order(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++)
+		order[v] = v;
+	std::sort(order.begin(), order.end(), less);
+	vector<GLuint> positionClass(numVertices);
+	for (unsigned int i = 0; i < numVertices; i++)
+	{
+		bool same = i > 0 && !less(order[i - 1], order[i]);
+		positionClass[order[i]] = same ? positionClass[order[i - 1]] : order[i];
+		if (same)
+			m_Locked[order[i]] = m_Locked[order[i - 1]] = true;
+	}
+
+	//edges used by a single triangle are on the border, counted between position classes so seams do not count
+	vector<std::pair<std::pair<GLuint, GLuint>, unsigned int> > edges;
+	edges.reserve(numTriangles * 3);
+	for (unsigned int t = 0; t < numTriangles; t++)
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			GLuint a = positionClass[m_Indices[t * 3 + k]], b = positionClass[m_Indices[t * 3 + (k + 1) % 3]];
+			edges.push_back(std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), t * 3 + k));
+		}
+	std::sort(edges.begin(), edges.end());
+	for (unsigned int i = 0; i < edges.size();)
+	{
+		unsigned int j = i + 1;
+		while (j < edges.size() && edges[j].first == edges[i].first)
+			j++;
+		if (j - i == 1)
+		{
+			unsigned int corner = edges[i].second;
+			m_Locked[m_Indices[corner]] = true;
+			m_Locked[m_Indices[corner - corner % 3 + (corner + 1) % 3]] = true;
+		}
+		i = j;
+	}
+
+	m_Quadrics.assign(numVertices, Quadric());
+	for (unsigned int t = 0; t < numTriangles; t++)
+	{
+		const GLuint *triangle = &m_Indices[t * 3];
+		Quadric quadric;
+		quadric.setTriangle(m_Positions[triangle[0]], m_Positions[triangle[1]], m_Positions[triangle[2]]);
+		for (unsigned int k = 0; k < 3; k++)
+			m_Quadrics[triangle[k]].add(quadric);
+	}
+
+	for (unsigned int t = 0; t < numTriangles; t++)
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			GLuint a = m_Indices[t * 3 + k], b = m_Indices[t * 3 + (k + 1) % 3];
+			push(a, b);
+			push(b, a);
+		}
+}
+
+void MeshSimplifier::push(GLuint from, GLuint to)
+{
+	if (m_Locked[from] || from == to)
+		return;
+	Quadric quadric = m_Quadrics[from];
+	quadric.add(m_Quadrics[to]);
+	Collapse collapse;
+	collapse.m_Cost = quadric.evaluate(m_Positions[to]);
+	if (m_SkinGroups[from] != m_SkinGroups[to])
+	{
+		glm::vec3 edge = m_Positions[to] - m_Positions[from];
+		float lengthSquared = glm::dot(edge, edge);
+		collapse.m_Cost += SKIN_PENALTY * lengthSquared * lengthSquared;
+	}
+	collapse.m_From = from;
+	collapse.m_To = to;
+	collapse.m_FromVersion = m_Versions[from];
+	collapse.m_ToVersion = m_Versions[to];
+	m_Queue.push(collapse);
+}
+
+bool MeshSimplifier::isValid(GLuint from, GLuint to) const
+{
+	//the vertices next to both ends have to be exactly the third corners of the triangles on the edge, else the collapse pinches the surface
+	vector<GLuint> fromNeighbours, toNeighbours;
+	unsigned int shared = 0;
+	const vector<unsigned int> &fromTriangles = m_VertexTriangles[from];
+	for (unsigned int i = 0; i < fromTriangles.size(); i++)
+	{
+		const GLuint *triangle = &m_Indices[fromTriangles[i] * 3];
+		bool onEdge = triangle[0] == to || triangle[1] == to || triangle[2] == to;
+		if (onEdge)
+			shared++;
+		for (unsigned int k = 0; k < 3; k++)
+			if (triangle[k] != from && triangle[k] != to)
+				fromNeighbours.push_back(triangle[k]);
+
+		//the triangles that stay must not flip or fold flat
+		if (onEdge)
+			continue;
+		glm::vec3 corners[3], moved[3];
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			corners[k] = m_Positions[triangle[k]];
+			moved[k] = triangle[k] == from ? m_Positions[to] : corners[k];
+		}
+		glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+		glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+		if (glm::dot(before, after) <= 0.0f)
+			return false;
+	}
+	const vector<unsigned int> &toTriangles = m_VertexTriangles[to];
+	for (unsigned int i = 0; i < toTriangles.size(); i++)
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			GLuint v = m_Indices[toTriangles[i] * 3 + k];
+			if (v != from && v != to)
+				toNeighbours.push_back(v);
+		}
+	std::sort(fromNeighbours.begin(), fromNeighbours.end());
+	fromNeighbours.erase(std::unique(fromNeighbours.begin(), fromNeighbours.end()), fromNeighbours.end());
+	std::sort(toNeighbours.begin(), toNeighbours.end());
+	toNeighbours.erase(std::unique(toNeighbours.begin(), toNeighbours.end()), toNeighbours.end());
+	vector<GLuint> common;
+	std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(), std::back_inserter(common));
+	return common.size() <= shared;
+}
+
+/**@brief Take @param triangle off the list @param triangles*/
+static void removeTriangle(vector<unsigned int> &triangles, unsigned int triangle)
+{
+	vector<unsigned int>::iterator it = std::find(triangles.begin(), triangles.end(), triangle);
+	if (it == triangles.end())
+		return;
+	*it = triangles.back();
+	triangles.pop_back();
+}
+
+void MeshSimplifier::collapse(GLuint from, GLuint to)
+{
+	m_Removed[from] = true;
+	m_Quadrics[to].add(m_Quadrics[from]);
+	m_Versions[to]++;
+
+	vector<unsigned int> &fromTriangles = m_VertexTriangles[from];
+	for (unsigned int i = 0; i < fromTriangles.size(); i++)
+	{
+		unsigned int t = fromTriangles[i];
+		GLuint *triangle = &m_Indices[t * 3];
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			m_Dead[t] = true;
+			m_LiveIndices -= 3;
+			for (unsigned int k = 0; k < 3; k++)
+				if (triangle[k] != from)
+					removeTriangle(m_VertexTriangles[triangle[k]], t);
+			continue;
+		}
+		for (unsigned int k = 0; k < 3; k++)
+			if (triangle[k] == from)
+				triangle[k] = to;
+		m_VertexTriangles[to].push_back(t);
+	}
+	fromTriangles.clear();
+
+	//the collapses touching the grown quadric are queued again with their new cost
+	const vector<unsigned int> &toTriangles = m_VertexTriangles[to];
+	for (unsigned int i = 0; i < toTriangles.size(); i++)
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			GLuint v = m_Indices[toTriangles[i] * 3 + k];
+			if (v == to)
+				continue;
+			push(v, to);
+			push(to, v);
+		}
+}
+
+void MeshSimplifier::simplify(unsigned int targetIndices, std::vector<GLuint> &result)
+{
+	while (m_LiveIndices > targetIndices && !m_Queue.empty())
+	{
+		Collapse collapse = m_Queue.top();
+		m_Queue.pop();
+		GLuint from = collapse.m_From, to = collapse.m_To;
+		if (m_Removed[from] || m_Removed[to] || collapse.m_FromVersion != m_Versions[from] || collapse.m_ToVersion != m_Versions[to])
+			continue;
+		if (!isValid(from, to))
+			continue;
+		m_Error = std::max(m_Error, collapse.m_Cost);
+		this->collapse(from, to);
+	}
+
+	result.clear();
+	result.reserve(m_LiveIndices);
+	for (unsigned int t = 0; t < m_Dead.size(); t++)
+		if (!m_Dead[t])
+			result.insert(result.end(), m_Indices.begin() + t * 3, m_Indices.begin() + t * 3 + 3);
+}
+
+float MeshSimplifier::getError() const
+{
+	return m_Error;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include "stdafx.h"
+#include "Mesh.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <queue>
+
+/**
+@brief Builds coarser levels of detail of a mesh by quadric error edge collapse
+@details Every collapse moves a vertex onto one of its neighbours (half edge collapse), so the levels are only new index lists into the
+vertices of the full mesh and whatever a vertex carries, uv, normal or bone weights, stays exact. The cost of a collapse is the
+Garland-Heckbert quadric error of both vertices at the position of the one that stays. Collapses between vertices whose strongest bone differs
+cost more so the joints of a skinned mesh keep their shape the longest.
+Vertices on a border or on a seam (another vertex at the same position) never move, so the mesh does not tear apart.
+The input is expected to be welded as a mesh with a vertex per triangle corner cannot collapse anything.
+simplify can be called again with smaller targets to get every level from the one before
+*/
+class MeshSimplifier
+{
+public:
+	MeshSimplifier();
+
+	/**@brief Start simplifying the triangle list @param indices into @param vertices*/
+	template<typename V>
+	void begin(const std::vector<V> &vertices, const std::vector<GLuint> &indices);
+
+	/**@brief Collapse edges until at most @param targetIndices indices are left or nothing can collapse anymore. Writes the triangles left to @param result*/
+	void simplify(unsigned int targetIndices, std::vector<GLuint> &result);
+	/**@brief Largest collapse cost so far, in squared model units*/
+	float getError() const;
+private:
+	/**@brief Symmetric 4x4 matrix of the squared distance to a set of planes*/
+	struct Quadric
+	{
+		float m_A[10]; //!< upper triangle, row by row
+
+		Quadric();
+		/**@brief The squared distance to the plane through @param p0, @param p1, @param p2, weighted by the area of the triangle*/
+		void setTriangle(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2);
+		void add(const Quadric &other);
+		float evaluate(const glm::vec3 &p) const;
+	};
+
+	struct Collapse
+	{
+		float m_Cost;
+		GLuint m_From;
+		GLuint m_To;
+		unsigned int m_FromVersion; //!< versions of the ends when queued. Their quadrics may have grown since
+		unsigned int m_ToVersion;
+		bool operator<(const Collapse &other) const { return m_Cost > other.m_Cost; } //!< cheapest on top
+	};
+
+	void start(const std::vector<GLuint> &indices);
+	/**@brief Queue the collapse of @param from onto @param to if @param from may move*/
+	void push(GLuint from, GLuint to);
+	/**@brief Moving @param from onto @param to keeps the surface manifold and every triangle facing the same way*/
+	bool isValid(GLuint from, GLuint to) const;
+	void collapse(GLuint from, GLuint to);
+
+	std::vector<glm::vec3> m_Positions;
+	std::vector<unsigned int> m_SkinGroups; //!< strongest bone of every vertex. All 0 for rigid meshes
+	std::vector<GLuint> m_Indices; //!< the triangles as they are collapsed
+	std::vector<bool> m_Dead; //!< triangles collapsed away
+	std::vector<std::vector<unsigned int> > m_VertexTriangles; //!< live triangles using a vertex
+	std::vector<Quadric> m_Quadrics;
+	std::vector<bool> m_Locked;
+	std::vector<bool> m_Removed;
+	std::vector<unsigned int> m_Versions;
+	std::priority_queue<Collapse> m_Queue;
+	unsigned int m_LiveIndices;
+	float m_Error;
+};
+
+/**@brief The bone with the largest weight. The influences are sorted by weight*/
+inline unsigned int getSkinGroup(const Vertex &vertex)
+{
+	return 0;
+}
+
+inline unsigned int getSkinGroup(const SkinnedVertex &vertex)
+{
+	return vertex.m_BoneIndices[0];
+}
+
+template<typename V>
+void MeshSimplifier::begin(const std::vector<V> &vertices, const std::vector<GLuint> &indices)
+{
+	m_Positions.resize(vertices.size());
+	m_SkinGroups.resize(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		m_Positions[i] = vertices[i].m_Position;
+		m_SkinGroups[i] = getSkinGroup(vertices[i]);
+	}
+	start(indices);
+}
\ No newline at end of file
@@ -12,23 +12,33 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <sstream>
+
 using std::map;
 using std::vector;
 using std::string;
 using std::endl;
 
 Model::Model(const std::string &name)
-	:m_Name(name)
+	:m_Name(name), m_Occluder(false), m_LodHysteresis(0.0f)
 {
 
 }
 Model::Model(const luapath::Table &modelTable)
-	: m_Name(modelTable.getKey().key)
+	: m_Name(modelTable.getKey().key), m_Occluder(false), m_LodHysteresis(0.0f)
 {
+	//optional. large solid models which hide what is behind them
+	luapath::Value occluderValue;
+	if (modelTable.getValue(".occluder", occluderValue))
+		m_Occluder = occluderValue;
 	loadShaders(modelTable);
+	loadOptimizer(modelTable);
+	loadLods(modelTable);
 	loadScene(modelTable);
 	// Process ASSIMP's root node recursively
 	processNode(m_Scene->mRootNode);
+	reportOptimizer();
+	reportLods();
 	m_Importer.FreeScene();
 }
 
@@ -72,6 +82,97 @@ void Model::loadShaders(const luapath::Table &modelTable)
 
 }
 
+void Model::loadOptimizer(const luapath::Table &modelTable)
+{
+	luapath::Table optimizeTable;
+	if (!modelTable.getTable(".optimize", optimizeTable))
+		return;
+	//every stage is on unless the table turns it off
+	MeshOptimizer::Options options = m_MeshOptimizer.getOptions();
+	options.m_Enabled = true;
+	luapath::Value value;
+	if (optimizeTable.getValue(".weld", value))
+		options.m_Weld = value;
+	if (optimizeTable.getValue(".vertexCache", value))
+		options.m_VertexCache = value;
+	if (optimizeTable.getValue(".vertexFetch", value))
+		options.m_VertexFetch = value;
+	if (optimizeTable.getValue(".shortIndices", value))
+		options.m_ShortIndices = value;
+	m_MeshOptimizer.setOptions(options);
+}
+
+void Model::reportOptimizer() const
+{
+	if (!m_MeshOptimizer.getOptions().m_Enabled)
+		return;
+	LOG(INFO) << "model : " << m_Name << " optimized from " << m_MeshOptimizer.getVerticesBefore() << " vertices, " << m_MeshOptimizer.getIndicesBefore()
+		<< " indices, ACMR " << m_MeshOptimizer.getACMRBefore() << " to " << m_MeshOptimizer.getVerticesAfter() << " vertices, "
+		<< m_MeshOptimizer.getIndicesAfter() << " indices, ACMR " << m_MeshOptimizer.getACMRAfter()
+		<< ". Meshes with 16 bit indices : " << m_MeshOptimizer.getShortMeshes() << "/" << m_Meshes.size();
+}
+
+void Model::loadLods(const luapath::Table &modelTable)
+{
+	luapath::Table lodTable;
+	if (!modelTable.getTable(".lod", lodTable))
+		return;
+	luapath::Value hysteresisValue;
+	if (lodTable.getValue(".hysteresis", hysteresisValue))
+		m_LodHysteresis = hysteresisValue;
+	luapath::Table levelsTable = lodTable.getTable(".levels");
+	int levelNum = 1; // lua indexing is not 0 based
+	luapath::Table levelTable;
+	while (levelsTable.getTable(string("#") + std::to_string(levelNum), levelTable))
+	{
+		if (m_LodLevels.size() + 1 == Mesh::MAX_LODS)
+		{
+			LOG(WARN) << "model : " << m_Name << " has more than " << Mesh::MAX_LODS - 1 << " levels of detail. The rest are ignored";
+			break;
+		}
+		LodLevel level;
+		level.m_Ratio = levelTable.getValue(".ratio");
+		level.m_ScreenSize = levelTable.getValue(".screenSize");
+		m_LodLevels.push_back(level);
+		levelNum++;
+	}
+	//a mesh with a vertex per triangle corner cannot collapse any edge
+	if (!m_LodLevels.empty() && !(m_MeshOptimizer.getOptions().m_Enabled && m_MeshOptimizer.getOptions().m_Weld))
+		LOG(WARN) << "model : " << m_Name << " has levels of detail but its vertices are not welded. Add an optimize table";
+}
+
+template<typename V>
+void Model::generateLods(Mesh *mesh, const std::vector<V> &vertices)
+{
+	if (m_LodLevels.empty() || mesh->m_Indices.empty())
+		return;
+	//every level goes on from the one before
+	m_MeshSimplifier.begin(vertices, mesh->m_Indices);
+	vector<GLuint> indices;
+	for (unsigned int i = 0; i < m_LodLevels.size(); i++)
+	{
+		unsigned int target = static_cast<unsigned int>(mesh->m_Indices.size() / 3 * m_LodLevels[i].m_Ratio) * 3;
+		m_MeshSimplifier.simplify(target, indices);
+		m_MeshOptimizer.optimizeLod(indices, vertices.size());
+		mesh->addLod(indices);
+	}
+}
+
+void Model::reportLods() const
+{
+	if (m_LodLevels.empty())
+		return;
+	std::stringstream triangles;
+	for (unsigned int lod = 0; lod <= m_LodLevels.size(); lod++)
+	{
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < m_Meshes.size(); i++)
+			count += m_Meshes[i]->getTriangles(lod);
+		triangles << (lod ? "/" : "") << count;
+	}
+	LOG(INFO) << "model : " << m_Name << " triangles of the levels of detail : " << triangles.str();
+}
+
 ShaderProgram* Model::getShaderProgram() const
 {
 	return m_ShaderProgram;
@@ -84,6 +185,8 @@ void Model::processNode(const aiNode* node)
 		Mesh *resultMesh = processMesh(mesh);
 		//allrighty. what is this, you ask. Even static meshes can have a transformation in their corresponding assimp Node. It was an oversight of me to ignore this transformation when designing the class so the following is a patch up
 		bakeTransform(resultMesh,node);
+		resultMesh->m_IndexType = m_MeshOptimizer.optimize(resultMesh->m_Vertices, resultMesh->m_Indices);
+		generateLods(resultMesh, resultMesh->m_Vertices);
 		resultMesh->createVAO(m_ShaderProgram);
 		m_Meshes.push_back(resultMesh);
 
@@ -290,51 +393,36 @@ Bone::~Bone()
 		delete *it;
 }
 
-const Bone* Bone::findBone(int boneIndex) const
-{
-	if (boneIndex == m_Id) return this;
-	for (unsigned int i = 0; i < m_Children.size(); ++i)
-	{
-		const Bone* p = m_Children[i]->findBone(boneIndex);
-		if (p) {
-			return p;
-		}
-	}
-	// there is definitely no sub-bone with this name
-	return NULL;
-}
-
-
-const Bone* Bone::findBone(const std::string &boneName) const
-{
-	if (boneName == m_Name) return this;
-	for (unsigned int i = 0; i < m_Children.size(); ++i)
-	{
-		const Bone* p = m_Children[i]->findBone(boneName);
-		if (p) {
-			return p;
-		}
-	}
-	// there is definitely no sub-bone with this name
-	return NULL;
-
-}
-
 SkinnedModel::SkinnedModel(const luapath::Table &modelTable)
-	:Model(modelTable.getKey().key)
+	:Model(modelTable.getKey().key), m_RawAnimBytes(0)
 {
 	loadShaders(modelTable);
+	loadOptimizer(modelTable);
+	loadLods(modelTable);
 
 	loadScene(modelTable);
 
 	loadBones(m_Scene->mRootNode);
+	//optional. influences lighter than this fraction of their vertex's total weight are dropped
+	luapath::Value thresholdValue;
+	if (modelTable.getValue(".influenceThreshold", thresholdValue))
+		m_InfluenceProcessor.setThreshold(thresholdValue);
 	processNode(m_Scene->mRootNode);
-
+	LOG(INFO) << "model : " << m_Name << " vertices with 1/2/3/4 bone influences : " << m_InfluenceProcessor.getVertexCount(1)
+		<< "/" << m_InfluenceProcessor.getVertexCount(2) << "/" << m_InfluenceProcessor.getVertexCount(3) << "/" << m_InfluenceProcessor.getVertexCount(4)
+		<< ", without any : " << m_InfluenceProcessor.getVertexCount(0) << ", influences pruned : " << m_InfluenceProcessor.getPruned();
+	reportOptimizer();
+	reportLods();
 
 	loadAnimations(modelTable);
 
 	m_Importer.FreeScene();
 
+}
+SkinnedModel::SkinnedModel(const std::string &name)
+	:Model(name), m_Skeleton(NULL), m_IdleAnimationId(0), m_RawAnimBytes(0)
+{
+
 }
 SkinnedModel::~SkinnedModel()
 {
@@ -345,49 +433,66 @@ SkinnedModel::~SkinnedModel()
 		delete it->second;
 }
 
-SkinnedModel::LocalTransformMap SkinnedModel::getBoneLocalTransforms() const
+const SkinnedModel::LocalPose& SkinnedModel::getBoneLocalTransforms() const
 {
 	return m_LocalTransforms;
 }
 
 //this is where the hierarchial calculation happens
-SkinnedModel::AbsoluteTransformMap SkinnedModel::getAbsoluteBoneTransforms(const LocalTransformMap &localTransforms, AbsoluteTransformMap &parentTransforms, bool includeIBP) const
+void SkinnedModel::getAbsoluteBoneTransforms(const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result, bool includeIBP) const
 {
-	AbsoluteTransformMap finalTransforms;
-	//finalTransforms.resize(localTransforms.size());
-	parentTransforms[m_Skeleton->m_Id] = glm::mat4();
-	calculateTransformations(m_Skeleton, glm::mat4(), localTransforms, parentTransforms, finalTransforms, includeIBP);
-	return finalTransforms;
+	parentTransforms.resize(m_LocalTransforms.size());
+	result.resize(m_LocalTransforms.size());
+	evaluateBones(0, m_LinearSkeleton.size(), localTransforms, parentTransforms, result);
+	//the inverse bind pose goes last as the children above read the plain model space transforms
+	if (includeIBP)
+		applyInverseBindPose(result);
 }
 
-void SkinnedModel::calculateTransformations(const Bone *currBone,
-	const glm::mat4 &parentTransform,
-	const LocalTransformMap &localTransforms,
-	AbsoluteTransformMap &parentTransforms,
-	AbsoluteTransformMap &result,
-	bool includeIBP) const
+void SkinnedModel::updateBoneSubtree(unsigned int boneId, const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result) const
 {
-	parentTransforms[currBone->m_Id] = parentTransform;
-	BoneIdMap::const_iterator it = m_BoneIdMap.find(currBone->m_Name);
-	glm::mat4 globalTransform;
-	if (it != m_BoneIdMap.end())
-	{
-		globalTransform = parentTransforms[currBone->m_Id] * localTransforms.at(it->second).getMatrix();
-		if (includeIBP)
-			result[it->second] = globalTransform * currBone->m_InverseBindPose;
-		else
-			result[it->second] = globalTransform;
-	}
-	else
-	{
-		globalTransform = parentTransforms[currBone->m_Id] * currBone->m_LocalTransformation.getMatrix();
-	}
-	for (unsigned int i = 0; i < currBone->m_Children.size(); i++)
+	//the descendants of a bone directly follow it in the depth first order
+	unsigned int first = m_LinearIndex[boneId];
+	evaluateBones(first, m_LinearSkeleton[first].m_SubtreeEnd, localTransforms, parentTransforms, result);
+}
+
+void SkinnedModel::evaluateBones(unsigned int first, unsigned int last, const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result) const
+{
+	//parents come first so their model space transform is already in result when the children need it
+	for (unsigned int i = first; i < last; i++)
 	{
-		calculateTransformations(currBone->m_Children[i], globalTransform, localTransforms, parentTransforms, result, includeIBP);
+		const LinearBone &bone = m_LinearSkeleton[i];
+		glm::mat4 parentTransform;
+		if (bone.m_Parent != -1)
+			parentTransform = result[bone.m_Parent];
+		if (bone.m_HasOffset)
+			parentTransform = parentTransform * bone.m_Offset;
+		parentTransforms[bone.m_Id] = parentTransform;
+		result[bone.m_Id] = parentTransform * localTransforms[bone.m_Id].getMatrix();
 	}
 }
 
+void SkinnedModel::applyInverseBindPose(AbsolutePose &pose) const
+{
+	for (unsigned int i = 0; i < pose.size(); i++)
+		pose[i] *= m_InverseBindPoses[i];
+}
+
+const Bone* SkinnedModel::findBone(int boneIndex) const
+{
+	if (boneIndex < 0 || (unsigned int)boneIndex >= m_BonesById.size())
+		return NULL;
+	return m_BonesById[boneIndex];
+}
+
+const Bone* SkinnedModel::findBone(const std::string &boneName) const
+{
+	BoneNameMap::const_iterator it = m_BonesByName.find(boneName);
+	if (it == m_BonesByName.end())
+		return NULL;
+	return it->second;
+}
+
 bool SkinnedModel::hasAnimation() const
 {
 	return m_AnimMap.size() > 0 ? true : false;
@@ -439,12 +544,53 @@ void SkinnedModel::loadBones(const aiNode *rootBone)
 {
 	AiBoneMap aiBoneMap;
 	createBoneLookupMaps(aiBoneMap, m_BoneIdMap);
-
-	//m_LocalTransforms.resize(aiBoneMap.size());
+	if(aiBoneMap.size() > MAX_BONES)
+		LOG(WARN) << "model : " << m_Name << " has " << aiBoneMap.size() << " bones. Only the first " << MAX_BONES
+			<< " are animated, the rest are treated as plain nodes and their vertex weights are dropped";
+
+	m_LocalTransforms.resize(std::min<unsigned int>(aiBoneMap.size(), MAX_BONES));
+	m_InverseBindPoses.assign(m_LocalTransforms.size(), glm::mat4());
+	m_BonesById.assign(m_LocalTransforms.size(), NULL);
+	m_LinearIndex.assign(m_LocalTransforms.size(), 0);
 	m_Skeleton = new Bone;
 	m_Skeleton->m_Parent = NULL;
 	loadBones(rootBone, aiBoneMap, m_Skeleton);
 
+	m_LinearSkeleton.clear();
+	linearizeSkeleton(m_Skeleton, -1, glm::mat4(), false);
+}
+
+void SkinnedModel::linearizeSkeleton(const Bone *currBone, int parentBone, const glm::mat4 &offset, bool hasOffset)
+{
+	//insert keeps the first node in depth first order when names repeat, like the old recursive search
+	m_BonesByName.insert(BoneNameMap::value_type(currBone->m_Name, currBone));
+	glm::mat4 childOffset;
+	bool childHasOffset = false;
+	unsigned int index = m_LinearSkeleton.size();
+	if (currBone->m_Id != -1)
+	{
+		LinearBone bone;
+		bone.m_Id = currBone->m_Id;
+		bone.m_Parent = parentBone;
+		bone.m_HasOffset = hasOffset;
+		bone.m_Offset = offset;
+		bone.m_SubtreeEnd = index + 1;
+		m_LinearSkeleton.push_back(bone);
+		m_LinearIndex[currBone->m_Id] = index;
+		m_InverseBindPoses[currBone->m_Id] = currBone->m_InverseBindPose;
+		m_BonesById[currBone->m_Id] = currBone;
+		parentBone = currBone->m_Id;
+	}
+	else
+	{
+		//plain nodes never animate so their transforms fold into the offset of the bones below them
+		childOffset = offset * currBone->m_LocalTransformation.getMatrix();
+		childHasOffset = true;
+	}
+	for (unsigned int i = 0; i < currBone->m_Children.size(); i++)
+		linearizeSkeleton(currBone->m_Children[i], parentBone, childOffset, childHasOffset);
+	if (currBone->m_Id != -1)
+		m_LinearSkeleton[index].m_SubtreeEnd = m_LinearSkeleton.size();
 }
 
 void SkinnedModel::loadBones(const aiNode *currNode, const AiBoneMap &aiBoneMap, Bone *currBone)
@@ -456,7 +602,8 @@ void SkinnedModel::loadBones(const aiNode *currNode, const AiBoneMap &aiBoneMap,
 	glm::mat4 temp = convertToGLMMat4(currNode->mTransformation);
 	//if the current node is a bone
 	BoneIdMap::const_iterator it = m_BoneIdMap.find(currBone->m_Name);
-	if(it != m_BoneIdMap.end())
+	//bones past MAX_BONES cannot be stored in the pose arrays (or the shader) so they are treated as plain nodes
+	if(it != m_BoneIdMap.end() && it->second < MAX_BONES)
 	{
 		currBone->m_Id = it->second;
 		//currBone->m_Id = m_BoneIdMap[currBone->m_Name];
@@ -517,6 +664,15 @@ void SkinnedModel::loadAnimations(const luapath::Table &modelTable)
 	if (!m_Scene->HasAnimations())
 		return;
 
+	//a channel type left out of the compression table keeps a tolerance of 0
+	luapath::Value toleranceValue;
+	if (modelTable.getValue(".compression.position", toleranceValue))
+		m_CompressionTolerance.m_Position = toleranceValue;
+	if (modelTable.getValue(".compression.rotation", toleranceValue))
+		m_CompressionTolerance.m_Rotation = toleranceValue;
+	if (modelTable.getValue(".compression.scale", toleranceValue))
+		m_CompressionTolerance.m_Scale = toleranceValue;
+
 	luapath::Value rootAnimValue;
 	string rootAnimName = "";
 	if (modelTable.getValue(".animationName", rootAnimValue))
@@ -564,12 +720,22 @@ void SkinnedModel::loadAnimations(const luapath::Table &modelTable)
 			additionalAnimNum++;
 		}
 	}
+
+	resampleAnimations(modelTable);
+
+	if (m_CompressionTolerance.isEnabled() && m_RawAnimBytes > 0)
+	{
+		size_t compressedBytes = 0;
+		for (AnimMap::const_iterator it = m_AnimMap.begin(); it != m_AnimMap.end(); ++it)
+			compressedBytes += it->second->getMemorySize();
+		LOG(INFO) << "animations of model : " << m_Name << " compressed from " << m_RawAnimBytes << " to " << compressedBytes
+			<< " bytes. ratio " << (float)m_RawAnimBytes / compressedBytes;
+	}
 }
 
 void SkinnedModel::loadAnimation(const aiAnimation *currAnim, const std::string &animName, int numAnim)
 {
 	Animation *newAnim = new Animation;
-	//newAnim->m_BoneAnim.resize(m_BoneIdMap.size());
 	if (animName == "")
 		newAnim->m_Name = currAnim->mName.data;
 	else
@@ -592,22 +758,115 @@ void SkinnedModel::loadAnimation(const aiAnimation *currAnim, const std::string
 	// and the id in the other map
 	m_AnimIdMap[newAnim->m_Name] = numAnim;
 
+	//the raw keys are only kept around until the clip is compiled
+	vector<BoneAnim*> rawBoneAnims;
+	vector<const BoneAnim*> boneAnims(newAnim->m_NumBones, NULL);
 	//now for each channel/bone of the animation
 	for (int j = 0; j < currAnim->mNumChannels; j++)
 	{
 		const aiNodeAnim *currNode = currAnim->mChannels[j];
 		const string boneName = currNode->mNodeName.data;
-		//we are using "at" function. It will throw an exception if not existing
 		BoneIdMap::const_iterator it = m_BoneIdMap.find(boneName);
-		if(it != m_BoneIdMap.end())
+		if(it != m_BoneIdMap.end() && it->second < boneAnims.size())
 		{
-			int boneId = m_BoneIdMap[boneName];
 			// 1:1 mapping from assimp to glm (for now)
 			BoneAnim *newBoneAnim = new BoneAnim(currNode);
-			newAnim->m_BoneAnim[boneId] = newBoneAnim;
+			rawBoneAnims.push_back(newBoneAnim);
+			boneAnims[it->second] = newBoneAnim;
+		}
+
+	}
+	newAnim->m_Clip.compile(boneAnims, m_LocalTransforms);
+	for (unsigned int i = 0; i < rawBoneAnims.size(); i++)
+		delete rawBoneAnims[i];
+
+	size_t rawBytes = newAnim->getMemorySize();
+	m_RawAnimBytes += rawBytes;
+	if (m_CompressionTolerance.isEnabled())
+	{
+		//keep the uncompressed keys around to measure how far off the compressed ones are
+		Animation reference = *newAnim;
+		newAnim->compress(m_CompressionTolerance);
+		float poseError = measurePoseError(reference, *newAnim);
+		LOG(INFO) << "animation : " << newAnim->m_Name << " compressed from " << rawBytes << " to " << newAnim->getMemorySize()
+			<< " bytes. ratio " << (float)rawBytes / newAnim->getMemorySize() << " max pose error " << poseError;
+	}
+	else
+	{
+		LOG(DEBUG) << "animation : " << newAnim->m_Name << " compiled into " << rawBytes << " bytes";
+	}
+}
+
+void SkinnedModel::resampleAnimations(const luapath::Table &modelTable)
+{
+	luapath::Table resampleTable;
+	if (!modelTable.getTable(".resample", resampleTable))
+		return;
+	//the dense frames follow the tick rate of each clip
+	unsigned int framesPerTick = 1;
+	luapath::Value framesValue;
+	if (resampleTable.getValue(".framesPerTick", framesValue))
+		framesPerTick = (int)framesValue;
+
+	std::vector<string> animNames;
+	luapath::Table animNamesTable;
+	if (resampleTable.getTable(".animations", animNamesTable))
+	{
+		int animNum = 1; // lua indexing is not 0 based
+		luapath::Value animName;
+		while (animNamesTable.getValue(string("#") + std::to_string(animNum), animName))
+		{
+			string name = animName;
+			animNames.push_back(name);
+			animNum++;
 		}
+	}
+	else
+	{
+		//no list means every animation of the model
+		for (AnimIdMap::const_iterator it = m_AnimIdMap.begin(); it != m_AnimIdMap.end(); ++it)
+			animNames.push_back(it->first);
+	}
 
+	for (unsigned int i = 0; i < animNames.size(); i++)
+	{
+		AnimIdMap::const_iterator it = m_AnimIdMap.find(animNames[i]);
+		if (it == m_AnimIdMap.end())
+		{
+			LOG(WARN) << "cannot resample animation : " << animNames[i] << " of model : " << m_Name << ". No such animation";
+			continue;
+		}
+		Animation *anim = m_AnimMap.at(it->second);
+		anim->resample(framesPerTick);
+		LOG(INFO) << "animation : " << anim->m_Name << " resampled at " << anim->m_TicksPerSecond * framesPerTick << "Hz into " << anim->m_DenseClip.m_NumFrames
+			<< " frames. " << anim->m_DenseClip.getMemorySize() << " bytes";
+	}
+}
+
+float SkinnedModel::measurePoseError(const Animation &reference, const Animation &other) const
+{
+	//sampling rate of the comparison
+	const double sampleStep = 1.0 / 60.0;
+	float maxError = 0;
+	LocalPose referenceLocal = m_LocalTransforms;
+	LocalPose otherLocal = m_LocalTransforms;
+	AbsolutePose parentTransforms;
+	AbsolutePose referencePose;
+	AbsolutePose otherPose;
+	for (double time = 0; time < reference.m_TotalDuration; time += sampleStep)
+	{
+		reference.getTransforms(time, referenceLocal);
+		other.getTransforms(time, otherLocal);
+		getAbsoluteBoneTransforms(referenceLocal, parentTransforms, referencePose, false);
+		getAbsoluteBoneTransforms(otherLocal, parentTransforms, otherPose, false);
+		for (unsigned int i = 0; i < referencePose.size(); i++)
+		{
+			glm::vec3 referencePosition(referencePose[i][3]);
+			glm::vec3 otherPosition(otherPose[i][3]);
+			maxError = std::max(maxError, glm::length(referencePosition - otherPosition));
+		}
 	}
+	return maxError;
 }
 
 unsigned int SkinnedModel::findBoneIndex(const std::string &boneName) const
@@ -646,50 +905,13 @@ Mesh* SkinnedModel::processMesh(const aiMesh* mesh)
 
 	SkinnedMesh* resultMesh = new SkinnedMesh();
 
-	// collect weights on all vertices for filling up the SkinnedVertex later
-	std::vector<std::vector<aiVertexWeight> > vertexWeights(mesh->mNumVertices);
-	for (GLuint a = 0; a < mesh->mNumBones; a++)	{
-		const aiBone* bone = mesh->mBones[a];
-		for (unsigned int b = 0; b < bone->mNumWeights; b++)
-			vertexWeights[bone->mWeights[b].mVertexId].push_back(aiVertexWeight(m_BoneIdMap.at(bone->mName.data), bone->mWeights[b].mWeight));
-	}
-
+	m_InfluenceProcessor.process(mesh, m_BoneIdMap);
+	resultMesh->m_SkinnedVertices.reserve(mesh->mNumVertices);
 	for (GLuint v = 0; v < mesh->mNumVertices; v++)
 	{
-		std::vector<aiVertexWeight> currVertex = vertexWeights[v];
-		glm::vec4 boneWeights;
-		glm::uvec4 boneIndices;
-		int currVertexSize = currVertex.size();
-		//no more than 4 bones allowed for now
-		for (GLuint b = 0; b < currVertexSize && b < 4; b++)
-		{
-			boneWeights[b] = currVertex[b].mWeight;
-			boneIndices[b] = currVertex[b].mVertexId; // actually mVertexId here stands for the boneIndex. Make sure not to be confused in the future
-		}
-		//...start of hack: the following code distributes any "spurious" influences (i.e over 4 bones) proportionally across the first 4 bones.
-		if(currVertexSize > 4) 
-		{
-			float goodBoneProportion[4];
-			for (int i = 0; i < 4; i++)
-			{
-				goodBoneProportion[i] = boneWeights[i] * (boneWeights[0]+boneWeights[1]+boneWeights[2]+boneWeights[3]);
-			}
-			// now distribute bad bones
-			for (int i = 4; i < currVertexSize; i++)
-			{
-				boneWeights[0] += currVertex[i].mWeight * goodBoneProportion[0];
-				boneWeights[1] += currVertex[i].mWeight * goodBoneProportion[1];
-				boneWeights[2] += currVertex[i].mWeight * goodBoneProportion[2];
-				boneWeights[3] += currVertex[i].mWeight * goodBoneProportion[3];
-			}
-			float newWeight = boneWeights.x + boneWeights.y + boneWeights.z + boneWeights.w;
-		    boneWeights.x += (1 - newWeight - 0.00001f);
-		//...end of hack
-		}
-
 		SkinnedVertex vertex = retrieveVertex(mesh, v);
-		vertex.m_BoneIndices = boneIndices;
-		vertex.m_BoneWeights = boneWeights;
+		vertex.m_BoneIndices = m_InfluenceProcessor.getIndices(v);
+		vertex.m_BoneWeights = m_InfluenceProcessor.getWeights(v);
 
 		resultMesh->m_SkinnedVertices.push_back(vertex);
 	}
@@ -700,6 +922,8 @@ Mesh* SkinnedModel::processMesh(const aiMesh* mesh)
 	retrieveIndices(resultMesh, mesh);
 	retrieveMaterials(resultMesh, mesh);
 
+	resultMesh->m_IndexType = m_MeshOptimizer.optimize(resultMesh->m_SkinnedVertices, resultMesh->m_Indices);
+	generateLods(resultMesh, resultMesh->m_SkinnedVertices);
 	resultMesh->createVAO(m_ShaderProgram);
 	return resultMesh;
 }
@@ -3,7 +3,12 @@
 #include "Mesh.hpp"
 #include "Animation.hpp"
 #include "SQTTransform.hpp"
+#include "BoneArray.hpp"
+#include "InfluenceProcessor.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
 
+#include <unordered_map>
 #include <luapath/luapath.hpp>
 #include <assimp/Importer.hpp>
 #include <glm/glm.hpp>
@@ -42,6 +47,17 @@ protected:
 	virtual void loadScene(const luapath::Table &modelTable);
 	/**Calls ShaderManager to retrieve a ShaderProgram object */
 	void loadShaders(const luapath::Table &modelTable);
+	/**@brief Read the optional optimize table which turns on the mesh optimization of the meshes while loading*/
+	void loadOptimizer(const luapath::Table &modelTable);
+	/**@brief Log the counts of the meshes before and after the optimization if it ran*/
+	void reportOptimizer() const;
+	/**@brief Read the optional lod table with the ratio and screen size of every coarser level of detail*/
+	void loadLods(const luapath::Table &modelTable);
+	/**@brief Simplify @param mesh into the levels of detail of m_LodLevels. @param vertices are the vertices of the mesh*/
+	template<typename V>
+	void generateLods(Mesh *mesh, const std::vector<V> &vertices);
+	/**@brief Log the triangles of every level of detail summed over the meshes*/
+	void reportLods() const;
 
 	/**Get a single Vertex at position @param i of @param mesh. */
 	Vertex retrieveVertex(const aiMesh* mesh, int i);
@@ -80,6 +96,16 @@ public:
 	const std::string m_Name;
 	std::vector<Mesh*> m_Meshes; //!< the array of meshes that are rendered
 	ShaderProgram *m_ShaderProgram;
+	bool m_Occluder; //!< rasterized into the occlusion depth buffer when placed in the level
+
+	/**@brief A coarser level of detail*/
+	struct LodLevel
+	{
+		float m_Ratio; //!< fraction of the triangles of the full mesh it keeps
+		float m_ScreenSize; //!< objects are drawn with it once their bounds cover less than this fraction of the screen height
+	};
+	std::vector<LodLevel> m_LodLevels; //!< from the finest to the coarsest. Empty if the model only has the full meshes
+	float m_LodHysteresis; //!< the screen size has to be this fraction past a threshold before the level changes, so objects near it do not flicker
 
 protected:
 	//used by subclasses only
@@ -89,11 +115,14 @@ protected:
 	const aiScene *m_Scene; //!< freed at the end of the constructor
 	std::string m_ModelDir;  //!< contains the folder directory of the model
 	std::vector<Texture> m_TexturesLoaded; //!< structure to speed up loading textures which have been loaded before
+	MeshOptimizer m_MeshOptimizer; //!< welds and reorders the vertices and indices of the meshes. Only used while loading
+	MeshSimplifier m_MeshSimplifier; //!< builds the levels of detail. Only used while loading
 };
 
 
 /**
 @brief Recursive bone structure for SkinnedModel
+@details Only used to walk up or down the hierarchy. Lookups and pose evaluation go through the flattened tables of SkinnedModel
 @todo enforce constness on member variables
 */
 struct Bone
@@ -106,12 +135,6 @@ struct Bone
 	glm::mat4 m_InverseBindPose; //!< converts from model space to bone space
 	Bone *m_Parent;
 	std::vector<Bone*> m_Children;
-
-	/**Find a bone in the hierarchy by the given @param boneIndex*/
-	const Bone* findBone(int boneIndex) const;
-	/**Find a bone in the hierarchy by the given @param boneName*/
-	const Bone* findBone(const std::string &boneName) const;
-
 };
 
 /**@brief An extension of the plain Model which can only represent rigid models.
@@ -130,10 +153,10 @@ public:
 	/**Deletes the skeleton of the model*/
 	~SkinnedModel();
 
-	/** index to bone local sqt transform  */
-	typedef std::map<unsigned int, SQTTransform> LocalTransformMap;
-	/** index to the final transformation matrix */
-	typedef std::map<unsigned int, glm::mat4> AbsoluteTransformMap;
+	/** bone id to bone local sqt transform  */
+	typedef BoneArray<SQTTransform> LocalPose;
+	/** bone id to the final transformation matrix */
+	typedef BoneArray<glm::mat4> AbsolutePose;
 
 	/** index to aiBone map for quick lookup when building bone structure. This structure is only used during initialization */
 	typedef std::map<unsigned int, const aiBone*> AiBoneMap;
@@ -142,14 +165,28 @@ public:
 	typedef std::map<std::string, unsigned int> BoneIdMap;
 	BoneIdMap m_BoneIdMap; //!< speed up 
 
-	/** Get the array of (bone id, bone transform) pairs */
-	LocalTransformMap getBoneLocalTransforms() const;
+	/** Get the bind pose local transforms indexed by bone id */
+	const LocalPose& getBoneLocalTransforms() const;
 
 	/**Calculate the final blended matrix from the GlobalInverseTransform, 
 		the upstream @param localTransforms and the Bone InverseBindPose
-		Recursively calculate the bone transform
+		Walks the flattened skeleton front to back. Writes in place to @param parentTransforms and @param result
 	*/
-	AbsoluteTransformMap getAbsoluteBoneTransforms(const LocalTransformMap &localTransforms, AbsoluteTransformMap &parentTransforms, bool includeIBP) const;
+	void getAbsoluteBoneTransforms(const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result, bool includeIBP) const;
+
+	/**@brief Recompute the model space transforms of @param boneId and its descendants only, without the inverse bind pose.
+		@details @param result has to hold the transforms of the rest of the skeleton, as left by getAbsoluteBoneTransforms with includeIBP false.
+		Used by IK where a single link changes at a time
+	*/
+	void updateBoneSubtree(unsigned int boneId, const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result) const;
+
+	/**@brief Multiply every model space bone transform of @param pose by the inverse bind pose of the bone*/
+	void applyInverseBindPose(AbsolutePose &pose) const;
+
+	/**@brief Find a bone by id in O(1). NULL if there is no such bone*/
+	const Bone* findBone(int boneIndex) const;
+	/**@brief Find a bone or node of the skeleton by name in O(1). NULL if there is no such node*/
+	const Bone* findBone(const std::string &boneName) const;
 
 	bool hasAnimation() const;
 	/**@brief Get the animation that plays when there is no user input*/
@@ -163,6 +200,9 @@ public:
 	unsigned int findBoneIndex(const std::string &boneName) const;
 
 protected:
+	/**@brief An empty model without meshes, skeleton or animations, for subclasses that build them by hand*/
+	SkinnedModel(const std::string &name);
+
 	/**Prints the assimp animation hierachy*/
 	void printAnimHierarchy() const;
 	/**Create the bone lookup table from the asssimp scene*/
@@ -173,27 +213,50 @@ protected:
 	/**Companion to loadBones*/
 	void loadBones(const aiNode *currNode, const AiBoneMap &aiBoneMap, Bone *currBone);
 
+	/**@brief Flattens the subtree of @param currBone into m_LinearSkeleton and the lookup tables.
+		@param parentBone id of the closest ancestor which is a bone
+		@param offset the product of the plain node transforms between that ancestor and @param currBone
+	*/
+	void linearizeSkeleton(const Bone *currBone, int parentBone, const glm::mat4 &offset, bool hasOffset);
+
+	/**Companion to getAbsoluteBoneTransforms. Evaluates the bones in [@param first, @param last) of m_LinearSkeleton*/
+	void evaluateBones(unsigned int first, unsigned int last, const LocalPose &localTransforms, AbsolutePose &parentTransforms, AbsolutePose &result) const;
+
 	/**Load the animations from assimp scene into the internal animation representation*/
 	void loadAnimations(const luapath::Table &modelTable);
 
 	/**Load the animations from assimp scene into the internal animation representation*/
 	void loadAnimation(const aiAnimation *currAnim, const std::string &animName, int numAnim);
 
-	virtual void processNode(const aiNode *node);
-	virtual Mesh* processMesh(const aiMesh *mesh);
+	/**@brief Builds the dense frames of the animations listed in the resample table of @param modelTable*/
+	void resampleAnimations(const luapath::Table &modelTable);
 
-	/**Companion to getAbsoluteBoneTransforms*/
-	void calculateTransformations(const Bone *parentNode,
-									const glm::mat4 &parentTransform,
-									const LocalTransformMap &localTransforms,
-									AbsoluteTransformMap &parentTransforms,
-									AbsoluteTransformMap &result,
-									bool includeIBP) const;
+	/**@brief The largest distance between the model space bone positions of the two animations sampled over the whole clip.
+		Used to report the error of compression*/
+	float measurePoseError(const Animation &reference, const Animation &other) const;
 
+	virtual void processNode(const aiNode *node);
+	virtual Mesh* processMesh(const aiMesh *mesh);
 
 public:
 	Bone *m_Skeleton;
 protected:
+	/**@brief A bone of the flattened skeleton*/
+	struct LinearBone
+	{
+		unsigned int m_Id; //!< bone id. Indexes the pose arrays
+		int m_Parent; //!< bone id of the closest ancestor that is a bone. -1 if there is none
+		bool m_HasOffset; //!< false when no plain node sits between the bone and m_Parent so m_Offset can be skipped
+		glm::mat4 m_Offset; //!< fixed transform of the plain nodes between m_Parent and this bone
+		unsigned int m_SubtreeEnd; //!< one past the last descendant in m_LinearSkeleton
+	};
+	std::vector<LinearBone> m_LinearSkeleton; //!< the bones in depth first order so a parent always comes before its children
+	BoneArray<glm::mat4> m_InverseBindPoses; //!< indexed by bone id
+	BoneArray<const Bone*> m_BonesById; //!< bone id to the bone in the hierarchy
+	BoneArray<unsigned int> m_LinearIndex; //!< bone id to its position in m_LinearSkeleton
+	typedef std::unordered_map<std::string, const Bone*> BoneNameMap;
+	BoneNameMap m_BonesByName; //!< every node of the hierarchy by name
+
 	//!< lookup quicker with ids
 	typedef std::map<unsigned int, Animation*> AnimMap;
 	AnimMap m_AnimMap;
@@ -205,6 +268,10 @@ protected:
 	//const aiNode *m_rootBoneNode; //!< the root of the scene. Becomes invalid after initialization
 
 	//glm::mat4 m_GlobalInverseTransform; //!< the matrix fixes model axis to openGL axis
-	LocalTransformMap m_LocalTransforms; //!< the array of bone transforms used as template for Object instances
+	LocalPose m_LocalTransforms; //!< the array of bone transforms used as template for Object instances
+
+	CompressionTolerance m_CompressionTolerance; //!< animations are compressed when it is enabled. Only used while loading
+	InfluenceProcessor m_InfluenceProcessor; //!< prunes and renormalizes the bone weights of the meshes. Only used while loading
+	size_t m_RawAnimBytes; //!< bytes the animations would take uncompressed. Only used for the load report
 
 };
\ No newline at end of file
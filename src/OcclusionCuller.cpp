@@ -0,0 +1,319 @@
+#include "OcclusionCuller.hpp"
+#include "Model.hpp"
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//clip space w below which a vertex counts as crossing the near plane
+static const float NEAR_W = 1e-3f;
+
+OcclusionCuller& OcclusionCuller::get()
+{
+	static OcclusionCuller singleton;
+	return singleton;
+}
+
+OcclusionCuller::OcclusionCuller()
+	:m_Enabled(false), m_Width(0), m_Height(0), m_Tested(0), m_Occluded(0)
+{
+	setSimdLevel(getSimdLevel());
+	LOG(INFO) << "occlusion raster kernel : " << m_Name;
+}
+
+void OcclusionCuller::setSimdLevel(SimdLevel level)
+{
+	//4 pixels per register is all a row needs, AVX2 machines take the SSE2 path
+	m_RasterizeSpan = selectSimdPath(level, SIMD_PATHS(&OcclusionCuller::spanScalar, &OcclusionCuller::spanSSE2, &OcclusionCuller::spanSSE2), m_Name);
+}
+
+const std::string& OcclusionCuller::getName() const
+{
+	return m_Name;
+}
+
+void OcclusionCuller::init(unsigned int width, unsigned int height)
+{
+	m_Width = (width + 3) / 4 * 4;
+	m_Height = height;
+	m_Enabled = m_Width && m_Height;
+	m_Levels.clear();
+	if (!m_Enabled)
+		return;
+	//halve until a single texel is left. Odd sizes round up so every pixel has a parent
+	unsigned int levelWidth = m_Width, levelHeight = m_Height;
+	while (true)
+	{
+		Level level;
+		level.m_Width = levelWidth;
+		level.m_Height = levelHeight;
+		level.m_Depth.assign(levelWidth * levelHeight, 1.0f);
+		m_Levels.push_back(level);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+	LOG(INFO) << "occlusion depth buffer : " << m_Width << "x" << m_Height << ", " << m_Levels.size() << " levels";
+}
+
+bool OcclusionCuller::isEnabled() const
+{
+	return m_Enabled;
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProjection)
+{
+	m_ViewProjection = viewProjection;
+	m_Triangles.clear();
+	m_Tested = m_Occluded = 0;
+}
+
+void OcclusionCuller::addOccluder(const Model *model, const glm::mat4 &modelMatrix)
+{
+	for (unsigned int m = 0; m < model->m_Meshes.size(); m++)
+	{
+		const Mesh *mesh = model->m_Meshes[m];
+		if (mesh->m_Vertices.empty() || mesh->m_Indices.empty())
+			continue;
+		addOccluder(&mesh->m_Vertices[0].m_Position, sizeof(Vertex), mesh->m_Vertices.size(), &mesh->m_Indices[0], mesh->m_Indices.size(), modelMatrix);
+	}
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3 *positions, unsigned int stride, unsigned int numVertices, const GLuint *indices, unsigned int numIndices,
+	const glm::mat4 &modelMatrix)
+{
+	if (!m_Enabled)
+		return;
+	glm::mat4 modelViewProjection = m_ViewProjection * modelMatrix;
+	glm::vec2 screenScale(0.5f * m_Width, 0.5f * m_Height);
+	m_Clip.resize(numVertices);
+	const unsigned char *position = reinterpret_cast<const unsigned char*>(positions);
+	for (unsigned int v = 0; v < numVertices; v++, position += stride)
+		m_Clip[v] = modelViewProjection * glm::vec4(*reinterpret_cast<const glm::vec3*>(position), 1.0f);
+
+	for (unsigned int i = 0; i + 2 < numIndices; i += 3)
+	{
+		Triangle triangle;
+		bool valid = true;
+		for (unsigned int k = 0; k < 3 && valid; k++)
+		{
+			const glm::vec4 &clip = m_Clip[indices[i + k]];
+			//dropping it leaves a hole, which can only make less of the scene hidden
+			valid = clip.w > NEAR_W;
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			triangle.m_Vertices[k] = glm::vec3((ndc.x + 1.0f) * screenScale.x, (ndc.y + 1.0f) * screenScale.y, ndc.z * 0.5f + 0.5f);
+		}
+		if (!valid)
+			continue;
+		glm::vec3 &a = triangle.m_Vertices[0];
+		glm::vec3 &b = triangle.m_Vertices[1];
+		glm::vec3 &c = triangle.m_Vertices[2];
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (std::abs(area) < 1e-6f)
+			continue;
+		//occluders are drawn from both sides. Make them counter clockwise so inside is where all edge functions are positive
+		if (area < 0.0f)
+			std::swap(b, c);
+		float minX = std::min(a.x, std::min(b.x, c.x));
+		float maxX = std::max(a.x, std::max(b.x, c.x));
+		triangle.m_MinY = std::min(a.y, std::min(b.y, c.y));
+		triangle.m_MaxY = std::max(a.y, std::max(b.y, c.y));
+		if (maxX < 0.0f || minX > m_Width || triangle.m_MaxY < 0.0f || triangle.m_MinY > m_Height)
+			continue;
+		m_Triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize(bool parallel)
+{
+	if (!m_Enabled)
+		return;
+	std::fill(m_Levels[0].m_Depth.begin(), m_Levels[0].m_Depth.end(), 1.0f);
+	unsigned int bands = (m_Height + BAND_ROWS - 1) / BAND_ROWS;
+	if (parallel)
+		WorkerPool::get().run(*this, bands);
+	else
+		for (unsigned int i = 0; i < bands; i++)
+			execute(i);
+	buildPyramid();
+}
+
+void OcclusionCuller::execute(unsigned int index)
+{
+	rasterizeRows(index * BAND_ROWS, std::min((index + 1) * BAND_ROWS, m_Height));
+}
+
+void OcclusionCuller::rasterizeRows(unsigned int rowBegin, unsigned int rowEnd)
+{
+	float *depth = &m_Levels[0].m_Depth[0];
+	for (unsigned int t = 0; t < m_Triangles.size(); t++)
+	{
+		const Triangle &triangle = m_Triangles[t];
+		if (triangle.m_MaxY < rowBegin || triangle.m_MinY >= rowEnd)
+			continue;
+		const glm::vec3 &a = triangle.m_Vertices[0];
+		const glm::vec3 &b = triangle.m_Vertices[1];
+		const glm::vec3 &c = triangle.m_Vertices[2];
+
+		//edge functions e = stepX * x + stepY * y + offset, positive inside. Edge i is opposite vertex i so it is also its barycentric weight
+		TrianglePlanes planes;
+		planes.m_StepX[0] = b.y - c.y; planes.m_StepX[1] = c.y - a.y; planes.m_StepX[2] = a.y - b.y;
+		planes.m_StepY[0] = c.x - b.x; planes.m_StepY[1] = a.x - c.x; planes.m_StepY[2] = b.x - a.x;
+		planes.m_Offset[0] = b.x * c.y - b.y * c.x; planes.m_Offset[1] = c.x * a.y - c.y * a.x; planes.m_Offset[2] = a.x * b.y - a.y * b.x;
+		float area = planes.m_Offset[0] + planes.m_Offset[1] + planes.m_Offset[2];
+		//the depth is a plane over the screen too
+		planes.m_DepthStepX = (planes.m_StepX[0] * a.z + planes.m_StepX[1] * b.z + planes.m_StepX[2] * c.z) / area;
+		planes.m_DepthStepY = (planes.m_StepY[0] * a.z + planes.m_StepY[1] * b.z + planes.m_StepY[2] * c.z) / area;
+		planes.m_DepthOffset = (planes.m_Offset[0] * a.z + planes.m_Offset[1] * b.z + planes.m_Offset[2] * c.z) / area;
+
+		int minX = std::max((int)std::floor(std::min(a.x, std::min(b.x, c.x))), 0);
+		int maxX = std::min((int)std::ceil(std::max(a.x, std::max(b.x, c.x))), (int)m_Width - 1);
+		int minY = std::max((int)std::floor(triangle.m_MinY), (int)rowBegin);
+		int maxY = std::min((int)std::ceil(triangle.m_MaxY), (int)rowEnd - 1);
+		//whole registers. The pixels left of the triangle fail the edge test
+		minX &= ~3;
+
+		for (int y = minY; y <= maxY; y++)
+			m_RasterizeSpan(planes, y + 0.5f, minX, maxX, depth + y * m_Width);
+	}
+}
+
+void OcclusionCuller::spanScalar(const TrianglePlanes &planes, float centerY, int minX, int maxX, float *row)
+{
+	//same order of operations as the SSE2 path so both cover the same pixels
+	float edgeRow[3];
+	for (unsigned int e = 0; e < 3; e++)
+		edgeRow[e] = planes.m_StepY[e] * centerY + planes.m_Offset[e];
+	float depthRow = planes.m_DepthStepY * centerY + planes.m_DepthOffset;
+	for (int x = minX; x <= maxX; x++)
+	{
+		float centerX = x + 0.5f;
+		bool inside = true;
+		for (unsigned int e = 0; e < 3 && inside; e++)
+			inside = planes.m_StepX[e] * centerX + edgeRow[e] >= 0.0f;
+		if (inside)
+			row[x] = std::min(row[x], planes.m_DepthStepX * centerX + depthRow);
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2
+void OcclusionCuller::spanSSE2(const TrianglePlanes &planes, float centerY, int minX, int maxX, float *row)
+{
+	__m128 edgeRow[3], edgeStep[3];
+	for (unsigned int e = 0; e < 3; e++)
+	{
+		edgeRow[e] = _mm_set1_ps(planes.m_StepY[e] * centerY + planes.m_Offset[e]);
+		edgeStep[e] = _mm_set1_ps(planes.m_StepX[e]);
+	}
+	__m128 depthRow = _mm_set1_ps(planes.m_DepthStepY * centerY + planes.m_DepthOffset);
+	__m128 depthStep = _mm_set1_ps(planes.m_DepthStepX);
+	__m128 zero = _mm_setzero_ps();
+	//minX is a multiple of 4 and so is the row width, the last register never runs past the row
+	for (int x = minX; x <= maxX; x += 4)
+	{
+		__m128 centerX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[0], centerX), edgeRow[0]), zero);
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[1], centerX), edgeRow[1]), zero));
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeStep[2], centerX), edgeRow[2]), zero));
+		if (!_mm_movemask_ps(inside))
+			continue;
+		__m128 stored = _mm_loadu_ps(row + x);
+		__m128 nearest = _mm_min_ps(stored, _mm_add_ps(_mm_mul_ps(depthStep, centerX), depthRow));
+		_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+	}
+}
+
+#endif
+
+void OcclusionCuller::buildPyramid()
+{
+	for (unsigned int l = 1; l < m_Levels.size(); l++)
+	{
+		const Level &source = m_Levels[l - 1];
+		Level &level = m_Levels[l];
+		for (unsigned int y = 0; y < level.m_Height; y++)
+		{
+			unsigned int y0 = 2 * y, y1 = std::min(2 * y + 1, source.m_Height - 1);
+			for (unsigned int x = 0; x < level.m_Width; x++)
+			{
+				unsigned int x0 = 2 * x, x1 = std::min(2 * x + 1, source.m_Width - 1);
+				level.m_Depth[y * level.m_Width + x] = std::max(
+					std::max(source.m_Depth[y0 * source.m_Width + x0], source.m_Depth[y0 * source.m_Width + x1]),
+					std::max(source.m_Depth[y1 * source.m_Width + x0], source.m_Depth[y1 * source.m_Width + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isOccluded(const glm::vec3 &min, const glm::vec3 &max)
+{
+	if (!m_Enabled)
+		return false;
+	m_Tested++;
+	glm::vec2 screenMin(std::numeric_limits<float>::max()), screenMax(-std::numeric_limits<float>::max());
+	float nearest = 1.0f;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+		glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+		if (clip.w <= NEAR_W)
+			return false;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		glm::vec2 screen((ndc.x + 1.0f) * 0.5f * m_Width, (ndc.y + 1.0f) * 0.5f * m_Height);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= m_Width || screenMin.y >= m_Height)
+		return false;
+	int x0 = std::max((int)std::floor(screenMin.x), 0);
+	int y0 = std::max((int)std::floor(screenMin.y), 0);
+	int x1 = std::min((int)std::floor(screenMax.x), (int)m_Width - 1);
+	int y1 = std::min((int)std::floor(screenMax.y), (int)m_Height - 1);
+
+	//the finest level where the box covers at most 2x2 texels
+	unsigned int l = 0;
+	while (l + 1 < m_Levels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1))
+		l++;
+	const Level &level = m_Levels[l];
+	for (int y = y0 >> l; y <= y1 >> l; y++)
+		for (int x = x0 >> l; x <= x1 >> l; x++)
+			if (level.m_Depth[y * level.m_Width + x] >= nearest)
+				return false;
+	m_Occluded++;
+	return true;
+}
+
+unsigned int OcclusionCuller::getWidth() const
+{
+	return m_Width;
+}
+
+unsigned int OcclusionCuller::getHeight() const
+{
+	return m_Height;
+}
+
+float OcclusionCuller::getDepth(unsigned int x, unsigned int y) const
+{
+	return m_Levels[0].m_Depth[y * m_Width + x];
+}
+
+unsigned int OcclusionCuller::getTriangles() const
+{
+	return m_Triangles.size();
+}
+
+unsigned int OcclusionCuller::getTested() const
+{
+	return m_Tested;
+}
+
+unsigned int OcclusionCuller::getOccluded() const
+{
+	return m_Occluded;
+}
\ No newline at end of file
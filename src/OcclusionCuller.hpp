@@ -0,0 +1,108 @@
+#pragma once
+#include "stdafx.h"
+#include "WorkerPool.hpp"
+#include "SimdDispatch.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Model;
+
+/**
+@brief Occlusion culling against a small depth buffer the occluders are rasterized into on the cpu
+@details The triangles of the occluder models are projected once per frame and rasterized in bands of rows spread over the WorkerPool,
+4 pixels at a time with SSE2 on x86 or one at a time with the scalar path, which covers the same pixels. Triangles crossing the near plane are dropped so the buffer only ever holds depths at or behind
+the real occluders. A max depth pyramid built on top of it lets a box be tested against a handful of texels: the box is hidden if its nearest
+depth is behind the farthest occluder depth everywhere it covers on screen. Needs no gpu
+*/
+class OcclusionCuller
+	: private WorkerJob
+{
+public:
+	static OcclusionCuller& get();
+
+	static const unsigned int BAND_ROWS = 16; //!< rows rasterized by a single pool index
+
+	/**@brief Size the depth buffer to @param width (rounded up to 4) by @param height pixels. 0 disables occlusion culling*/
+	void init(unsigned int width, unsigned int height);
+	bool isEnabled() const;
+
+	/**@brief Clear the depth buffer and take the camera of this frame*/
+	void beginFrame(const glm::mat4 &viewProjection);
+	/**@brief Project the triangles of @param model placed by @param modelMatrix for the next rasterize*/
+	void addOccluder(const Model *model, const glm::mat4 &modelMatrix);
+	/**@brief Same as above for a triangle list of @param numIndices @param indices into @param numVertices @param positions,
+		@param stride bytes apart. Needs no gpu side mesh*/
+	void addOccluder(const glm::vec3 *positions, unsigned int stride, unsigned int numVertices, const GLuint *indices, unsigned int numIndices,
+		const glm::mat4 &modelMatrix);
+	/**@brief Rasterize the occluders added since beginFrame and build the depth pyramid
+		@param parallel spread the bands over the WorkerPool. Only from the main thread and not from inside another pool job
+	*/
+	void rasterize(bool parallel = true);
+	/**@brief true if the world space box @param min @param max is entirely behind the occluders. Boxes crossing the near plane or off screen are never occluded*/
+	bool isOccluded(const glm::vec3 &min, const glm::vec3 &max);
+
+	unsigned int getWidth() const;
+	unsigned int getHeight() const;
+	/**@brief Depth in [0,1] of pixel @param x @param y after the last rasterize. Row 0 is the bottom of the screen*/
+	float getDepth(unsigned int x, unsigned int y) const;
+
+	/**@brief Rasterize with the path of @param level from now on. The widest one the cpu supports is picked at startup*/
+	void setSimdLevel(SimdLevel level);
+	/**@brief name of the selected raster path for logging*/
+	const std::string& getName() const;
+
+	unsigned int getTriangles() const; //!< triangles rasterized by the last rasterize
+	unsigned int getTested() const; //!< boxes tested since beginFrame
+	unsigned int getOccluded() const; //!< of those, the ones found hidden
+private:
+	OcclusionCuller();
+
+	/**@brief Rasterize band @param index of the current frame*/
+	virtual void execute(unsigned int index);
+	/**@brief Fill rows [@param rowBegin, @param rowEnd) with the nearest depth of every triangle*/
+	void rasterizeRows(unsigned int rowBegin, unsigned int rowEnd);
+	/**@brief Reduce the depth buffer into m_Levels*/
+	void buildPyramid();
+
+	/**@brief Edge functions and depth plane of a projected triangle over the screen. See rasterizeRows*/
+	struct TrianglePlanes
+	{
+		float m_StepX[3], m_StepY[3], m_Offset[3];
+		float m_DepthStepX, m_DepthStepY, m_DepthOffset;
+	};
+	/**@brief signature of the raster kernels. Keeps the nearest depth of the triangle in pixels [@param minX, @param maxX] of @param row.
+		@param minX is a multiple of 4*/
+	typedef void (*SpanFunction)(const TrianglePlanes &planes, float centerY, int minX, int maxX, float *row);
+	static void spanScalar(const TrianglePlanes &planes, float centerY, int minX, int maxX, float *row);
+	//only on x86, see SIMD_X86
+	static void spanSSE2(const TrianglePlanes &planes, float centerY, int minX, int maxX, float *row);
+
+	/**@brief A projected triangle. x and y in pixels, z the depth in [0,1]. Counter clockwise on screen*/
+	struct Triangle
+	{
+		glm::vec3 m_Vertices[3];
+		float m_MinY, m_MaxY;
+	};
+
+	/**@brief A level of the max depth pyramid. Level 0 is the depth buffer itself*/
+	struct Level
+	{
+		unsigned int m_Width;
+		unsigned int m_Height;
+		std::vector<float> m_Depth;
+	};
+
+	bool m_Enabled;
+	unsigned int m_Width; //!< a multiple of 4 so a row is whole registers
+	unsigned int m_Height;
+	glm::mat4 m_ViewProjection;
+	std::vector<Triangle> m_Triangles;
+	std::vector<glm::vec4> m_Clip; //!< scratch for the clip space vertices of an occluder mesh
+	std::vector<Level> m_Levels;
+	SpanFunction m_RasterizeSpan;
+	std::string m_Name;
+
+	unsigned int m_Tested;
+	unsigned int m_Occluded;
+};
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "PoseCache.hpp"
+
+#include <cmath>
+
+//starting size of the table. has to be a power of 2
+static const unsigned int INITIAL_TABLE_SIZE = 256;
+
+PoseCache& PoseCache::get()
+{
+	static PoseCache singleton;
+	return singleton;
+}
+
+PoseCache::PoseCache()
+	:m_Step(0), m_Frame(1), m_NumEntries(0), m_Hits(0), m_Misses(0)
+{
+	Entry empty;
+	empty.m_Model = NULL;
+	empty.m_AnimId = 0;
+	empty.m_Bucket = 0;
+	empty.m_Storage = AnimStorage::SPARSE;
+	empty.m_Frame = 0;
+	empty.m_Pose = 0;
+	m_Table.assign(INITIAL_TABLE_SIZE, empty);
+}
+
+void PoseCache::setStep(double step)
+{
+	m_Step = step > 0 ? step : 0;
+	newFrame();
+}
+
+double PoseCache::getStep() const
+{
+	return m_Step;
+}
+
+void PoseCache::newFrame()
+{
+	m_Frame++;
+	m_NumEntries = 0;
+	m_Hits = 0;
+	m_Misses = 0;
+}
+
+unsigned int PoseCache::hash(const SkinnedModel *model, unsigned int animId, long long bucket, AnimStorage storage) const
+{
+	size_t h = reinterpret_cast<size_t>(model) / sizeof(void*);
+	h = h * 31 + animId;
+	h = h * 31 + (size_t)bucket;
+	h = h * 31 + (size_t)storage;
+	//spread the bits before masking
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	return (unsigned int)(h & (m_Table.size() - 1));
+}
+
+const PoseBuffer& PoseCache::getPose(const SkinnedModel *model, const Animation *anim, double time, AnimStorage storage, AnimCursor *cursor)
+{
+	if(m_Step <= 0)
+	{
+		anim->getTransforms(time, m_Uncached, cursor, storage);
+		m_Misses++;
+		return m_Uncached;
+	}
+
+	long long bucket = (long long)floor(time / m_Step);
+	unsigned int slot = hash(model, anim->m_Id, bucket, storage);
+	//linear probing until an entry of this frame matches or an empty one is found
+	while(m_Table[slot].m_Frame == m_Frame)
+	{
+		const Entry &entry = m_Table[slot];
+		if(entry.m_Model == model && entry.m_AnimId == anim->m_Id && entry.m_Bucket == bucket && entry.m_Storage == storage)
+		{
+			m_Hits++;
+			return m_Poses[entry.m_Pose];
+		}
+		slot = (slot + 1) & (m_Table.size() - 1);
+	}
+
+	m_Misses++;
+	if(m_NumEntries >= m_Poses.size())
+		m_Poses.push_back(PoseBuffer());
+	PoseBuffer &pose = m_Poses[m_NumEntries];
+	//sample at the start of the bucket so whoever comes first does not decide the pose
+	anim->getTransforms(bucket * m_Step, pose, cursor, storage);
+
+	Entry &entry = m_Table[slot];
+	entry.m_Model = model;
+	entry.m_AnimId = anim->m_Id;
+	entry.m_Bucket = bucket;
+	entry.m_Storage = storage;
+	entry.m_Frame = m_Frame;
+	entry.m_Pose = m_NumEntries;
+	m_NumEntries++;
+
+	//keep the load under a half so probing stays short
+	if(m_NumEntries * 2 > m_Table.size())
+		grow();
+	return pose;
+}
+
+void PoseCache::grow()
+{
+	std::vector<Entry> oldTable;
+	oldTable.swap(m_Table);
+	Entry empty = oldTable[0];
+	empty.m_Frame = 0;
+	m_Table.assign(oldTable.size() * 2, empty);
+	for(unsigned int i = 0; i < oldTable.size(); i++)
+	{
+		const Entry &entry = oldTable[i];
+		if(entry.m_Frame != m_Frame)
+			continue;
+		unsigned int slot = hash(entry.m_Model, entry.m_AnimId, entry.m_Bucket, entry.m_Storage);
+		while(m_Table[slot].m_Frame == m_Frame)
+			slot = (slot + 1) & (m_Table.size() - 1);
+		m_Table[slot] = entry;
+	}
+}
+
+unsigned int PoseCache::getHits() const
+{
+	return m_Hits;
+}
+
+unsigned int PoseCache::getMisses() const
+{
+	return m_Misses;
+}
\ No newline at end of file
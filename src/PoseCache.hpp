@@ -0,0 +1,62 @@
+#pragma once
+#include "stdafx.h"
+#include "PoseKernel.hpp"
+#include "Animation.hpp"
+
+#include <deque>
+
+class SkinnedModel;
+
+/**
+@brief Shares sampled local poses between instances playing the same animation at (nearly) the same time
+@details Poses are keyed by (SkinnedModel, Animation id, quantized time, storage). The clip time is snapped down to a multiple of the step
+so every instance landing in the same bucket gets the exact same pose and only the first one pays for sampling it.
+The cache only lives for a single frame: newFrame invalidates every entry in O(1) and the pose buffers are recycled so steady state
+does not allocate. A step of 0 turns the sharing off and every request is sampled at its exact time
+*/
+class PoseCache
+{
+public:
+	static PoseCache& get();
+
+	/**@brief Sets the width of a time bucket in seconds*/
+	void setStep(double step);
+	double getStep() const;
+
+	/**@brief Invalidate every cached pose and zero the counters. Called once at the start of the frame*/
+	void newFrame();
+
+	/**@brief Get the pose of @param anim at @param time, sampling it only if no other instance asked for the same bucket this frame.
+		@param cursor the key cursor of the calling instance. Only used on a miss
+		@return valid until the next newFrame
+	*/
+	const PoseBuffer& getPose(const SkinnedModel *model, const Animation *anim, double time, AnimStorage storage, AnimCursor *cursor);
+
+	unsigned int getHits() const; //!< hits since the last newFrame
+	unsigned int getMisses() const; //!< misses since the last newFrame
+private:
+	PoseCache();
+
+	struct Entry
+	{
+		const SkinnedModel *m_Model;
+		unsigned int m_AnimId;
+		long long m_Bucket;
+		AnimStorage m_Storage;
+		unsigned int m_Frame; //!< entries from an older frame count as empty
+		unsigned int m_Pose; //!< index into m_Poses
+	};
+
+	/**@brief Double the table and put this frame's entries back in*/
+	void grow();
+	unsigned int hash(const SkinnedModel *model, unsigned int animId, long long bucket, AnimStorage storage) const;
+
+	double m_Step;
+	unsigned int m_Frame;
+	std::vector<Entry> m_Table; //!< open addressing. size is a power of 2
+	unsigned int m_NumEntries; //!< entries in the current frame
+	std::deque<PoseBuffer> m_Poses; //!< recycled every frame. deque so handed out references survive it growing
+	unsigned int m_Hits;
+	unsigned int m_Misses;
+	PoseBuffer m_Uncached; //!< used when the step is 0
+};
\ No newline at end of file
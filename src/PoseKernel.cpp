@@ -0,0 +1,264 @@
+#include "PoseKernel.hpp"
+#include "SimdDispatch.hpp"
+
+#include <cmath>
+
+using std::string;
+
+PoseBuffer::PoseBuffer()
+	:m_NumBones(0), m_Stride(0)
+{
+
+}
+
+unsigned int PoseBuffer::getStride(unsigned int numBones)
+{
+	return (numBones + POSE_BONE_ALIGNMENT - 1) / POSE_BONE_ALIGNMENT * POSE_BONE_ALIGNMENT;
+}
+
+void PoseBuffer::resize(unsigned int numBones)
+{
+	if(numBones == m_NumBones && m_Data.size())
+		return;
+	m_NumBones = numBones;
+	m_Stride = getStride(numBones);
+	m_Data.assign(NUM_COMPONENTS * m_Stride, 0.0f);
+	//identity so the padding never produces garbage
+	for(unsigned int i = 0; i < m_Stride; i++)
+	{
+		getComponent(SCALE_X)[i] = 1.0f;
+		getComponent(SCALE_Y)[i] = 1.0f;
+		getComponent(SCALE_Z)[i] = 1.0f;
+		getComponent(ROTATION_W)[i] = 1.0f;
+	}
+}
+
+void PoseBuffer::setBone(unsigned int bone, const SQTTransform &transform)
+{
+	glm::vec3 scale = transform.getScale();
+	glm::vec3 position = transform.getPosition();
+	glm::quat rotation = transform.getOrientation();
+	float *data = &m_Data[bone];
+	data[SCALE_X * m_Stride] = scale.x;
+	data[SCALE_Y * m_Stride] = scale.y;
+	data[SCALE_Z * m_Stride] = scale.z;
+	data[POSITION_X * m_Stride] = position.x;
+	data[POSITION_Y * m_Stride] = position.y;
+	data[POSITION_Z * m_Stride] = position.z;
+	data[ROTATION_X * m_Stride] = rotation.x;
+	data[ROTATION_Y * m_Stride] = rotation.y;
+	data[ROTATION_Z * m_Stride] = rotation.z;
+	data[ROTATION_W * m_Stride] = rotation.w;
+}
+
+SQTTransform PoseBuffer::getBone(unsigned int bone) const
+{
+	const float *data = &m_Data[bone];
+	return SQTTransform(glm::vec3(data[POSITION_X * m_Stride], data[POSITION_Y * m_Stride], data[POSITION_Z * m_Stride]),
+		glm::vec3(data[SCALE_X * m_Stride], data[SCALE_Y * m_Stride], data[SCALE_Z * m_Stride]),
+		glm::quat(data[ROTATION_W * m_Stride], data[ROTATION_X * m_Stride], data[ROTATION_Y * m_Stride], data[ROTATION_Z * m_Stride]));
+}
+
+void PoseBuffer::load(const BoneArray<SQTTransform> &transforms)
+{
+	resize(transforms.size());
+	for(unsigned int i = 0; i < m_NumBones; i++)
+		setBone(i, transforms[i]);
+}
+
+void PoseBuffer::store(BoneArray<SQTTransform> &transforms) const
+{
+	transforms.resize(m_NumBones);
+	for(unsigned int i = 0; i < m_NumBones; i++)
+		transforms[i] = getBone(i);
+}
+
+float* PoseBuffer::getComponent(Component component)
+{
+	return &m_Data[component * m_Stride];
+}
+
+const float* PoseBuffer::getComponent(Component component) const
+{
+	return &m_Data[component * m_Stride];
+}
+
+PoseKernel& PoseKernel::get()
+{
+	static PoseKernel singleton;
+	return singleton;
+}
+
+PoseKernel::PoseKernel()
+{
+	m_Blend = selectSimdPath("pose", SIMD_PATHS(&PoseKernel::blendScalar, &PoseKernel::blendSSE2, &PoseKernel::blendAVX2), m_Name);
+}
+
+void PoseKernel::blend(const PoseBuffer &from, const PoseBuffer &to, float factor, PoseBuffer &result) const
+{
+	result.resize(from.m_NumBones);
+	m_Blend(&from.m_Data[0], &to.m_Data[0], factor, &result.m_Data[0], from.m_Stride);
+}
+
+void PoseKernel::blend(const float *from, const float *to, float factor, float *result, unsigned int stride) const
+{
+	m_Blend(from, to, factor, result, stride);
+}
+
+const string& PoseKernel::getName() const
+{
+	return m_Name;
+}
+
+/**@brief Moves the nlerp factor so the result follows slerp closely. @param cosAngle is the absolute dot product of the two rotations.
+	see http://zeuxcg.org/2015/07/23/approximating-slerp/
+*/
+static float correctFactor(float cosAngle, float factor)
+{
+	float a = 1.0904f + cosAngle * (-3.2452f + cosAngle * (3.55645f - cosAngle * 1.43519f));
+	float b = 0.848013f + cosAngle * (-1.06021f + cosAngle * 0.215638f);
+	float k = a * (factor - 0.5f) * (factor - 0.5f) + b;
+	return factor + factor * (factor - 0.5f) * (factor - 1.0f) * k;
+}
+
+void PoseKernel::blendScalar(const float *from, const float *to, float factor, float *result, unsigned int stride)
+{
+	//scale and position are the first six components
+	for(unsigned int i = 0; i < PoseBuffer::ROTATION_X * stride; i++)
+		result[i] = from[i] + (to[i] - from[i]) * factor;
+
+	const float *fromRotation = from + PoseBuffer::ROTATION_X * stride;
+	const float *toRotation = to + PoseBuffer::ROTATION_X * stride;
+	float *resultRotation = result + PoseBuffer::ROTATION_X * stride;
+	for(unsigned int i = 0; i < stride; i++)
+	{
+		float dot = 0;
+		for(unsigned int c = 0; c < 4; c++)
+			dot += fromRotation[c * stride + i] * toRotation[c * stride + i];
+		//take the shortest path
+		float sign = dot < 0 ? -1.0f : 1.0f;
+		float t = correctFactor(fabs(dot), factor);
+		float length = 0;
+		for(unsigned int c = 0; c < 4; c++)
+		{
+			float value = fromRotation[c * stride + i] + (toRotation[c * stride + i] * sign - fromRotation[c * stride + i]) * t;
+			resultRotation[c * stride + i] = value;
+			length += value * value;
+		}
+		float inverseLength = 1.0f / sqrt(length);
+		for(unsigned int c = 0; c < 4; c++)
+			resultRotation[c * stride + i] *= inverseLength;
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2 void PoseKernel::blendSSE2(const float *from, const float *to, float factor, float *result, unsigned int stride)
+{
+	const __m128 t = _mm_set1_ps(factor);
+	for(unsigned int i = 0; i < PoseBuffer::ROTATION_X * stride; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(from + i);
+		__m128 b = _mm_loadu_ps(to + i);
+		_mm_storeu_ps(result + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)));
+	}
+
+	const float *fromRotation = from + PoseBuffer::ROTATION_X * stride;
+	const float *toRotation = to + PoseBuffer::ROTATION_X * stride;
+	float *resultRotation = result + PoseBuffer::ROTATION_X * stride;
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	for(unsigned int i = 0; i < stride; i += 4)
+	{
+		__m128 a[4], b[4];
+		for(unsigned int c = 0; c < 4; c++)
+		{
+			a[c] = _mm_loadu_ps(fromRotation + c * stride + i);
+			b[c] = _mm_loadu_ps(toRotation + c * stride + i);
+		}
+		__m128 dot = _mm_mul_ps(a[0], b[0]);
+		for(unsigned int c = 1; c < 4; c++)
+			dot = _mm_add_ps(dot, _mm_mul_ps(a[c], b[c]));
+		//flip the target rotation where the dot product is negative by xoring in its sign bit
+		__m128 sign = _mm_and_ps(dot, signMask);
+		__m128 cosAngle = _mm_andnot_ps(signMask, dot);
+
+		//correctFactor four lanes at a time
+		__m128 ka = _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(cosAngle, _mm_set1_ps(1.43519f)));
+		ka = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(cosAngle, ka));
+		ka = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(cosAngle, ka));
+		__m128 kb = _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(cosAngle, _mm_set1_ps(0.215638f)));
+		kb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(cosAngle, kb));
+		__m128 tHalf = _mm_sub_ps(t, half);
+		__m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ka, tHalf), tHalf), kb);
+		__m128 correctedT = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, tHalf), _mm_sub_ps(t, one)), k));
+
+		__m128 value[4];
+		__m128 length = _mm_setzero_ps();
+		for(unsigned int c = 0; c < 4; c++)
+		{
+			__m128 target = _mm_xor_ps(b[c], sign);
+			value[c] = _mm_add_ps(a[c], _mm_mul_ps(_mm_sub_ps(target, a[c]), correctedT));
+			length = _mm_add_ps(length, _mm_mul_ps(value[c], value[c]));
+		}
+		__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(length));
+		for(unsigned int c = 0; c < 4; c++)
+			_mm_storeu_ps(resultRotation + c * stride + i, _mm_mul_ps(value[c], inverseLength));
+	}
+}
+
+SIMD_TARGET_AVX2 void PoseKernel::blendAVX2(const float *from, const float *to, float factor, float *result, unsigned int stride)
+{
+	const __m256 t = _mm256_set1_ps(factor);
+	for(unsigned int i = 0; i < PoseBuffer::ROTATION_X * stride; i += 8)
+	{
+		__m256 a = _mm256_loadu_ps(from + i);
+		__m256 b = _mm256_loadu_ps(to + i);
+		_mm256_storeu_ps(result + i, _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a));
+	}
+
+	const float *fromRotation = from + PoseBuffer::ROTATION_X * stride;
+	const float *toRotation = to + PoseBuffer::ROTATION_X * stride;
+	float *resultRotation = result + PoseBuffer::ROTATION_X * stride;
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	for(unsigned int i = 0; i < stride; i += 8)
+	{
+		__m256 a[4], b[4];
+		for(unsigned int c = 0; c < 4; c++)
+		{
+			a[c] = _mm256_loadu_ps(fromRotation + c * stride + i);
+			b[c] = _mm256_loadu_ps(toRotation + c * stride + i);
+		}
+		__m256 dot = _mm256_mul_ps(a[0], b[0]);
+		for(unsigned int c = 1; c < 4; c++)
+			dot = _mm256_fmadd_ps(a[c], b[c], dot);
+		__m256 sign = _mm256_and_ps(dot, signMask);
+		__m256 cosAngle = _mm256_andnot_ps(signMask, dot);
+
+		__m256 ka = _mm256_fnmadd_ps(cosAngle, _mm256_set1_ps(1.43519f), _mm256_set1_ps(3.55645f));
+		ka = _mm256_fmadd_ps(cosAngle, ka, _mm256_set1_ps(-3.2452f));
+		ka = _mm256_fmadd_ps(cosAngle, ka, _mm256_set1_ps(1.0904f));
+		__m256 kb = _mm256_fmadd_ps(cosAngle, _mm256_set1_ps(0.215638f), _mm256_set1_ps(-1.06021f));
+		kb = _mm256_fmadd_ps(cosAngle, kb, _mm256_set1_ps(0.848013f));
+		__m256 tHalf = _mm256_sub_ps(t, half);
+		__m256 k = _mm256_fmadd_ps(_mm256_mul_ps(ka, tHalf), tHalf, kb);
+		__m256 correctedT = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_mul_ps(t, tHalf), _mm256_sub_ps(t, one)), k, t);
+
+		__m256 value[4];
+		__m256 length = _mm256_setzero_ps();
+		for(unsigned int c = 0; c < 4; c++)
+		{
+			__m256 target = _mm256_xor_ps(b[c], sign);
+			value[c] = _mm256_fmadd_ps(_mm256_sub_ps(target, a[c]), correctedT, a[c]);
+			length = _mm256_fmadd_ps(value[c], value[c], length);
+		}
+		__m256 inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(length));
+		for(unsigned int c = 0; c < 4; c++)
+			_mm256_storeu_ps(resultRotation + c * stride + i, _mm256_mul_ps(value[c], inverseLength));
+	}
+}
+
+#endif
\ No newline at end of file
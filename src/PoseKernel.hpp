@@ -0,0 +1,71 @@
+#pragma once
+#include "stdafx.h"
+#include "SQTTransform.hpp"
+#include "BoneArray.hpp"
+
+static const unsigned int POSE_BONE_ALIGNMENT = 8; //!< widest kernel processes 8 bones at a time
+
+/**
+@brief Structure of arrays pose of a skeleton
+@details Every component (scale x, position y, rotation w...) of every bone has its own array so the blend kernels can work on 4 or 8 bones
+at a time. The arrays are padded to a multiple of POSE_BONE_ALIGNMENT bones and the padding holds identity transforms so the kernels never
+have to deal with a remainder. All the arrays live in a single allocation one after the other, @link m_Stride floats apart
+*/
+struct PoseBuffer
+{
+	enum Component{ SCALE_X, SCALE_Y, SCALE_Z, POSITION_X, POSITION_Y, POSITION_Z, ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W, NUM_COMPONENTS };
+
+	PoseBuffer();
+	/**@brief Size the buffer for @param numBones and set every bone to identity. Does nothing if it already has that size*/
+	void resize(unsigned int numBones);
+
+	void setBone(unsigned int bone, const SQTTransform &transform);
+	SQTTransform getBone(unsigned int bone) const;
+
+	/**@brief Copy the bones of @param transforms in. Resizes to fit*/
+	void load(const BoneArray<SQTTransform> &transforms);
+	/**@brief Copy every bone out to @param transforms. Resizes to fit*/
+	void store(BoneArray<SQTTransform> &transforms) const;
+
+	float* getComponent(Component component);
+	const float* getComponent(Component component) const;
+
+	/**@brief The number of floats between two components for @param numBones. This is the bone count rounded up to the kernel width*/
+	static unsigned int getStride(unsigned int numBones);
+
+	unsigned int m_NumBones;
+	unsigned int m_Stride;
+	std::vector<float> m_Data;
+};
+
+/**
+@brief Blends whole poses with SIMD
+@details Scales and positions are lerped, rotations nlerped along the shortest path with a corrected blend factor which keeps it within
+0.002 radians of slerp. The AVX2 (8 bones), SSE2 (4 bones) and scalar paths run the exact same arithmetic and agree to within 1e-5.
+The widest path the cpu supports is picked once at startup
+*/
+class PoseKernel
+{
+public:
+	/**@brief signature of the blend kernels. @param stride floats between two components which is also the number of bones processed*/
+	typedef void (*BlendFunction)(const float *from, const float *to, float factor, float *result, unsigned int stride);
+
+	static PoseKernel& get();
+
+	/**@brief result = blend of @param from and @param to. @param factor 0 gives from, 1 gives to. The poses must have the same size*/
+	void blend(const PoseBuffer &from, const PoseBuffer &to, float factor, PoseBuffer &result) const;
+	/**@brief Same as above on raw structure of arrays poses laid out like PoseBuffer*/
+	void blend(const float *from, const float *to, float factor, float *result, unsigned int stride) const;
+
+	/**@brief name of the selected path for logging*/
+	const std::string& getName() const;
+
+	static void blendScalar(const float *from, const float *to, float factor, float *result, unsigned int stride);
+	//only on x86, see SIMD_X86
+	static void blendSSE2(const float *from, const float *to, float factor, float *result, unsigned int stride);
+	static void blendAVX2(const float *from, const float *to, float factor, float *result, unsigned int stride);
+private:
+	PoseKernel();
+	BlendFunction m_Blend;
+	std::string m_Name;
+};
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "RenderQueue.hpp"
+#include "Model.hpp"
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using std::vector;
+
+static const unsigned int SHADER_BITS = 12;
+static const unsigned int TEXTURE_BITS = 16;
+static const unsigned int MESH_BITS = 16;
+static const unsigned int LOD_BITS = 2;
+static const unsigned int DEPTH_BITS = 18;
+
+RenderQueue& RenderQueue::get()
+{
+	static RenderQueue singleton;
+	return singleton;
+}
+
+RenderQueue::RenderQueue()
+	:m_FarDepth(1000.0f), m_NextMesh(1), m_Draws(0), m_DrawnInstances(0), m_StateChanges(0), m_SkippedBinds(0),
+	m_Overflows(0), m_OverflowLogged(false)
+{
+	static_assert(Mesh::MAX_LODS <= (1 << LOD_BITS), "the level of detail has to fit in the sort key");
+	std::fill(m_LodTriangles, m_LodTriangles + Mesh::MAX_LODS, 0);
+}
+
+void RenderQueue::init(unsigned int capacity)
+{
+	m_Ring.init(capacity * sizeof(InstanceData), "Instance");
+}
+
+void RenderQueue::beginFrame(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix)
+{
+	m_Ring.beginFrame();
+	m_Items.clear();
+	m_Order.clear();
+	m_Overflows = 0;
+	m_ViewMatrix = viewMatrix;
+	//the far plane of a perspective projection. Keeps the last value for anything else
+	float denominator = projMatrix[2][2] + 1.0f;
+	if (std::abs(denominator) > 1e-6f && projMatrix[3][2] / denominator > 0.0f)
+		m_FarDepth = projMatrix[3][2] / denominator;
+}
+
+void RenderQueue::registerMesh(Mesh *mesh)
+{
+	mesh->m_MeshKey = m_NextMesh++;
+	vector<GLuint> textures(mesh->m_Textures.size());
+	for (unsigned int i = 0; i < textures.size(); i++)
+		textures[i] = mesh->m_Textures[i].m_Id;
+	std::map<vector<GLuint>, unsigned int>::iterator it = m_TextureSets.find(textures);
+	if (it == m_TextureSets.end())
+		it = m_TextureSets.insert(std::make_pair(textures, (unsigned int)m_TextureSets.size() + 1)).first;
+	mesh->m_TextureKey = it->second;
+}
+
+std::uint64_t RenderQueue::getDepthKey(const glm::mat4 &modelMatrix) const
+{
+	//distance along the view direction of the model origin. Behind the camera counts as nearest
+	float depth = -(m_ViewMatrix * modelMatrix[3]).z;
+	depth = glm::clamp(depth / m_FarDepth, 0.0f, 1.0f);
+	return static_cast<std::uint64_t>(depth * ((1 << DEPTH_BITS) - 1));
+}
+
+void RenderQueue::push(Mesh *mesh, const ShaderProgram *shader, std::uint64_t depthKey, const glm::mat4 &modelMatrix, unsigned int paletteBase, unsigned int lod)
+{
+	if (!mesh->m_MeshKey)
+		registerMesh(mesh);
+	lod = std::min(lod, mesh->getLodCount() - 1);
+
+	//the mesh field is a per mesh id, not a material id: meshes sharing a material still sort apart, but the draws of one mesh
+	//end up next to each other and can be instanced
+	std::uint64_t key = static_cast<std::uint64_t>(shader->m_Id & ((1 << SHADER_BITS) - 1)) << (TEXTURE_BITS + MESH_BITS + LOD_BITS + DEPTH_BITS);
+	key |= static_cast<std::uint64_t>(mesh->m_TextureKey & ((1 << TEXTURE_BITS) - 1)) << (MESH_BITS + LOD_BITS + DEPTH_BITS);
+	key |= static_cast<std::uint64_t>(mesh->m_MeshKey & ((1 << MESH_BITS) - 1)) << (LOD_BITS + DEPTH_BITS);
+	key |= static_cast<std::uint64_t>(lod) << DEPTH_BITS;
+	key |= depthKey;
+	m_Order.push_back(SortEntry(key, m_Items.size()));
+
+	DrawItem item;
+	item.m_Mesh = mesh;
+	item.m_Shader = shader;
+	item.m_ModelMatrix = modelMatrix;
+	item.m_PaletteBase = paletteBase;
+	item.m_Lod = lod;
+	m_Items.push_back(item);
+}
+
+void RenderQueue::submit(const Model *model, const glm::mat4 &modelMatrix, unsigned int paletteBase, unsigned int lod)
+{
+	const ShaderProgram *shader = model->getShaderProgram();
+	std::uint64_t depthKey = getDepthKey(modelMatrix);
+	for (unsigned int i = 0; i < model->m_Meshes.size(); i++)
+		push(model->m_Meshes[i], shader, depthKey, modelMatrix, paletteBase, lod);
+}
+
+void RenderQueue::submit(Mesh *mesh, const ShaderProgram *shader, const glm::mat4 &modelMatrix)
+{
+	push(mesh, shader, getDepthKey(modelMatrix), modelMatrix, 0, 0);
+}
+
+bool RenderQueue::bindInstances(const InstanceData *instances, unsigned int count)
+{
+	GLsizeiptr bytes = count * sizeof(InstanceData);
+	GLintptr offset;
+	unsigned char *dest = m_Ring.allocate(bytes, m_Ring.getOffsetAlignment(), offset);
+	if (!dest)
+	{
+		m_Overflows += count;
+		return false;
+	}
+	memcpy(dest, instances, bytes);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, m_Ring.getBuffer(), m_Ring.getRegionOffset() + offset, bytes);
+	return true;
+}
+
+void RenderQueue::drawImmediate(const Mesh *mesh, const ShaderProgram *shader, const glm::mat4 &modelMatrix, GLenum mode, bool drawElements)
+{
+	InstanceData instance;
+	instance.m_Model = modelMatrix;
+	instance.m_Palette[0] = instance.m_Palette[1] = instance.m_Palette[2] = instance.m_Palette[3] = 0;
+	if (!bindInstances(&instance, 1))
+		return;
+	glUseProgram(shader->m_Id);
+	mesh->render(shader, mode, drawElements);
+}
+
+void RenderQueue::flush()
+{
+	m_Draws = m_DrawnInstances = m_StateChanges = m_SkippedBinds = 0;
+	std::fill(m_LodTriangles, m_LodTriangles + Mesh::MAX_LODS, 0);
+	std::sort(m_Order.begin(), m_Order.end());
+
+	//what the previous draw left bound. Immediate draws before the flush may have changed anything so nothing is assumed at the start
+	GLuint currProgram = 0;
+	const Mesh *currMesh = nullptr;
+	const Mesh *currMaterial = nullptr; //the mesh whose material uniforms are in place
+	GLuint boundTextures[MAX_TEXTURE_UNITS] = { 0 };
+
+	for (unsigned int i = 0; i < m_Order.size();)
+	{
+		const DrawItem &item = m_Items[m_Order[i].second];
+		GLuint program = item.m_Shader->m_Id;
+		const Mesh *mesh = item.m_Mesh;
+		unsigned int lod = item.m_Lod;
+
+		//every following draw of the same mesh, level of detail and program becomes an instance of this one
+		m_Instances.clear();
+		for (; i < m_Order.size(); i++)
+		{
+			const DrawItem &instanceItem = m_Items[m_Order[i].second];
+			if (instanceItem.m_Mesh != mesh || instanceItem.m_Lod != lod || instanceItem.m_Shader->m_Id != program)
+				break;
+			InstanceData instance;
+			instance.m_Model = instanceItem.m_ModelMatrix;
+			instance.m_Palette[0] = instanceItem.m_PaletteBase;
+			instance.m_Palette[1] = instance.m_Palette[2] = instance.m_Palette[3] = 0;
+			m_Instances.push_back(instance);
+		}
+		if (!bindInstances(m_Instances.data(), m_Instances.size()))
+			continue;
+		m_StateChanges++;
+
+		if (program != currProgram)
+		{
+			glUseProgram(program);
+			currProgram = program;
+			//the material uniforms belong to the program too
+			currMesh = nullptr;
+			currMaterial = nullptr;
+			m_StateChanges++;
+		}
+		else
+			m_SkippedBinds++;
+
+		if (mesh != currMesh)
+		{
+			glBindVertexArray(mesh->getVAO());
+			m_StateChanges++;
+			//meshes sharing a material leave the uniforms of the last one in place
+			if (currMaterial && mesh->hasSameMaterial(*currMaterial))
+				m_SkippedBinds++;
+			else
+			{
+				mesh->applyMaterial();
+				currMaterial = mesh;
+				m_StateChanges++;
+			}
+			for (unsigned int t = 0; t < mesh->m_Textures.size(); t++)
+			{
+				GLuint texture = mesh->m_Textures[t].m_Id;
+				if (t < MAX_TEXTURE_UNITS && boundTextures[t] == texture)
+				{
+					m_SkippedBinds++;
+					continue;
+				}
+				glActiveTexture(GL_TEXTURE0 + t);
+				glBindTexture(GL_TEXTURE_2D, texture);
+				if (t < MAX_TEXTURE_UNITS)
+					boundTextures[t] = texture;
+				m_StateChanges++;
+			}
+			currMesh = mesh;
+		}
+		else
+			m_SkippedBinds += 2 + mesh->m_Textures.size();
+
+		mesh->draw(GL_TRIANGLES, true, m_Instances.size(), lod);
+		m_Draws++;
+		m_DrawnInstances += m_Instances.size();
+		m_LodTriangles[lod] += mesh->getTriangles(lod) * m_Instances.size();
+	}
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+	m_Ring.endFrame();
+	if (m_Overflows && !m_OverflowLogged)
+	{
+		m_OverflowLogged = true;
+		LOG(WARN) << m_Overflows << " instances did not fit in the ring. Raise renderQueue.instanceCapacity";
+	}
+}
+
+unsigned int RenderQueue::getDraws() const
+{
+	return m_Draws;
+}
+
+unsigned int RenderQueue::getInstances() const
+{
+	return m_DrawnInstances;
+}
+
+unsigned int RenderQueue::getStateChanges() const
+{
+	return m_StateChanges;
+}
+
+unsigned int RenderQueue::getSkippedBinds() const
+{
+	return m_SkippedBinds;
+}
+
+unsigned int RenderQueue::getTriangles(unsigned int lod) const
+{
+	return lod < Mesh::MAX_LODS ? m_LodTriangles[lod] : 0;
+}
\ No newline at end of file
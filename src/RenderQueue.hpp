@@ -0,0 +1,100 @@
+#pragma once
+#include "stdafx.h"
+#include "StreamBuffer.hpp"
+#include "Mesh.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+
+class Model;
+struct ShaderProgram;
+
+/**
+@brief Collects the mesh draws of a frame and issues them sorted so consecutive draws share as much gpu state as possible
+@details Every draw gets a 64 bit key: shader (12 bits) | texture set (16) | mesh id (16) | level of detail (2) | view depth (18), most significant first.
+Sorting on it groups the draws by program, then by the textures they bind, then by mesh and level of detail, and draws each group front to back.
+Consecutive draws of the same mesh and level of detail are merged into a single instanced draw whose model matrices and palette bases are written
+to a StreamBuffer bound at INSTANCE_BINDING, so the draw count follows the number of distinct meshes and not the number of objects.
+While issuing, the program, VAO, texture and material uploads are skipped when they are already in place.
+Immediate draws (bounding boxes, curves) go through drawImmediate and may only happen between beginFrame and flush
+*/
+class RenderQueue
+{
+public:
+	static RenderQueue& get();
+
+	static const GLuint INSTANCE_BINDING = 1; //!< the shader storage binding of the Instances block in the vertex shaders
+
+	/**@brief Layout of an entry of the Instances block*/
+	struct InstanceData
+	{
+		glm::mat4 m_Model;
+		GLuint m_Palette[4]; //!< x is the first bone of the instance in the BonePalette block. The rest pads to 16 bytes
+	};
+
+	/**@brief Create the instance ring. @param capacity is the number of instances a single frame may draw*/
+	void init(unsigned int capacity);
+
+	/**@brief Forget the draws of the last frame and take the camera of this one*/
+	void beginFrame(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+	/**@brief Queue every mesh of @param model with @param modelMatrix. @param paletteBase is the first bone of the instance as returned by BonePalette::write.
+		@param lod is the level of detail the meshes are drawn with*/
+	void submit(const Model *model, const glm::mat4 &modelMatrix, unsigned int paletteBase = 0, unsigned int lod = 0);
+	/**@brief Queue a single @param mesh drawn with @param shader. The mesh needs an index buffer*/
+	void submit(Mesh *mesh, const ShaderProgram *shader, const glm::mat4 &modelMatrix);
+	/**@brief Sort and issue the queued draws*/
+	void flush();
+
+	/**@brief Draw @param mesh with @param shader right away as a single instance. For debug geometry that is drawn in modes other than triangles*/
+	void drawImmediate(const Mesh *mesh, const ShaderProgram *shader, const glm::mat4 &modelMatrix, GLenum mode, bool drawElements);
+
+	/**@brief Write @param count instances to the ring and bind them at INSTANCE_BINDING. Returns false if they do not fit.
+		For batches that draw on their own, like StaticBatch*/
+	bool bindInstances(const InstanceData *instances, unsigned int count);
+
+	unsigned int getDraws() const; //!< instanced draws issued by the last flush
+	unsigned int getInstances() const; //!< instances drawn by the last flush
+	unsigned int getStateChanges() const; //!< program, instance, VAO, texture and material uploads made by the last flush
+	unsigned int getSkippedBinds() const; //!< of those, the ones the last flush left out as the state was already in place
+	/**@brief Triangles the last flush drew with level of detail @param lod, below Mesh::MAX_LODS*/
+	unsigned int getTriangles(unsigned int lod) const;
+private:
+	RenderQueue();
+
+	/**@brief Give @param mesh its mesh and texture set ids the first time it is seen*/
+	void registerMesh(Mesh *mesh);
+	/**@brief Queue @param mesh with the sort key of @param shader, @param lod and @param depthKey*/
+	void push(Mesh *mesh, const ShaderProgram *shader, std::uint64_t depthKey, const glm::mat4 &modelMatrix, unsigned int paletteBase, unsigned int lod);
+	/**@brief Sort key bits of the view depth of @param modelMatrix*/
+	std::uint64_t getDepthKey(const glm::mat4 &modelMatrix) const;
+
+	struct DrawItem
+	{
+		const Mesh *m_Mesh;
+		const ShaderProgram *m_Shader;
+		glm::mat4 m_ModelMatrix;
+		unsigned int m_PaletteBase;
+		unsigned int m_Lod;
+	};
+	typedef std::pair<std::uint64_t, unsigned int> SortEntry; //!< key and index into m_Items. Sorting these is cheaper than moving the items
+
+	std::vector<DrawItem> m_Items;
+	std::vector<SortEntry> m_Order;
+	std::vector<InstanceData> m_Instances; //!< scratch for the instances of a draw
+	StreamBuffer m_Ring;
+	glm::mat4 m_ViewMatrix; //!< for the depth of the sort key. The shaders get the camera from FrameConstants
+	float m_FarDepth; //!< view depth mapped to the largest depth key. Farther draws share it
+
+	std::map<std::vector<GLuint>, unsigned int> m_TextureSets; //!< texture ids of a set to its id
+	unsigned int m_NextMesh; //!< id the next registered mesh gets
+
+	static const unsigned int MAX_TEXTURE_UNITS = 8; //!< texture units the bind cache tracks. Units past it are always bound
+	unsigned int m_Draws;
+	unsigned int m_DrawnInstances;
+	unsigned int m_StateChanges;
+	unsigned int m_SkippedBinds;
+	unsigned int m_LodTriangles[Mesh::MAX_LODS];
+	unsigned int m_Overflows; //!< instances that did not fit in the ring this frame
+	bool m_OverflowLogged; //!< the overflow warning is only given once
+};
\ No newline at end of file
@@ -38,7 +38,7 @@ ShaderProgram* ShaderManager::getShaderProgram(const std::string &vertexShaderNa
 		luapath::LuaState settings("config/settings.lua");
 
 		//note the dot '.' ; recall that luapath uses '.' to traverse the next string key and '#' next integer key
-		string vsFullPath = settings.getGlobalTable("vertexShaders").getValue(string(".") + vertexShaderName);
+		string vsFullPath = getVertexShaderPath(settings, vertexShaderName, newShader);
 
 		luapath::Table currFSShader = settings.getGlobalTable("fragmentShaders").getTable(string(".")+fragmentShaderName);
 		addSamplers(currFSShader,newShader);
@@ -57,6 +57,28 @@ ShaderProgram* ShaderManager::getShaderProgram(const std::string &vertexShaderNa
 	
 }
 
+string ShaderManager::getVertexShaderPath(luapath::LuaState &settings, const std::string &vertexShaderName, ShaderProgram *currShader)
+{
+	luapath::Table vertexShaders = settings.getGlobalTable("vertexShaders");
+	luapath::Table currVSShader;
+	if (!vertexShaders.getTable(string(".") + vertexShaderName, currVSShader))
+		return vertexShaders.getValue(string(".") + vertexShaderName);
+
+	//optional. defaults to mat4
+	luapath::Value paletteValue;
+	if (currVSShader.getValue(".palette", paletteValue))
+	{
+		string paletteStr = paletteValue;
+		if (paletteStr == "mat3x4")
+			currShader->m_PaletteFormat = PaletteFormat::MAT3X4;
+		else if (paletteStr == "dualQuat")
+			currShader->m_PaletteFormat = PaletteFormat::DUAL_QUAT;
+		else if (paletteStr != "mat4")
+			LOG(WARN) << "unknown bone palette format " << paletteStr << ". Using mat4";
+	}
+	return currVSShader.getValue(".shaderDir");
+}
+
 void ShaderManager::addSamplers(const luapath::Table &shaderTable, ShaderProgram *currShader)
 {
 	currShader->samplers["diffuse"] = vector<string>();
@@ -32,6 +32,8 @@ private:
 	GLuint createProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
 	/**Retrieves the sampler names from the lua config file. The samplers that store texture object that is.*/
 	void addSamplers(const luapath::Table &shaderTable, ShaderProgram *currShader);
+	/**Finds the source of a vertex shader. The entry is either the path or a table with the path and the bone palette format of the shader*/
+	std::string getVertexShaderPath(luapath::LuaState &settings, const std::string &vertexShaderName, ShaderProgram *currShader);
 
 private:
 	typedef std::unordered_set<ShaderProgram*> shaderProgramSet;
@@ -7,7 +7,7 @@ ShaderProgram::Key::Key(const std::string vertexShader, const std::string fragme
 }
 
 ShaderProgram::ShaderProgram(const ShaderProgram::Key &shaderNames)
-	: shaderNames(shaderNames)
+	: shaderNames(shaderNames), m_PaletteFormat(PaletteFormat::MAT4)
 {
 
 }
@@ -2,6 +2,7 @@
 
 #include "stdafx.h"
 #include <GL/glew.h>
+#include "BonePalette.hpp"
 
 /**@brief Represents a loaded shader program on the gpu
 @todo please encapsulate better. Look at m_Id variable. I don't see anywhere in the constructor
@@ -26,4 +27,5 @@ public:
 	//map key : diffuse, specular, etc. and map value : list of names for that type
 	typedef std::map<std::string, std::vector<std::string> > SamplerMap;
 	SamplerMap samplers;
+	PaletteFormat m_PaletteFormat; //!< how the vertex shader expects the bone palette. Only matters for skinning shaders
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "SimdDispatch.hpp"
+
+bool supportsAVX2()
+{
+#if !defined(SIMD_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if(!fma || !osxsave || !avx)
+		return false;
+	//the os has to save the ymm registers as well
+	if((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+SimdLevel getSimdLevel()
+{
+	if(supportsAVX2())
+		return SimdLevel::AVX2;
+#ifdef SIMD_X86
+	return SimdLevel::SSE2;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+const char* getSimdName(SimdLevel level)
+{
+	switch(level)
+	{
+	case SimdLevel::AVX2:
+		return "AVX2";
+	case SimdLevel::SSE2:
+		return "SSE2";
+	default:
+		return "scalar";
+	}
+}
\ No newline at end of file
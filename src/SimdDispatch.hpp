@@ -0,0 +1,65 @@
+#pragma once
+#include "stdafx.h"
+
+/**
+@file
+@brief What the SIMD kernels (PoseKernel, SkinningKernel, FrustumCuller) share: the x86 detection, the per function target
+attributes and the pick of the widest path the cpu supports
+*/
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#endif
+
+//msvc compiles any intrinsic without extra flags. gcc and clang need to be told per function
+#if defined(SIMD_X86) && !defined(_MSC_VER)
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#endif
+
+//the SSE2 and AVX2 paths are only compiled on x86. Elsewhere every slot gets the scalar path so they are never referenced
+#ifdef SIMD_X86
+#define SIMD_PATHS(scalar, sse2, avx2) scalar, sse2, avx2
+#else
+#define SIMD_PATHS(scalar, sse2, avx2) scalar, scalar, scalar
+#endif
+
+enum class SimdLevel{ SCALAR, SSE2, AVX2 };
+
+/**@brief The widest path the cpu and the os support. Every x86 cpu that runs the rest of the program has SSE2*/
+SimdLevel getSimdLevel();
+/**@brief true if the cpu supports AVX2 and FMA and the os saves the ymm registers*/
+bool supportsAVX2();
+const char* getSimdName(SimdLevel level);
+
+/**@brief The path of SIMD_PATHS(@param scalar, @param sse2, @param avx2) for @param level. Its name goes to @param name*/
+template<typename Function>
+Function selectSimdPath(SimdLevel level, Function scalar, Function sse2, Function avx2, std::string &name)
+{
+	name = getSimdName(level);
+	switch(level)
+	{
+	case SimdLevel::AVX2:
+		return avx2;
+	case SimdLevel::SSE2:
+		return sse2;
+	default:
+		return scalar;
+	}
+}
+
+/**@brief Same as above for the widest level of the cpu. Logs the pick as @param kernel*/
+template<typename Function>
+Function selectSimdPath(const char *kernel, Function scalar, Function sse2, Function avx2, std::string &name)
+{
+	Function path = selectSimdPath(getSimdLevel(), scalar, sse2, avx2, name);
+	LOG(INFO) << kernel << " kernel : " << name;
+	return path;
+}
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "SkinningKernel.hpp"
+#include "SimdDispatch.hpp"
+#include "Model.hpp"
+
+using std::string;
+
+//vertices skinned by a single pool index
+static const unsigned int SKINNING_CHUNK_SIZE = 2048;
+
+void SkinnedBuffer::resize(const SkinnedModel &model)
+{
+	unsigned int numMeshes = model.m_Meshes.size();
+	if (m_MeshOffsets.size() == numMeshes + 1)
+	{
+		bool sameLayout = true;
+		for (unsigned int i = 0; i < numMeshes && sameLayout; i++)
+		{
+			const SkinnedMesh *mesh = static_cast<const SkinnedMesh*>(model.m_Meshes[i]);
+			sameLayout = m_MeshOffsets[i + 1] - m_MeshOffsets[i] == mesh->m_SkinnedVertices.size();
+		}
+		if (sameLayout)
+			return;
+	}
+	m_MeshOffsets.resize(numMeshes + 1);
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < numMeshes; i++)
+	{
+		m_MeshOffsets[i] = total;
+		total += static_cast<const SkinnedMesh*>(model.m_Meshes[i])->m_SkinnedVertices.size();
+	}
+	m_MeshOffsets[numMeshes] = total;
+	m_Positions.resize(total);
+	m_Normals.resize(total);
+}
+
+SkinningKernel& SkinningKernel::get()
+{
+	static SkinningKernel singleton;
+	return singleton;
+}
+
+SkinningKernel::SkinningKernel()
+	:m_Palette(NULL)
+{
+	m_Skin = selectSimdPath("skinning", SIMD_PATHS(&SkinningKernel::skinScalar, &SkinningKernel::skinSSE, &SkinningKernel::skinAVX2), m_Name);
+}
+
+void SkinningKernel::skin(const SkinnedModel &model, const BoneArray<glm::mat4> &palette, SkinnedBuffer &result, bool parallel)
+{
+	result.resize(model);
+	if (!parallel || !WorkerPool::get().getNumWorkers())
+	{
+		for (unsigned int i = 0; i < model.m_Meshes.size(); i++)
+		{
+			const std::vector<SkinnedVertex> &vertices = static_cast<const SkinnedMesh*>(model.m_Meshes[i])->m_SkinnedVertices;
+			if (vertices.empty())
+				continue;
+			unsigned int first = result.m_MeshOffsets[i];
+			m_Skin(&vertices[0], vertices.size(), palette.data(), &result.m_Positions[first], &result.m_Normals[first]);
+		}
+		return;
+	}
+
+	//split every mesh in chunks so a large mesh does not end up on a single thread
+	m_Chunks.clear();
+	for (unsigned int i = 0; i < model.m_Meshes.size(); i++)
+	{
+		const std::vector<SkinnedVertex> &vertices = static_cast<const SkinnedMesh*>(model.m_Meshes[i])->m_SkinnedVertices;
+		unsigned int first = result.m_MeshOffsets[i];
+		for (unsigned int v = 0; v < vertices.size(); v += SKINNING_CHUNK_SIZE)
+		{
+			Chunk chunk;
+			chunk.m_Vertices = &vertices[v];
+			chunk.m_Count = std::min<unsigned int>(SKINNING_CHUNK_SIZE, vertices.size() - v);
+			chunk.m_Positions = &result.m_Positions[first + v];
+			chunk.m_Normals = &result.m_Normals[first + v];
+			m_Chunks.push_back(chunk);
+		}
+	}
+	m_Palette = palette.data();
+	WorkerPool::get().run(*this, m_Chunks.size());
+	m_Palette = NULL;
+}
+
+void SkinningKernel::skin(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals) const
+{
+	m_Skin(vertices, count, palette, positions, normals);
+}
+
+void SkinningKernel::execute(unsigned int index)
+{
+	const Chunk &chunk = m_Chunks[index];
+	m_Skin(chunk.m_Vertices, chunk.m_Count, m_Palette, chunk.m_Positions, chunk.m_Normals);
+}
+
+const string& SkinningKernel::getName() const
+{
+	return m_Name;
+}
+
+void SkinningKernel::skinScalar(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+{
+	for (unsigned int v = 0; v < count; v++)
+	{
+		const SkinnedVertex &vertex = vertices[v];
+		//blend the 4 matrices as the shader does. column major like glm
+		float blended[16] = {0};
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			float weight = vertex.m_BoneWeights[k];
+			const float *bone = &palette[vertex.m_BoneIndices[k]][0][0];
+			for (unsigned int j = 0; j < 16; j++)
+				blended[j] += weight * bone[j];
+		}
+		const glm::vec3 &p = vertex.m_Position;
+		const glm::vec3 &n = vertex.m_Normal;
+		for (unsigned int r = 0; r < 3; r++)
+		{
+			positions[v][r] = blended[r] * p.x + blended[4 + r] * p.y + blended[8 + r] * p.z + blended[12 + r];
+			normals[v][r] = blended[r] * n.x + blended[4 + r] * n.y + blended[8 + r] * n.z;
+		}
+	}
+}
+
+#ifdef SIMD_X86
+
+SIMD_TARGET_SSE2
+void SkinningKernel::skinSSE(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+{
+	float result[4];
+	for (unsigned int v = 0; v < count; v++)
+	{
+		const SkinnedVertex &vertex = vertices[v];
+		//one matrix column per register
+		__m128 column[4] = {_mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()};
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			__m128 weight = _mm_set1_ps(vertex.m_BoneWeights[k]);
+			const float *bone = &palette[vertex.m_BoneIndices[k]][0][0];
+			for (unsigned int c = 0; c < 4; c++)
+				column[c] = _mm_add_ps(column[c], _mm_mul_ps(weight, _mm_loadu_ps(bone + c * 4)));
+		}
+		const glm::vec3 &p = vertex.m_Position;
+		const glm::vec3 &n = vertex.m_Normal;
+		__m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column[0], _mm_set1_ps(p.x)), _mm_mul_ps(column[1], _mm_set1_ps(p.y))),
+			_mm_add_ps(_mm_mul_ps(column[2], _mm_set1_ps(p.z)), column[3]));
+		__m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column[0], _mm_set1_ps(n.x)), _mm_mul_ps(column[1], _mm_set1_ps(n.y))),
+			_mm_mul_ps(column[2], _mm_set1_ps(n.z)));
+		//glm::vec3 is 12 bytes so a 16 byte store would run into the next one
+		_mm_storeu_ps(result, position);
+		positions[v] = glm::vec3(result[0], result[1], result[2]);
+		_mm_storeu_ps(result, normal);
+		normals[v] = glm::vec3(result[0], result[1], result[2]);
+	}
+}
+
+SIMD_TARGET_AVX2
+void SkinningKernel::skinAVX2(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals)
+{
+	float result[4];
+	for (unsigned int v = 0; v < count; v++)
+	{
+		const SkinnedVertex &vertex = vertices[v];
+		//columns 0 and 1 in one register, 2 and 3 in the other
+		__m256 columns01 = _mm256_setzero_ps();
+		__m256 columns23 = _mm256_setzero_ps();
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			__m256 weight = _mm256_set1_ps(vertex.m_BoneWeights[k]);
+			const float *bone = &palette[vertex.m_BoneIndices[k]][0][0];
+			columns01 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(bone), columns01);
+			columns23 = _mm256_fmadd_ps(weight, _mm256_loadu_ps(bone + 8), columns23);
+		}
+		const glm::vec3 &p = vertex.m_Position;
+		const glm::vec3 &n = vertex.m_Normal;
+		//the halves hold column0 * x + column2 * z and column1 * y + column3, added together at the end
+		__m256 position = _mm256_fmadd_ps(columns23, _mm256_setr_ps(p.z, p.z, p.z, p.z, 1.0f, 1.0f, 1.0f, 1.0f),
+			_mm256_mul_ps(columns01, _mm256_setr_ps(p.x, p.x, p.x, p.x, p.y, p.y, p.y, p.y)));
+		__m256 normal = _mm256_fmadd_ps(columns23, _mm256_setr_ps(n.z, n.z, n.z, n.z, 0.0f, 0.0f, 0.0f, 0.0f),
+			_mm256_mul_ps(columns01, _mm256_setr_ps(n.x, n.x, n.x, n.x, n.y, n.y, n.y, n.y)));
+		_mm_storeu_ps(result, _mm_add_ps(_mm256_castps256_ps128(position), _mm256_extractf128_ps(position, 1)));
+		positions[v] = glm::vec3(result[0], result[1], result[2]);
+		_mm_storeu_ps(result, _mm_add_ps(_mm256_castps256_ps128(normal), _mm256_extractf128_ps(normal, 1)));
+		normals[v] = glm::vec3(result[0], result[1], result[2]);
+	}
+}
+
+#endif
\ No newline at end of file
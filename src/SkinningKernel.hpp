@@ -0,0 +1,75 @@
+#pragma once
+#include "stdafx.h"
+#include "Mesh.hpp"
+#include "BoneArray.hpp"
+#include "WorkerPool.hpp"
+
+#include <glm/glm.hpp>
+
+class SkinnedModel;
+
+/**
+@brief Skinned positions and normals of every mesh of a SkinnedModel
+@details The vertices of all meshes are stored one after the other. Kept from frame to frame so skinning does not allocate once sized.
+The normals are transformed but not normalized
+*/
+struct SkinnedBuffer
+{
+	/**@brief Size the buffer for the meshes of @param model. Does nothing if it already has that layout*/
+	void resize(const SkinnedModel &model);
+
+	std::vector<glm::vec3> m_Positions;
+	std::vector<glm::vec3> m_Normals;
+	std::vector<unsigned int> m_MeshOffsets; //!< first vertex of every mesh followed by the total vertex count
+};
+
+/**
+@brief Linear blend skinning on the cpu, the same that skinningVS.glsl does with 4 influences per vertex
+@details Gives the cpu the skinned mesh for pose accurate bounds, hit tests or checking the gpu path without a gpu. The AVX2 path
+blends two matrix columns per instruction, the SSE path one and the scalar path one float. The widest path the cpu supports is picked once at startup.
+Large models can be split in chunks over the WorkerPool
+*/
+class SkinningKernel
+	: private WorkerJob
+{
+public:
+	/**@brief signature of the skinning kernels. Skins @param count @param vertices with the matrices of @param palette*/
+	typedef void (*SkinFunction)(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals);
+
+	static SkinningKernel& get();
+
+	/**@brief Skin every mesh of @param model into @param result.
+		@param palette the bone matrices as sent to the shader (inverse bind pose included). Premultiply them to skin into another space
+		@param parallel split the vertices over the WorkerPool. Only from the main thread and not from inside another pool job
+	*/
+	void skin(const SkinnedModel &model, const BoneArray<glm::mat4> &palette, SkinnedBuffer &result, bool parallel = false);
+	/**@brief Skin @param count @param vertices on the calling thread*/
+	void skin(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals) const;
+
+	/**@brief name of the selected path for logging*/
+	const std::string& getName() const;
+
+	static void skinScalar(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals);
+	//only on x86, see SIMD_X86
+	static void skinSSE(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals);
+	static void skinAVX2(const SkinnedVertex *vertices, unsigned int count, const glm::mat4 *palette, glm::vec3 *positions, glm::vec3 *normals);
+private:
+	SkinningKernel();
+
+	/**@brief Skin chunk @param index of the current parallel call*/
+	virtual void execute(unsigned int index);
+
+	SkinFunction m_Skin;
+	std::string m_Name;
+
+	/**@brief A run of vertices skinned by one pool index*/
+	struct Chunk
+	{
+		const SkinnedVertex *m_Vertices;
+		unsigned int m_Count;
+		glm::vec3 *m_Positions;
+		glm::vec3 *m_Normals;
+	};
+	std::vector<Chunk> m_Chunks; //!< of the current parallel call. Kept to avoid allocating
+	const glm::mat4 *m_Palette; //!< of the current parallel call
+};
\ No newline at end of file
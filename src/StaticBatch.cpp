@@ -0,0 +1,157 @@
+#include "StaticBatch.hpp"
+#include "GameObject.hpp"
+#include "Mesh.hpp"
+#include "ShaderProgram.hpp"
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+
+using std::vector;
+
+StaticBatch& StaticBatch::get()
+{
+	static StaticBatch singleton;
+	return singleton;
+}
+
+StaticBatch::StaticBatch()
+	:m_CommandBuffer(0), m_NumCommands(0)
+{
+
+}
+
+StaticBatch::Group& StaticBatch::findGroup(unsigned int buffer, const Mesh *mesh)
+{
+	for (unsigned int i = 0; i < m_Groups.size(); i++)
+		if (m_Groups[i].m_Buffer == buffer && m_Groups[i].m_Material->hasSameMaterial(*mesh))
+			return m_Groups[i];
+	Group group;
+	group.m_Buffer = buffer;
+	group.m_Material = mesh;
+	group.m_FirstCommand = 0;
+	m_Groups.push_back(group);
+	return m_Groups.back();
+}
+
+void StaticBatch::add(Object *object)
+{
+	const ShaderProgram *shader = object->m_Model->getShaderProgram();
+	unsigned int buffer = 0;
+	while (buffer < m_Buffers.size() && m_Buffers[buffer].m_Shader != shader)
+		buffer++;
+	if (buffer == m_Buffers.size())
+	{
+		Buffer newBuffer;
+		newBuffer.m_Shader = shader;
+		newBuffer.m_Merged = new Mesh();
+		newBuffer.m_DrawInstanceVBO = 0;
+		m_Buffers.push_back(newBuffer);
+	}
+	Mesh *merged = m_Buffers[buffer].m_Merged;
+
+	for (unsigned int i = 0; i < object->m_Model->m_Meshes.size(); i++)
+	{
+		const Mesh *mesh = object->m_Model->m_Meshes[i];
+		DrawCommand command;
+		command.m_Count = mesh->m_Indices.size();
+		command.m_InstanceCount = 1;
+		command.m_FirstIndex = merged->m_Indices.size();
+		command.m_BaseVertex = merged->m_Vertices.size();
+		command.m_BaseInstance = m_Objects.size();
+		findGroup(buffer, mesh).m_Commands.push_back(command);
+
+		merged->m_Vertices.insert(merged->m_Vertices.end(), mesh->m_Vertices.begin(), mesh->m_Vertices.end());
+		merged->m_Indices.insert(merged->m_Indices.end(), mesh->m_Indices.begin(), mesh->m_Indices.end());
+	}
+	m_Objects.push_back(object);
+}
+
+void StaticBatch::build()
+{
+	//one drawInstance per object. With a divisor of 1 a command reads the entry of its base instance
+	vector<GLuint> drawInstances(m_Objects.size());
+	for (unsigned int i = 0; i < drawInstances.size(); i++)
+		drawInstances[i] = i;
+	for (unsigned int b = 0; b < m_Buffers.size(); b++)
+	{
+		Buffer &buffer = m_Buffers[b];
+		buffer.m_Merged->createVAO(buffer.m_Shader);
+		glBindVertexArray(buffer.m_Merged->getVAO());
+		glGenBuffers(1, &buffer.m_DrawInstanceVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer.m_DrawInstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, drawInstances.size() * sizeof(GLuint), drawInstances.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(DRAW_INSTANCE_LOCATION);
+		glVertexAttribIPointer(DRAW_INSTANCE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+		glVertexAttribDivisor(DRAW_INSTANCE_LOCATION, 1);
+		glBindVertexArray(0);
+		//the vertices are only needed on the gpu from now on
+		vector<Vertex>().swap(buffer.m_Merged->m_Vertices);
+	}
+	//every other VAO leaves the attribute disabled and reads this
+	glVertexAttribI4ui(DRAW_INSTANCE_LOCATION, 0, 0, 0, 0);
+
+	std::stable_sort(m_Groups.begin(), m_Groups.end(), [](const Group &a, const Group &b) { return a.m_Buffer < b.m_Buffer; });
+	vector<DrawCommand> commands;
+	for (unsigned int i = 0; i < m_Groups.size(); i++)
+	{
+		Group &group = m_Groups[i];
+		group.m_FirstCommand = commands.size();
+		commands.insert(commands.end(), group.m_Commands.begin(), group.m_Commands.end());
+	}
+	m_NumCommands = commands.size();
+
+	glGenBuffers(1, &m_CommandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	LOG(INFO) << "static batch : " << m_Objects.size() << " objects, " << m_NumCommands << " meshes in " << m_Groups.size() << " draws";
+}
+
+void StaticBatch::render()
+{
+	if (!m_NumCommands)
+		return;
+	vector<RenderQueue::InstanceData> instances(m_Objects.size());
+	for (unsigned int i = 0; i < m_Objects.size(); i++)
+	{
+		instances[i].m_Model = m_Objects[i]->getTransform().getMatrix();
+		instances[i].m_Palette[0] = instances[i].m_Palette[1] = instances[i].m_Palette[2] = instances[i].m_Palette[3] = 0;
+	}
+	if (!RenderQueue::get().bindInstances(instances.data(), instances.size()))
+		return;
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_CommandBuffer);
+	unsigned int currBuffer = m_Buffers.size();
+	for (unsigned int i = 0; i < m_Groups.size(); i++)
+	{
+		const Group &group = m_Groups[i];
+		if (group.m_Buffer != currBuffer)
+		{
+			currBuffer = group.m_Buffer;
+			glUseProgram(m_Buffers[currBuffer].m_Shader->m_Id);
+			glBindVertexArray(m_Buffers[currBuffer].m_Merged->getVAO());
+		}
+		const Mesh *material = group.m_Material;
+		material->applyMaterial();
+		for (GLuint t = 0; t < material->m_Textures.size(); t++)
+		{
+			glActiveTexture(GL_TEXTURE0 + t);
+			glBindTexture(GL_TEXTURE_2D, material->m_Textures[t].m_Id);
+		}
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*)(group.m_FirstCommand * sizeof(DrawCommand)),
+			group.m_Commands.size(), 0);
+	}
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+unsigned int StaticBatch::getDraws() const
+{
+	return m_Groups.size();
+}
+
+unsigned int StaticBatch::getCommands() const
+{
+	return m_NumCommands;
+}
\ No newline at end of file
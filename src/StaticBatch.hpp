@@ -0,0 +1,72 @@
+#pragma once
+#include "stdafx.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Object;
+struct Mesh;
+struct ShaderProgram;
+
+/**
+@brief Draws the meshes of objects that never change model (level, gate, skybox) with a handful of multi draw indirect calls
+@details build merges the vertices and indices of every mesh sharing a shader into one buffer pair and writes one indirect command per mesh.
+The commands are grouped by shader, texture set and material so each group is a single glMultiDrawElementsIndirect.
+The objects may still move: their model matrices go to the instance ring every frame and each command selects its object
+through its base instance, which the vertex shaders read as drawInstance
+*/
+class StaticBatch
+{
+public:
+	static StaticBatch& get();
+
+	static const GLuint DRAW_INSTANCE_LOCATION = 15; //!< attribute location of drawInstance in the vertex shaders
+
+	/**@brief Add the meshes of @param object to the batch. Only before build and only for models with the Vertex format*/
+	void add(Object *object);
+	/**@brief Merge the meshes added so far and upload them with the draw commands*/
+	void build();
+	/**@brief Draw every object of the batch. Between RenderQueue::beginFrame and RenderQueue::flush*/
+	void render();
+
+	unsigned int getDraws() const; //!< multi draw calls made per frame
+	unsigned int getCommands() const; //!< meshes drawn by them
+private:
+	StaticBatch();
+
+	/**@brief Layout of a command in GL_DRAW_INDIRECT_BUFFER*/
+	struct DrawCommand
+	{
+		GLuint m_Count;
+		GLuint m_InstanceCount;
+		GLuint m_FirstIndex;
+		GLint m_BaseVertex;
+		GLuint m_BaseInstance; //!< the object of the command in the instance data
+	};
+
+	/**@brief Meshes drawn by a single multi draw. They share the program, the textures and the material*/
+	struct Group
+	{
+		unsigned int m_Buffer; //!< index into m_Buffers
+		const Mesh *m_Material; //!< any mesh of the group. Its material and textures are applied for all
+		std::vector<DrawCommand> m_Commands; //!< filled by add and uploaded by build
+		unsigned int m_FirstCommand;
+	};
+
+	/**@brief The merged vertices and indices of every mesh drawn with a shader*/
+	struct Buffer
+	{
+		const ShaderProgram *m_Shader;
+		Mesh *m_Merged; //!< newed and never deleted as the buffers may not outlive the context. Only the indices stay on the cpu
+		GLuint m_DrawInstanceVBO;
+	};
+
+	/**@brief The group @param mesh belongs to in @param buffer. Creates it if there is none*/
+	Group& findGroup(unsigned int buffer, const Mesh *mesh);
+
+	std::vector<Object*> m_Objects;
+	std::vector<Buffer> m_Buffers;
+	std::vector<Group> m_Groups;
+	GLuint m_CommandBuffer;
+	unsigned int m_NumCommands;
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+
+StreamBuffer::StreamBuffer()
+	:m_Buffer(0), m_Mapped(nullptr), m_RegionSize(0), m_Alignment(1), m_Region(0), m_Offset(0)
+{
+	for (unsigned int i = 0; i < REGIONS; i++)
+		m_Fences[i] = 0;
+}
+
+void StreamBuffer::init(GLsizeiptr regionSize, const char *name)
+{
+	GLint alignment = 1;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_Alignment = std::max(alignment, 1);
+	//round the region up so every region starts aligned too
+	m_RegionSize = (regionSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &m_Buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_Buffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, m_RegionSize * REGIONS, nullptr, flags);
+	m_Mapped = static_cast<unsigned char*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, m_RegionSize * REGIONS, flags));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	if (!m_Mapped)
+		LOG(ERROR) << "Could not map the " << name << " buffer";
+	else
+		LOG(INFO) << name << " ring: " << REGIONS << " x " << m_RegionSize << " bytes";
+}
+
+void StreamBuffer::beginFrame()
+{
+	m_Region = (m_Region + 1) % REGIONS;
+	m_Offset = 0;
+	GLsync &fence = m_Fences[m_Region];
+	if (fence)
+	{
+		//normally signaled long ago. Only blocks if the gpu is REGIONS frames behind
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		fence = 0;
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+unsigned char* StreamBuffer::allocate(GLsizeiptr bytes, GLintptr alignment, GLintptr &offset)
+{
+	GLintptr start = (m_Offset + alignment - 1) / alignment * alignment;
+	if (!m_Mapped || start + bytes > m_RegionSize)
+		return nullptr;
+	m_Offset = start + bytes;
+	offset = start;
+	return m_Mapped + getRegionOffset() + start;
+}
+
+GLuint StreamBuffer::getBuffer() const
+{
+	return m_Buffer;
+}
+
+GLintptr StreamBuffer::getRegionOffset() const
+{
+	return m_Region * m_RegionSize;
+}
+
+GLsizeiptr StreamBuffer::getRegionSize() const
+{
+	return m_RegionSize;
+}
+
+GLintptr StreamBuffer::getOffsetAlignment() const
+{
+	return m_Alignment;
+}
\ No newline at end of file
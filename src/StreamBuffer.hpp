@@ -0,0 +1,45 @@
+#pragma once
+#include "stdafx.h"
+
+#include <GL/glew.h>
+
+/**
+@brief Persistently mapped shader storage ring for data the cpu writes every frame
+@details The buffer is split in as many regions as frames may be in flight. Each frame hands out the next region piece by piece
+and a fence per region keeps the cpu from overwriting a region the gpu still reads. Every region starts on an offset
+glBindBufferRange accepts, so the whole region of a frame can be bound at once
+*/
+class StreamBuffer
+{
+public:
+	static const unsigned int REGIONS = 3; //!< frames that may be in flight
+
+	StreamBuffer();
+
+	/**@brief Create the buffer with regions of at least @param regionSize bytes. @param name is only used in the log*/
+	void init(GLsizeiptr regionSize, const char *name);
+
+	/**@brief Wait until the gpu is done with the next region and start handing it out*/
+	void beginFrame();
+	/**@brief Fence the region of this frame. Called after the last draw reading it*/
+	void endFrame();
+
+	/**@brief Reserve @param bytes of this frame's region starting on a multiple of @param alignment
+		@param offset receives the start of the reservation relative to the region
+		@return where to write it or nullptr if the region has no room left
+	*/
+	unsigned char* allocate(GLsizeiptr bytes, GLintptr alignment, GLintptr &offset);
+
+	GLuint getBuffer() const;
+	GLintptr getRegionOffset() const; //!< start of this frame's region in the buffer
+	GLsizeiptr getRegionSize() const;
+	GLintptr getOffsetAlignment() const; //!< GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+private:
+	GLuint m_Buffer;
+	unsigned char *m_Mapped; //!< start of the persistent mapping
+	GLsizeiptr m_RegionSize; //!< bytes of a region. A multiple of m_Alignment
+	GLintptr m_Alignment;
+	GLsync m_Fences[REGIONS];
+	unsigned int m_Region; //!< region handed out this frame
+	GLintptr m_Offset; //!< next free byte of the current region
+};
\ No newline at end of file
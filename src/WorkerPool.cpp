@@ -0,0 +1,103 @@
+#include "WorkerPool.hpp"
+
+WorkerPool& WorkerPool::get()
+{
+	static WorkerPool singleton;
+	return singleton;
+}
+
+WorkerPool::WorkerPool()
+	:m_Job(NULL), m_Count(0), m_NextIndex(0), m_Batch(0), m_Busy(0), m_Quit(false)
+{
+
+}
+
+WorkerPool::~WorkerPool()
+{
+	stopWorkers();
+}
+
+void WorkerPool::setNumWorkers(unsigned int numWorkers)
+{
+	stopWorkers();
+	for (unsigned int i = 0; i < numWorkers; i++)
+		m_Workers.push_back(std::thread(&WorkerPool::workerLoop, this, m_Batch));
+	LOG(INFO) << "worker pool : " << numWorkers << " threads next to the main thread";
+}
+
+unsigned int WorkerPool::getNumWorkers() const
+{
+	return m_Workers.size();
+}
+
+void WorkerPool::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WorkReady.notify_all();
+	for (unsigned int i = 0; i < m_Workers.size(); i++)
+		m_Workers[i].join();
+	m_Workers.clear();
+	m_Quit = false;
+}
+
+void WorkerPool::run(WorkerJob &job, unsigned int count)
+{
+	if (!count)
+		return;
+	m_Job = &job;
+	m_Count = count;
+	m_NextIndex = 0;
+	//waking the workers costs more than a single index
+	if (m_Workers.empty() || count == 1)
+	{
+		executeIndices();
+		m_Job = NULL;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Batch++;
+		m_Busy = m_Workers.size();
+	}
+	m_WorkReady.notify_all();
+	//the calling thread would only wait otherwise
+	executeIndices();
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (m_Busy)
+			m_WorkDone.wait(lock);
+	}
+	m_Job = NULL;
+}
+
+void WorkerPool::executeIndices()
+{
+	unsigned int index;
+	while ((index = m_NextIndex++) < m_Count)
+		m_Job->execute(index);
+}
+
+void WorkerPool::workerLoop(unsigned int batch)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			while (!m_Quit && batch == m_Batch)
+				m_WorkReady.wait(lock);
+			if (m_Quit)
+				return;
+			batch = m_Batch;
+		}
+		executeIndices();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Busy--;
+		}
+		m_WorkDone.notify_one();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include "stdafx.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**@brief A piece of work split into independent indices which WorkerPool spreads over its threads*/
+struct WorkerJob
+{
+	virtual ~WorkerJob(){}
+	/**@brief Process index @param index. Called at most once per index and possibly from several threads at the same time*/
+	virtual void execute(unsigned int index) = 0;
+};
+
+/**
+@brief Persistent worker threads shared by the engine stages that run in parallel (IK, CPU skinning)
+@details run hands the indices of a job out through an atomic counter to the workers and the calling thread and returns once all of them are done.
+Only one job runs at a time and a job may not call run itself
+*/
+class WorkerPool
+{
+public:
+	static WorkerPool& get();
+	~WorkerPool();
+
+	/**@brief Stop the current workers and start @param numWorkers new ones. 0 runs every job on the calling thread*/
+	void setNumWorkers(unsigned int numWorkers);
+	unsigned int getNumWorkers() const;
+
+	/**@brief Call @param job for every index in [0, @param count) and wait for all of them*/
+	void run(WorkerJob &job, unsigned int count);
+private:
+	WorkerPool();
+
+	/**@brief Body of the worker threads. Waits for a batch newer than @param batch, helps running it and reports back.
+		The starting batch is read by the spawning thread as a batch may be posted before the worker gets to run*/
+	void workerLoop(unsigned int batch);
+	/**@brief Take indices of the current job until there are none left*/
+	void executeIndices();
+	/**@brief Ask the workers to quit and wait for them*/
+	void stopWorkers();
+
+	WorkerJob *m_Job; //!< only written while the workers are idle
+	unsigned int m_Count; //!< indices of m_Job
+	std::atomic<unsigned int> m_NextIndex; //!< next index to hand out
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_WorkReady; //!< a new batch has been posted or the workers should quit
+	std::condition_variable m_WorkDone; //!< a worker finished its part of the batch
+	unsigned int m_Batch; //!< incremented for every batch the workers have to take part in
+	unsigned int m_Busy; //!< workers that have not finished the current batch
+	bool m_Quit;
+};
\ No newline at end of file
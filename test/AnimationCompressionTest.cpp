@@ -0,0 +1,67 @@
+#include "Animation.hpp"
+#include "TestAnimation.hpp"
+#include "TestCheck.hpp"
+
+/**
+@file
+@brief Samples compressed clips against the raw keys they were built from. The error of every channel has to stay within its tolerance,
+including the quantization of the kept keys, for narrow position ranges packed in 16 bits and wide ones that need 32
+*/
+
+static const unsigned int NUM_BONES = 20;
+static const unsigned int NUM_KEYS = 120;
+static const unsigned int NUM_SAMPLES = 4000;
+//float rounding of sampling the raw clip itself
+static const float SAMPLE_SLACK = 1e-5f;
+
+/**@brief the angle between two rotations in radians*/
+static float angleBetween(const glm::quat &a, const glm::quat &b)
+{
+	float cosHalfAngle = std::abs(glm::dot(a, b));
+	return cosHalfAngle >= 1.0f ? 0.0f : 2.0f * acos(cosHalfAngle);
+}
+
+/**@brief Compress a clip whose bones travel @param travel with @param tolerance and check every channel over the whole clip*/
+static void checkCompression(float travel, const CompressionTolerance &tolerance)
+{
+	Animation raw, compressed;
+	buildTestAnimation(raw, NUM_BONES, NUM_KEYS, travel);
+	buildTestAnimation(compressed, NUM_BONES, NUM_KEYS, travel);
+	compressed.compress(tolerance);
+	CHECK(compressed.getMemorySize() < raw.getMemorySize());
+
+	float maxPosition = 0, maxRotation = 0, maxScale = 0;
+	BoneArray<SQTTransform> rawPose, compressedPose;
+	for (unsigned int s = 0; s <= NUM_SAMPLES; s++)
+	{
+		double time = raw.m_TotalDuration * s / NUM_SAMPLES * 0.999;
+		raw.getTransforms(time, rawPose);
+		compressed.getTransforms(time, compressedPose);
+		for (unsigned int b = 0; b < NUM_BONES; b++)
+		{
+			maxPosition = std::max(maxPosition, glm::length(rawPose[b].getPosition() - compressedPose[b].getPosition()));
+			maxRotation = std::max(maxRotation, angleBetween(rawPose[b].getOrientation(), compressedPose[b].getOrientation()));
+			maxScale = std::max(maxScale, glm::length(rawPose[b].getScale() - compressedPose[b].getScale()));
+		}
+	}
+	printf("travel %g : max error position %g, rotation %g, scale %g\n", travel, maxPosition, maxRotation, maxScale);
+	CHECK(maxPosition <= tolerance.m_Position + SAMPLE_SLACK);
+	CHECK(maxRotation <= tolerance.m_Rotation + SAMPLE_SLACK);
+	CHECK(maxScale <= tolerance.m_Scale + SAMPLE_SLACK);
+}
+
+int main()
+{
+	CompressionTolerance tolerance;
+	tolerance.m_Position = 0.001f;
+	tolerance.m_Rotation = 0.002f;
+	tolerance.m_Scale = 0.001f;
+	//positions within a few units fit in 16 bits, 100 units of travel do not
+	checkCompression(0.0f, tolerance);
+	checkCompression(100.0f, tolerance);
+
+	//per channel: a loose position tolerance does not loosen the rotations
+	tolerance.m_Position = 0.05f;
+	checkCompression(0.0f, tolerance);
+	return finishTest("AnimationCompressionTest");
+}
\ No newline at end of file
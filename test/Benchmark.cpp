@@ -0,0 +1,197 @@
+#include "GameObject.hpp"
+#include "Model.hpp"
+#include "PoseKernel.hpp"
+#include "SimdDispatch.hpp"
+#include "TestAnimation.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+/**
+@file
+@brief Times the hot loops of the animation code on synthetic data. Not a test: it prints the time per call of every case and always succeeds
+*/
+
+/**@brief Wall clock time since construction*/
+class Stopwatch
+{
+public:
+	Stopwatch()
+		:m_Start(std::chrono::high_resolution_clock::now())
+	{
+
+	}
+
+	double getNanoseconds() const
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - m_Start).count();
+	}
+private:
+	std::chrono::high_resolution_clock::time_point m_Start;
+};
+
+/**@brief Print the time per call of @param iterations calls that took @param stopwatch*/
+static void report(const char *name, const Stopwatch &stopwatch, unsigned int iterations)
+{
+	printf("%-40s %10.1f ns\n", name, stopwatch.getNanoseconds() / iterations);
+}
+
+static volatile float g_Sink; //!< keeps the results alive so the loops are not optimized away
+
+/**@brief Blend of two 60 bone poses with every PoseKernel path the cpu runs*/
+static void benchmarkPoseBlend()
+{
+	static const unsigned int NUM_BONES = 60;
+	static const unsigned int ITERATIONS = 200000;
+	PoseBuffer from, to, result;
+	from.resize(NUM_BONES);
+	to.resize(NUM_BONES);
+	result.resize(NUM_BONES);
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		float angle = 0.05f * b;
+		to.setBone(b, SQTTransform(glm::vec3(angle), glm::vec3(1.0f), glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f))));
+	}
+
+	const char *names[3] = { "pose blend 60 bones scalar", "pose blend 60 bones SSE2", "pose blend 60 bones AVX2" };
+	PoseKernel::BlendFunction paths[3] = { SIMD_PATHS(&PoseKernel::blendScalar, &PoseKernel::blendSSE2, &PoseKernel::blendAVX2) };
+	unsigned int numPaths = getSimdLevel() == SimdLevel::AVX2 ? 3 : getSimdLevel() == SimdLevel::SSE2 ? 2 : 1;
+	for (unsigned int p = 0; p < numPaths; p++)
+	{
+		Stopwatch stopwatch;
+		for (unsigned int i = 0; i < ITERATIONS; i++)
+			paths[p](&from.m_Data[0], &to.m_Data[0], (i & 255) / 255.0f, &result.m_Data[0], from.m_Stride);
+		report(names[p], stopwatch, ITERATIONS);
+		g_Sink = result.m_Data[0];
+	}
+}
+
+/**@brief Sampling every channel of a 60 bone clip, as playback does it frame after frame, with and without a key cursor.
+	The clip gets longer from case to case at two frames per key so the cursor always walks the same distance and should cost the same
+	while the binary search grows with the number of keys*/
+static void benchmarkKeyLookup()
+{
+	static const unsigned int NUM_BONES = 60;
+	static const unsigned int ITERATIONS = 20000;
+	static const unsigned int NUM_CLIPS = 4;
+	const unsigned int numKeys[NUM_CLIPS] = { 32, 256, 2048, 16384 };
+	for (unsigned int c = 0; c < NUM_CLIPS; c++)
+	{
+		Animation anim;
+		buildTestAnimation(anim, NUM_BONES, numKeys[c]);
+		//the frame time that advances half a key, looping
+		double frameTime = anim.m_TotalDuration / (numKeys[c] - 1) / 2.0;
+		BoneArray<SQTTransform> pose;
+		AnimCursor cursor;
+		std::string name = "key lookup " + std::to_string(numKeys[c]) + " keys, ";
+
+		Stopwatch cursorStopwatch;
+		for (unsigned int i = 0; i < ITERATIONS; i++)
+			anim.getTransforms(i * frameTime, pose, &cursor, AnimStorage::SPARSE);
+		report((name + "cursor").c_str(), cursorStopwatch, ITERATIONS);
+		g_Sink = pose[0].getPosition().x;
+
+		Stopwatch searchStopwatch;
+		for (unsigned int i = 0; i < ITERATIONS; i++)
+			anim.getTransforms(i * frameTime, pose, NULL, AnimStorage::SPARSE);
+		report((name + "binary search").c_str(), searchStopwatch, ITERATIONS);
+		g_Sink = pose[0].getPosition().x;
+	}
+}
+
+/**@brief A skeleton of chains of bones hanging off a root bone, built without a model file. The chains fan out and bend a little so a CCD solve has work to do*/
+class BenchmarkSkeleton
+	: public SkinnedModel
+{
+public:
+	BenchmarkSkeleton(unsigned int numChains, unsigned int chainLength)
+		:SkinnedModel("benchmark")
+	{
+		unsigned int numBones = 1 + numChains * chainLength;
+		glm::quat bend = glm::angleAxis(0.1f, glm::vec3(0.0f, 0.0f, 1.0f));
+		m_LocalTransforms.assign(numBones, SQTTransform(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f), bend));
+		m_InverseBindPoses.assign(numBones, glm::mat4());
+		m_BonesById.assign(numBones, NULL);
+		m_LinearIndex.assign(numBones, 0);
+		m_Skeleton = createBone(0, NULL);
+		int id = 1;
+		for (unsigned int c = 0; c < numChains; c++)
+		{
+			m_LocalTransforms[id].setRotation(glm::angleAxis(1.2f * c - 2.4f, glm::vec3(1.0f, 0.0f, 0.0f)));
+			Bone *parent = m_Skeleton;
+			for (unsigned int b = 0; b < chainLength; b++)
+				parent = createBone(id++, parent);
+		}
+		linearizeSkeleton(m_Skeleton, -1, glm::mat4(), false);
+	}
+private:
+	Bone* createBone(int id, Bone *parent)
+	{
+		Bone *bone = new Bone;
+		bone->m_Id = id;
+		bone->m_Name = "bone" + std::to_string(id);
+		bone->m_LocalTransformation = m_LocalTransforms[id];
+		bone->m_Parent = parent;
+		if (parent)
+			parent->m_Children.push_back(bone);
+		return bone;
+	}
+};
+
+/**@brief An object on a BenchmarkSkeleton that can choose how its IK solves bring the skeleton up to date*/
+class BenchmarkCharacter
+	: public SkinnedObject
+{
+public:
+	BenchmarkCharacter(const SkinnedModel *model, bool subtreeUpdate)
+		:SkinnedObject("benchmark", model)
+	{
+		m_IKSubtreeUpdate = subtreeUpdate;
+	}
+
+	/**@brief Back to the bind pose so every solve starts from the same place*/
+	void resetPose()
+	{
+		m_BoneLocalTransforms = m_SkinnedModel->getBoneLocalTransforms();
+	}
+};
+
+/**@brief The CCD solve of the hand IK of profile1 (chain of 5, 5 tries, no warm start) on the tip of the last arm of a 61 bone skeleton.
+	Once recomputing the whole skeleton after every link rotation as the solver used to and once updating the subtree of the link*/
+static void benchmarkCCDSolve()
+{
+	static const unsigned int NUM_CHAINS = 5;
+	static const unsigned int CHAIN_LENGTH = 12;
+	static const unsigned int ITERATIONS = 20000;
+	static const unsigned int IK_CHAIN_LENGTH = 5;
+	static const unsigned int IK_MAX_TRIES = 5;
+	BenchmarkSkeleton skeleton(NUM_CHAINS, CHAIN_LENGTH);
+	std::string effector = "bone" + std::to_string(NUM_CHAINS * CHAIN_LENGTH);
+
+	const char *names[2] = { "ccd solve 5 links 5 tries, whole skeleton", "ccd solve 5 links 5 tries, subtree" };
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		BenchmarkCharacter character(&skeleton, s == 1);
+		//off to the side of the arm and out of reach of the last 5 links, so every solve uses all its tries
+		character.attachIK(IKObject::IkType::GLOBAL, effector, glm::vec3(4.0f, 8.0f, -6.0f), IK_CHAIN_LENGTH, IK_MAX_TRIES);
+		Stopwatch stopwatch;
+		for (unsigned int i = 0; i < ITERATIONS; i++)
+		{
+			character.resetPose();
+			character.calculateIKs();
+		}
+		report(names[s], stopwatch, ITERATIONS);
+		const IKObject &ik = character.getIK(effector);
+		printf("%-40s %10u tries, residual %.3f\n", "", ik.m_Iterations, ik.m_Residual);
+		g_Sink = ik.m_Residual;
+	}
+}
+
+int main()
+{
+	benchmarkPoseBlend();
+	benchmarkKeyLookup();
+	benchmarkCCDSolve();
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "BonePalette.hpp"
+#include "TestCheck.hpp"
+
+#include <cstring>
+#include <map>
+
+using std::string;
+using std::vector;
+
+/**
+@file
+@brief Runs BonePalette and its StreamBuffer against recording stand-ins for the GL entry points, without a context.
+GLEW calls every extension function through a pointer such as __glewBindBufferRange, so the test points those at the recorders below
+*/
+
+static std::map<string, unsigned int> g_Calls; //!< GL calls since the last reset by name
+static vector<unsigned char> g_Storage; //!< what the fake mapping points at
+static GLintptr g_BoundOffset;
+static GLsizeiptr g_BoundSize;
+static GLbitfield g_StorageFlags;
+static unsigned int g_NextSync;
+
+static void APIENTRY recordGenBuffers(GLsizei n, GLuint *buffers)
+{
+	g_Calls["glGenBuffers"]++;
+	for (GLsizei i = 0; i < n; i++)
+		buffers[i] = 7;
+}
+
+static void APIENTRY recordBindBuffer(GLenum, GLuint)
+{
+	g_Calls["glBindBuffer"]++;
+}
+
+static void APIENTRY recordBufferStorage(GLenum, GLsizeiptr size, const void*, GLbitfield flags)
+{
+	g_Calls["glBufferStorage"]++;
+	g_Storage.assign(size, 0);
+	g_StorageFlags = flags;
+}
+
+static void* APIENTRY recordMapBufferRange(GLenum, GLintptr offset, GLsizeiptr, GLbitfield)
+{
+	g_Calls["glMapBufferRange"]++;
+	return &g_Storage[offset];
+}
+
+static void APIENTRY recordBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	g_Calls["glBindBufferRange"]++;
+	CHECK(target == GL_SHADER_STORAGE_BUFFER && index == BonePalette::BINDING && buffer == 7);
+	g_BoundOffset = offset;
+	g_BoundSize = size;
+}
+
+static GLsync APIENTRY recordFenceSync(GLenum, GLbitfield)
+{
+	g_Calls["glFenceSync"]++;
+	return reinterpret_cast<GLsync>(static_cast<size_t>(++g_NextSync));
+}
+
+static GLenum APIENTRY recordClientWaitSync(GLsync, GLbitfield, GLuint64)
+{
+	g_Calls["glClientWaitSync"]++;
+	return GL_ALREADY_SIGNALED;
+}
+
+static void APIENTRY recordDeleteSync(GLsync)
+{
+	g_Calls["glDeleteSync"]++;
+}
+
+static unsigned int getTotalCalls()
+{
+	unsigned int total = 0;
+	for (std::map<string, unsigned int>::const_iterator it = g_Calls.begin(); it != g_Calls.end(); ++it)
+		total += it->second;
+	return total;
+}
+
+static void installRecorders()
+{
+	__glewGenBuffers = recordGenBuffers;
+	__glewBindBuffer = recordBindBuffer;
+	__glewBufferStorage = recordBufferStorage;
+	__glewMapBufferRange = recordMapBufferRange;
+	__glewBindBufferRange = recordBindBufferRange;
+	__glewFenceSync = recordFenceSync;
+	__glewClientWaitSync = recordClientWaitSync;
+	__glewDeleteSync = recordDeleteSync;
+}
+
+/**@brief A 60 bone palette whose matrices differ per bone and per @param seed*/
+static vector<glm::mat4> makePalette(unsigned int seed)
+{
+	vector<glm::mat4> palette(60);
+	for (unsigned int i = 0; i < palette.size(); i++)
+		palette[i][3] = glm::vec4(float(seed), float(i), 0.5f * i, 1.0f);
+	return palette;
+}
+
+static void testInit(BonePalette &palette)
+{
+	//glGetIntegerv is plain GL 1.1 and not swapped. Without a context it leaves the alignment at 1
+	palette.init(1024);
+	CHECK(g_Calls["glGenBuffers"] == 1);
+	CHECK(g_Calls["glBufferStorage"] == 1);
+	CHECK(g_Calls["glMapBufferRange"] == 1);
+	CHECK(g_StorageFlags == (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+	CHECK(g_Storage.size() >= StreamBuffer::REGIONS * 1024 * sizeof(glm::mat4));
+}
+
+/**@brief Whatever the number of skinned draws, a frame makes the same GL calls: one bind of its region and one fence,
+	plus a wait on the fence of the frame that used the region last*/
+static void testCallsPerFrame(BonePalette &palette)
+{
+	GLsizeiptr regionSize = g_Storage.size() / StreamBuffer::REGIONS;
+	unsigned int draws[6] = { 0, 1, 12, 3, 12, 1 };
+	for (unsigned int frame = 0; frame < 6; frame++)
+	{
+		g_Calls.clear();
+		palette.beginFrame();
+		vector<glm::mat4> matrices = makePalette(frame);
+		vector<unsigned int> bases(draws[frame]);
+		for (unsigned int d = 0; d < draws[frame]; d++)
+			CHECK(palette.write(&matrices[0], matrices.size(), PaletteFormat::MAT4, bases[d]));
+		palette.endFrame();
+
+		unsigned int waits = frame >= StreamBuffer::REGIONS ? 1 : 0;
+		CHECK(g_Calls["glBindBufferRange"] == 1);
+		CHECK(g_Calls["glFenceSync"] == 1);
+		CHECK(g_Calls["glClientWaitSync"] == waits);
+		CHECK(g_Calls["glDeleteSync"] == waits);
+		CHECK(getTotalCalls() == 2 + 2 * waits);
+
+		CHECK(g_BoundOffset == (GLintptr)((frame + 1) % StreamBuffer::REGIONS * regionSize));
+		CHECK(g_BoundSize == regionSize);
+		CHECK(palette.getPalettes() == draws[frame]);
+		CHECK(palette.getMatrices() == draws[frame] * matrices.size());
+		//each draw finds its palette at its base in the bound range
+		for (unsigned int d = 0; d < draws[frame]; d++)
+		{
+			CHECK(bases[d] == d * matrices.size());
+			const unsigned char *written = &g_Storage[g_BoundOffset + bases[d] * sizeof(glm::mat4)];
+			CHECK(memcmp(written, &matrices[0], matrices.size() * sizeof(glm::mat4)) == 0);
+		}
+	}
+}
+
+static void testCompactFormats(BonePalette &palette)
+{
+	palette.beginFrame();
+	vector<glm::mat4> matrices = makePalette(3);
+	unsigned int base = 0;
+	CHECK(palette.write(&matrices[0], matrices.size(), PaletteFormat::MAT3X4, base));
+	const float *rows = reinterpret_cast<const float*>(&g_Storage[g_BoundOffset + base * BonePalette::getStride(PaletteFormat::MAT3X4)]);
+	for (unsigned int i = 0; i < matrices.size(); i++, rows += 12)
+		for (unsigned int row = 0; row < 3; row++)
+			for (unsigned int column = 0; column < 4; column++)
+				CHECK(rows[row * 4 + column] == matrices[i][column][row]);
+	CHECK(palette.getBytes() == matrices.size() * 12 * sizeof(float));
+	palette.endFrame();
+}
+
+static void testOverflow(BonePalette &palette)
+{
+	palette.beginFrame();
+	vector<glm::mat4> matrices = makePalette(4);
+	unsigned int base = 0;
+	unsigned int fitted = 0;
+	while (palette.write(&matrices[0], matrices.size(), PaletteFormat::MAT4, base))
+		fitted++;
+	CHECK(fitted == g_Storage.size() / StreamBuffer::REGIONS / (matrices.size() * sizeof(glm::mat4)));
+	CHECK(palette.getOverflows() == 1);
+	palette.endFrame();
+}
+
+int main()
+{
+	installRecorders();
+	BonePalette &palette = BonePalette::get();
+	testInit(palette);
+	testCallsPerFrame(palette);
+	testCompactFormats(palette);
+	testOverflow(palette);
+	return finishTest("BonePaletteTest");
+}
\ No newline at end of file
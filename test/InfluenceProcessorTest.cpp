@@ -0,0 +1,84 @@
+#include "InfluenceProcessor.hpp"
+#include "TestCheck.hpp"
+
+#include <map>
+
+using std::string;
+
+/**
+@file
+@brief Feeds InfluenceProcessor meshes built by hand: the threshold against the whole weight of a vertex,
+renormalization of what is kept and weights on bones past MAX_BONES
+*/
+
+/**@brief A mesh of @param numVertices vertices whose bones are added with addWeight. Owns the bones like the assimp importer does*/
+class TestMesh
+{
+public:
+	TestMesh(unsigned int numVertices)
+	{
+		m_Mesh.mNumVertices = numVertices;
+		m_Mesh.mNumBones = 0;
+		m_Mesh.mBones = new aiBone*[MAX_TEST_BONES];
+	}
+
+	/**@brief Weight @param vertex to bone @param boneId by @param weight. Every call makes a new bone*/
+	void addWeight(unsigned int vertex, unsigned int boneId, float weight)
+	{
+		aiBone *bone = new aiBone();
+		string name = "bone" + std::to_string(m_Mesh.mNumBones);
+		bone->mName = aiString(name.c_str());
+		bone->mNumWeights = 1;
+		bone->mWeights = new aiVertexWeight[1];
+		bone->mWeights[0] = aiVertexWeight(vertex, weight);
+		m_Mesh.mBones[m_Mesh.mNumBones++] = bone;
+		m_BoneIds[name] = boneId;
+	}
+
+	aiMesh m_Mesh;
+	std::map<string, unsigned int> m_BoneIds;
+private:
+	static const unsigned int MAX_TEST_BONES = 32;
+};
+
+int main()
+{
+	TestMesh mesh(3);
+	//vertex 0: seven weights, the 0.1 ones are below 11% of the whole vertex but above 11% of the four largest
+	mesh.addWeight(0, 1, 0.3f);
+	mesh.addWeight(0, 2, 0.2f);
+	for (unsigned int i = 0; i < 5; i++)
+		mesh.addWeight(0, 10 + i, 0.1f);
+	//vertex 1: the heaviest weight is on a bone that has no palette slot
+	mesh.addWeight(1, MAX_BONES, 0.5f);
+	mesh.addWeight(1, 3, 0.3f);
+	mesh.addWeight(1, 4, 0.2f);
+	//vertex 2: only on such bones
+	mesh.addWeight(2, MAX_BONES + 7, 1.0f);
+
+	InfluenceProcessor processor;
+	processor.setThreshold(0.11f);
+	processor.process(&mesh.m_Mesh, mesh.m_BoneIds);
+
+	CHECK(processor.getIndices(0) == glm::uvec4(1, 2, 0, 0));
+	CHECK_NEAR(processor.getWeights(0).x, 0.6f, 1e-6f);
+	CHECK_NEAR(processor.getWeights(0).y, 0.4f, 1e-6f);
+	CHECK(processor.getWeights(0).z == 0.0f && processor.getWeights(0).w == 0.0f);
+
+	CHECK(processor.getIndices(1) == glm::uvec4(3, 4, 0, 0));
+	CHECK_NEAR(processor.getWeights(1).x, 0.6f, 1e-6f);
+	CHECK_NEAR(processor.getWeights(1).y, 0.4f, 1e-6f);
+
+	CHECK(processor.getIndices(2) == glm::uvec4(0, 0, 0, 0));
+	CHECK(processor.getWeights(2) == glm::vec4(0.0f));
+
+	for (unsigned int v = 0; v < 3; v++)
+	{
+		for (unsigned int i = 0; i < InfluenceProcessor::MAX_INFLUENCES; i++)
+			CHECK(processor.getIndices(v)[i] < MAX_BONES);
+	}
+	CHECK(processor.getVertexCount(2) == 2);
+	CHECK(processor.getVertexCount(0) == 1);
+	CHECK(processor.getPruned() == 5 + 1 + 1);
+	return finishTest("InfluenceProcessorTest");
+}
\ No newline at end of file
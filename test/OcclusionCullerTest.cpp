@@ -0,0 +1,135 @@
+#include "OcclusionCuller.hpp"
+#include "TestCheck.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using std::vector;
+
+static const unsigned int WIDTH = 256;
+static const unsigned int HEIGHT = 128;
+
+/**@brief Camera at the origin looking down -z*/
+static glm::mat4 getViewProjection()
+{
+	return glm::perspective(glm::radians(45.0f), (float)WIDTH / HEIGHT, 0.1f, 100.0f) * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+/**@brief A 4 by 2 wall at z = -5, facing the camera*/
+static void addWall(OcclusionCuller &culler)
+{
+	glm::vec3 positions[4] = { glm::vec3(-2.0f, -1.0f, -5.0f), glm::vec3(2.0f, -1.0f, -5.0f), glm::vec3(2.0f, 1.0f, -5.0f), glm::vec3(-2.0f, 1.0f, -5.0f) };
+	GLuint indices[6] = { 0, 1, 2, 0, 2, 3 };
+	culler.addOccluder(positions, sizeof(glm::vec3), 4, indices, 6, glm::mat4(1.0f));
+}
+
+/**@brief Triangles spread over the screen at random depths, some crossing each other and the borders*/
+static void addClutter(OcclusionCuller &culler)
+{
+	vector<glm::vec3> positions;
+	vector<GLuint> indices;
+	unsigned int seed = 12345;
+	for (unsigned int i = 0; i < 3 * 200; i++)
+	{
+		float random[3];
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			random[k] = (seed >> 8) / float(1 << 24);
+		}
+		float depth = 3.0f + random[2] * 30.0f;
+		positions.push_back(glm::vec3((random[0] * 2.4f - 1.2f) * depth, (random[1] * 1.2f - 0.6f) * depth, -depth));
+		indices.push_back(i);
+	}
+	culler.addOccluder(&positions[0], sizeof(glm::vec3), positions.size(), &indices[0], indices.size(), glm::mat4(1.0f));
+}
+
+static vector<float> getDepths(const OcclusionCuller &culler)
+{
+	vector<float> depths;
+	for (unsigned int y = 0; y < culler.getHeight(); y++)
+		for (unsigned int x = 0; x < culler.getWidth(); x++)
+			depths.push_back(culler.getDepth(x, y));
+	return depths;
+}
+
+static void testWallDepth(OcclusionCuller &culler)
+{
+	glm::mat4 viewProjection = getViewProjection();
+	culler.beginFrame(viewProjection);
+	addWall(culler);
+	culler.rasterize(false);
+	CHECK(culler.getTriangles() == 2);
+
+	glm::vec4 center = viewProjection * glm::vec4(0.0f, 0.0f, -5.0f, 1.0f);
+	CHECK_NEAR(culler.getDepth(WIDTH / 2, HEIGHT / 2), center.z / center.w * 0.5f + 0.5f, 1e-4f);
+	CHECK(culler.getDepth(0, 0) == 1.0f);
+	CHECK(culler.getDepth(WIDTH - 1, HEIGHT - 1) == 1.0f);
+
+	//the covered area follows the projected size of the wall
+	glm::vec4 corner = viewProjection * glm::vec4(2.0f, 1.0f, -5.0f, 1.0f);
+	float expected = (corner.x / corner.w * WIDTH) * (corner.y / corner.w * HEIGHT);
+	unsigned int covered = 0;
+	for (unsigned int y = 0; y < HEIGHT; y++)
+		for (unsigned int x = 0; x < WIDTH; x++)
+			covered += culler.getDepth(x, y) < 1.0f;
+	CHECK_NEAR((float)covered, expected, expected * 0.05f);
+}
+
+static void testBoxes(OcclusionCuller &culler)
+{
+	culler.beginFrame(getViewProjection());
+	addWall(culler);
+	culler.rasterize(false);
+
+	CHECK(culler.isOccluded(glm::vec3(-0.5f, -0.5f, -10.0f), glm::vec3(0.5f, 0.5f, -9.0f)));
+	CHECK(!culler.isOccluded(glm::vec3(-0.5f, -0.5f, -4.0f), glm::vec3(0.5f, 0.5f, -3.0f)));
+	//behind the wall but sticking out of its side
+	CHECK(!culler.isOccluded(glm::vec3(3.0f, -0.5f, -10.0f), glm::vec3(5.0f, 0.5f, -9.0f)));
+	//crossing the wall
+	CHECK(!culler.isOccluded(glm::vec3(-0.5f, -0.5f, -6.0f), glm::vec3(0.5f, 0.5f, -4.0f)));
+	//straddling the near plane and entirely behind the camera
+	CHECK(!culler.isOccluded(glm::vec3(-0.5f, -0.5f, -10.0f), glm::vec3(0.5f, 0.5f, 1.0f)));
+	CHECK(!culler.isOccluded(glm::vec3(-0.5f, -0.5f, 2.0f), glm::vec3(0.5f, 0.5f, 3.0f)));
+	//off screen
+	CHECK(!culler.isOccluded(glm::vec3(20.0f, -0.5f, -10.0f), glm::vec3(21.0f, 0.5f, -9.0f)));
+	CHECK(!culler.isOccluded(glm::vec3(-0.5f, 20.0f, -10.0f), glm::vec3(0.5f, 21.0f, -9.0f)));
+
+	CHECK(culler.getTested() == 8);
+	CHECK(culler.getOccluded() == 1);
+}
+
+static void testPathsAgree(OcclusionCuller &culler)
+{
+	culler.beginFrame(getViewProjection());
+	addWall(culler);
+	addClutter(culler);
+
+	culler.setSimdLevel(SimdLevel::SCALAR);
+	culler.rasterize(false);
+	vector<float> scalar = getDepths(culler);
+	//the same pixels, the same depths
+	culler.setSimdLevel(SimdLevel::SSE2);
+	culler.rasterize(false);
+	CHECK(getDepths(culler) == scalar);
+	culler.rasterize(true);
+	CHECK(getDepths(culler) == scalar);
+
+	unsigned int covered = 0;
+	for (unsigned int i = 0; i < scalar.size(); i++)
+		covered += scalar[i] < 1.0f;
+	CHECK(covered > scalar.size() / 4);
+	culler.setSimdLevel(getSimdLevel());
+}
+
+int main()
+{
+	OcclusionCuller &culler = OcclusionCuller::get();
+	culler.init(WIDTH, HEIGHT);
+	CHECK(culler.getWidth() == WIDTH && culler.getHeight() == HEIGHT);
+	WorkerPool::get().setNumWorkers(3);
+
+	testWallDepth(culler);
+	testBoxes(culler);
+	testPathsAgree(culler);
+	return finishTest("OcclusionCullerTest");
+}
\ No newline at end of file
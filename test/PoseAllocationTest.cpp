@@ -0,0 +1,109 @@
+#include "Animation.hpp"
+#include "PoseKernel.hpp"
+#include "TestAnimation.hpp"
+#include "TestCheck.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using std::vector;
+
+/**
+@file
+@brief Counts the heap allocations of a frame of the per character pose work once the buffers have been sized.
+Every operator new of the process goes through the counters below
+*/
+
+static unsigned long g_Allocations = 0;
+
+void* operator new(size_t size)
+{
+	g_Allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	free(memory);
+}
+
+static const unsigned int NUM_BONES = 60;
+static const unsigned int NUM_CHARACTERS = 32;
+static const unsigned int NUM_KEYS = 24;
+
+/**@brief What a character keeps from frame to frame*/
+struct Character
+{
+	AnimCursor m_SparseCursor;
+	AnimCursor m_CompressedCursor;
+	BoneArray<SQTTransform> m_Local;
+	BoneArray<SQTTransform> m_Blended;
+	BoneArray<SQTTransform> m_Dense;
+	PoseBuffer m_From;
+	PoseBuffer m_To;
+	PoseBuffer m_Result;
+};
+
+/**@brief The pose work of every character for a frame at @param time: the three storages sampled, the dense one into both pose types, blended and stored back*/
+static void runFrame(vector<Character> &characters, const Animation &sparse, const Animation &compressed, const Animation &dense, double time)
+{
+	for (unsigned int c = 0; c < characters.size(); c++)
+	{
+		Character &character = characters[c];
+		double characterTime = time + 0.05 * c;
+		sparse.getTransforms(characterTime, character.m_Local, &character.m_SparseCursor, AnimStorage::SPARSE);
+		compressed.getTransforms(characterTime, character.m_From, &character.m_CompressedCursor, AnimStorage::SPARSE);
+		dense.getTransforms(characterTime, character.m_To, NULL, AnimStorage::DENSE);
+		dense.getTransforms(characterTime, character.m_Dense, NULL, AnimStorage::DENSE);
+		PoseKernel::get().blend(character.m_From, character.m_To, 0.4f, character.m_Result);
+		character.m_Result.store(character.m_Blended);
+		character.m_From.load(character.m_Local);
+	}
+}
+
+int main()
+{
+	Animation sparse, compressed, dense;
+	buildTestAnimation(sparse, NUM_BONES, NUM_KEYS);
+	buildTestAnimation(compressed, NUM_BONES, NUM_KEYS);
+	CompressionTolerance tolerance;
+	tolerance.m_Position = tolerance.m_Rotation = tolerance.m_Scale = 0.001f;
+	compressed.compress(tolerance);
+	buildTestAnimation(dense, NUM_BONES, NUM_KEYS);
+	dense.resample(1);
+	PoseKernel::get();
+
+	vector<Character> characters(NUM_CHARACTERS);
+	//the first frame sizes the cursors and the pose buffers
+	runFrame(characters, sparse, compressed, dense, 0.0);
+
+	g_Allocations = 0;
+	for (unsigned int frame = 1; frame <= 120; frame++)
+		runFrame(characters, sparse, compressed, dense, frame / 60.0);
+	if (g_Allocations)
+		printf("%lu allocations in 120 frames of %u characters\n", g_Allocations, NUM_CHARACTERS);
+	CHECK(g_Allocations == 0);
+
+	//the dense frames sampled into either pose type give the same bones
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		glm::mat4 fromBuffer = characters[0].m_To.getBone(b).getMatrix();
+		glm::mat4 fromArray = characters[0].m_Dense[b].getMatrix();
+		for (unsigned int c = 0; c < 4; c++)
+			CHECK_NEAR(glm::length(fromBuffer[c] - fromArray[c]), 0.0f, 1e-6f);
+	}
+	return finishTest("PoseAllocationTest");
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "PoseKernel.hpp"
+#include "SimdDispatch.hpp"
+#include "TestCheck.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+using std::vector;
+
+static const unsigned int NUM_BONES = 60;
+
+static unsigned int g_Seed = 4321;
+
+static float random(float min, float max)
+{
+	g_Seed = g_Seed * 1664525 + 1013904223;
+	return min + (max - min) * ((g_Seed >> 8) / float(1 << 24));
+}
+
+/**@brief A pose with random scales, positions and unit rotations. Half of the rotations point away from @param reference
+	so the kernels have to take the shortest path*/
+static void randomPose(PoseBuffer &pose, const PoseBuffer *reference)
+{
+	pose.resize(NUM_BONES);
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		glm::quat rotation = glm::normalize(glm::quat(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+		if (reference && (glm::dot(rotation, reference->getBone(b).getOrientation()) > 0.0f) == (b % 2 == 0))
+			rotation = -rotation;
+		glm::vec3 scale(random(0.5f, 2.0f), random(0.5f, 2.0f), random(0.5f, 2.0f));
+		glm::vec3 position(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(-10.0f, 10.0f));
+		pose.setBone(b, SQTTransform(position, scale, rotation));
+	}
+}
+
+/**@brief Largest difference between the floats of @param a and @param b*/
+static float getMaxDifference(const vector<float> &a, const vector<float> &b)
+{
+	float difference = 0.0f;
+	for (unsigned int i = 0; i < a.size(); i++)
+		difference = std::max(difference, std::abs(a[i] - b[i]));
+	return difference;
+}
+
+static void testPathsAgree(const PoseBuffer &from, const PoseBuffer &to)
+{
+	float factors[5] = { 0.0f, 0.25f, 0.5f, 0.9f, 1.0f };
+	for (unsigned int f = 0; f < 5; f++)
+	{
+		PoseBuffer scalar, simd;
+		scalar.resize(NUM_BONES);
+		simd.resize(NUM_BONES);
+		PoseKernel::blendScalar(&from.m_Data[0], &to.m_Data[0], factors[f], &scalar.m_Data[0], from.m_Stride);
+#ifdef SIMD_X86
+		PoseKernel::blendSSE2(&from.m_Data[0], &to.m_Data[0], factors[f], &simd.m_Data[0], from.m_Stride);
+		CHECK(getMaxDifference(simd.m_Data, scalar.m_Data) <= 1e-5f);
+		if (supportsAVX2())
+		{
+			PoseKernel::blendAVX2(&from.m_Data[0], &to.m_Data[0], factors[f], &simd.m_Data[0], from.m_Stride);
+			CHECK(getMaxDifference(simd.m_Data, scalar.m_Data) <= 1e-5f);
+		}
+#endif
+		PoseKernel::get().blend(from, to, factors[f], simd);
+		CHECK(getMaxDifference(simd.m_Data, scalar.m_Data) <= 1e-5f);
+	}
+}
+
+/**@brief The corrected nlerp stays within 0.002 radians of slerp, scales and positions are lerped and the padding stays identity*/
+static void testAgainstSlerp(const PoseBuffer &from, const PoseBuffer &to)
+{
+	PoseBuffer result;
+	for (float factor = 0.0f; factor <= 1.0f; factor += 0.125f)
+	{
+		PoseKernel::get().blend(from, to, factor, result);
+		for (unsigned int b = 0; b < NUM_BONES; b++)
+		{
+			SQTTransform a = from.getBone(b), c = to.getBone(b), blended = result.getBone(b);
+			glm::quat target = c.getOrientation();
+			if (glm::dot(a.getOrientation(), target) < 0.0f)
+				target = -target;
+			glm::quat expected = glm::slerp(a.getOrientation(), target, factor);
+			float cosHalfAngle = std::min(std::abs(glm::dot(expected, blended.getOrientation())), 1.0f);
+			CHECK(2.0f * acos(cosHalfAngle) <= 0.002f);
+			CHECK(glm::length(blended.getPosition() - glm::mix(a.getPosition(), c.getPosition(), factor)) <= 1e-4f);
+			CHECK(glm::length(blended.getScale() - glm::mix(a.getScale(), c.getScale(), factor)) <= 1e-5f);
+		}
+		for (unsigned int b = NUM_BONES; b < result.m_Stride; b++)
+			CHECK(result.getBone(b).getOrientation() == glm::quat() && result.getBone(b).getScale() == glm::vec3(1.0f));
+	}
+}
+
+int main()
+{
+	PoseBuffer from, to;
+	randomPose(from, NULL);
+	randomPose(to, &from);
+	CHECK(from.m_Stride % POSE_BONE_ALIGNMENT == 0 && from.m_Stride >= NUM_BONES);
+
+	testPathsAgree(from, to);
+	testAgainstSlerp(from, to);
+	return finishTest("PoseKernelTest");
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "SkinningKernel.hpp"
+#include "SimdDispatch.hpp"
+#include "Model.hpp"
+#include "TestCheck.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+using std::vector;
+
+static const unsigned int NUM_BONES = 60;
+//more than one pool chunk, one that is not a multiple of the chunk size and an empty one
+static const unsigned int NUM_MESHES = 3;
+static const unsigned int MESH_SIZES[NUM_MESHES] = { 5000, 37, 0 };
+
+static unsigned int g_Seed = 8765;
+
+static float random(float min, float max)
+{
+	g_Seed = g_Seed * 1664525 + 1013904223;
+	return min + (max - min) * ((g_Seed >> 8) / float(1 << 24));
+}
+
+/**@brief A SkinnedModel made of meshes of vertices only, built without a model file or a gpu*/
+class TestModel
+	: public SkinnedModel
+{
+public:
+	TestModel()
+		:SkinnedModel("test")
+	{
+
+	}
+
+	~TestModel()
+	{
+		//the meshes never got gpu buffers so Mesh::destroy must not run on them. Left to the process exit
+		m_Meshes.clear();
+	}
+
+	void addMesh(const vector<SkinnedVertex> &vertices)
+	{
+		SkinnedMesh *mesh = new SkinnedMesh;
+		mesh->m_SkinnedVertices = vertices;
+		m_Meshes.push_back(mesh);
+	}
+};
+
+/**@brief Bone matrices with random rotations, scales and translations*/
+static void randomPalette(BoneArray<glm::mat4> &palette)
+{
+	palette.assign(NUM_BONES, glm::mat4());
+	for (unsigned int b = 0; b < NUM_BONES; b++)
+	{
+		glm::quat rotation = glm::normalize(glm::quat(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+		glm::vec3 scale(random(0.5f, 2.0f), random(0.5f, 2.0f), random(0.5f, 2.0f));
+		glm::vec3 position(random(-10.0f, 10.0f), random(-10.0f, 10.0f), random(-10.0f, 10.0f));
+		palette[b] = glm::translate(glm::mat4(), position) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(), scale);
+	}
+}
+
+/**@brief Vertices with 1 to 4 influences on random bones, weights summing up to one like InfluenceProcessor leaves them*/
+static void randomVertices(vector<SkinnedVertex> &vertices, unsigned int count)
+{
+	vertices.clear();
+	for (unsigned int v = 0; v < count; v++)
+	{
+		Vertex base(glm::vec3(random(-2.0f, 2.0f), random(-2.0f, 2.0f), random(-2.0f, 2.0f)));
+		base.m_Normal = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)));
+		SkinnedVertex vertex(base);
+		unsigned int numInfluences = 1 + v % 4;
+		float total = 0.0f;
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			vertex.m_BoneIndices[k] = k < numInfluences ? static_cast<unsigned int>(random(0.0f, float(NUM_BONES))) : 0;
+			vertex.m_BoneWeights[k] = k < numInfluences ? random(0.1f, 1.0f) : 0.0f;
+			total += vertex.m_BoneWeights[k];
+		}
+		vertex.m_BoneWeights /= total;
+		vertices.push_back(vertex);
+	}
+}
+
+/**@brief What skinningVS.glsl computes, written with glm*/
+static void skinReference(const SkinnedVertex &vertex, const BoneArray<glm::mat4> &palette, glm::vec3 &position, glm::vec3 &normal)
+{
+	glm::mat4 blended = palette[vertex.m_BoneIndices[0]] * vertex.m_BoneWeights[0] + palette[vertex.m_BoneIndices[1]] * vertex.m_BoneWeights[1]
+		+ palette[vertex.m_BoneIndices[2]] * vertex.m_BoneWeights[2] + palette[vertex.m_BoneIndices[3]] * vertex.m_BoneWeights[3];
+	position = glm::vec3(blended * glm::vec4(vertex.m_Position, 1.0f));
+	normal = glm::vec3(blended * glm::vec4(vertex.m_Normal, 0.0f));
+}
+
+/**@brief @param function skins @param vertices to within float rounding of the reference*/
+static void checkPath(SkinningKernel::SkinFunction function, const vector<SkinnedVertex> &vertices, const BoneArray<glm::mat4> &palette)
+{
+	vector<glm::vec3> positions(vertices.size()), normals(vertices.size());
+	function(&vertices[0], vertices.size(), palette.data(), &positions[0], &normals[0]);
+	for (unsigned int v = 0; v < vertices.size(); v++)
+	{
+		glm::vec3 position, normal;
+		skinReference(vertices[v], palette, position, normal);
+		CHECK(glm::length(positions[v] - position) <= 1e-4f * (1.0f + glm::length(position)));
+		CHECK(glm::length(normals[v] - normal) <= 1e-4f * (1.0f + glm::length(normal)));
+	}
+}
+
+static void testPathsAgainstReference(const vector<SkinnedVertex> &vertices, const BoneArray<glm::mat4> &palette)
+{
+	checkPath(&SkinningKernel::skinScalar, vertices, palette);
+#ifdef SIMD_X86
+	checkPath(&SkinningKernel::skinSSE, vertices, palette);
+	if (supportsAVX2())
+		checkPath(&SkinningKernel::skinAVX2, vertices, palette);
+#endif
+}
+
+/**@brief The model split in chunks over the WorkerPool comes out exactly as skinned on the calling thread*/
+static void testPooledAgainstSerial(const BoneArray<glm::mat4> &palette)
+{
+	TestModel model;
+	vector<SkinnedVertex> vertices;
+	for (unsigned int m = 0; m < NUM_MESHES; m++)
+	{
+		randomVertices(vertices, MESH_SIZES[m]);
+		model.addMesh(vertices);
+	}
+
+	SkinnedBuffer serial, pooled;
+	SkinningKernel::get().skin(model, palette, serial, false);
+	SkinningKernel::get().skin(model, palette, pooled, true);
+	CHECK(serial.m_MeshOffsets == pooled.m_MeshOffsets);
+	CHECK(serial.m_MeshOffsets.size() == NUM_MESHES + 1 && serial.m_MeshOffsets[NUM_MESHES] == MESH_SIZES[0] + MESH_SIZES[1] + MESH_SIZES[2]);
+	CHECK(serial.m_Positions == pooled.m_Positions);
+	CHECK(serial.m_Normals == pooled.m_Normals);
+
+	//and the serial model path is the selected kernel on every mesh
+	const vector<SkinnedVertex> &first = static_cast<const SkinnedMesh*>(model.m_Meshes[0])->m_SkinnedVertices;
+	vector<glm::vec3> positions(first.size()), normals(first.size());
+	SkinningKernel::get().skin(&first[0], first.size(), palette.data(), &positions[0], &normals[0]);
+	CHECK(vector<glm::vec3>(serial.m_Positions.begin(), serial.m_Positions.begin() + first.size()) == positions);
+}
+
+int main()
+{
+	BoneArray<glm::mat4> palette;
+	randomPalette(palette);
+	vector<SkinnedVertex> vertices;
+	randomVertices(vertices, 1000);
+	WorkerPool::get().setNumWorkers(3);
+
+	testPathsAgainstReference(vertices, palette);
+	testPooledAgainstSerial(palette);
+	return finishTest("SkinningKernelTest");
+}
\ No newline at end of file
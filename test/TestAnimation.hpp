@@ -0,0 +1,41 @@
+#pragma once
+#include "Animation.hpp"
+
+#include <cmath>
+
+/**
+@file
+@brief Synthetic animations for the tests and the benchmark, so they need no model files
+*/
+
+/**@brief Build @param anim with @param numBones bones and @param numKeys keys per channel spread over 100 ticks, played at 25 ticks per second.
+	Every bone moves and rotates differently. @param travel is how far along x the bones move over the clip on top of that, for wide position ranges*/
+inline void buildTestAnimation(Animation &anim, unsigned int numBones, unsigned int numKeys, float travel = 0.0f)
+{
+	std::vector<BoneAnim> boneAnims(numBones);
+	std::vector<const BoneAnim*> channels(numBones);
+	BoneArray<SQTTransform> bindPose;
+	bindPose.assign(numBones, SQTTransform());
+	for (unsigned int b = 0; b < numBones; b++)
+	{
+		BoneAnim &boneAnim = boneAnims[b];
+		for (unsigned int k = 0; k < numKeys; k++)
+		{
+			double time = 100.0 * k / (numKeys - 1);
+			float phase = 0.1f * b + 0.3f * k;
+			ScaleKey scale = { time, glm::vec3(1.0f) };
+			PositionKey position = { time, glm::vec3(sin(phase) + travel * k / (numKeys - 1), cos(phase), 0.1f * b) };
+			RotationKey rotation = { time, glm::angleAxis(phase, glm::normalize(glm::vec3(1.0f, float(b % 3), 1.0f))) };
+			boneAnim.m_ScaleKeys.push_back(scale);
+			boneAnim.m_PositionKeys.push_back(position);
+			boneAnim.m_RotationKeys.push_back(rotation);
+		}
+		boneAnim.m_NumScaleKeys = boneAnim.m_NumPositionKeys = boneAnim.m_NumRotationKeys = numKeys;
+		channels[b] = &boneAnim;
+	}
+	anim.m_NumBones = numBones;
+	anim.m_TotalTicks = 100.0f;
+	anim.m_TicksPerSecond = 25.0f;
+	anim.m_TotalDuration = anim.m_TotalTicks / anim.m_TicksPerSecond;
+	anim.m_Clip.compile(channels, bindPose);
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdio>
+#include <cmath>
+
+/**
+@file
+@brief What the tests share. A test is an executable built from the sources it exercises whose main returns finishTest:
+non zero if any CHECK failed, which is what ctest looks at
+*/
+
+static unsigned int g_TestFailures = 0;
+
+/**@brief Count and print @param condition if it does not hold. The test goes on*/
+#define CHECK(condition) \
+	do { if (!(condition)) { printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); g_TestFailures++; } } while (false)
+
+/**@brief CHECK that @param a and @param b are no more than @param tolerance apart*/
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::abs((a) - (b)) <= (tolerance))
+
+/**@brief Print the outcome of test @param name. Return it from main*/
+inline int finishTest(const char *name)
+{
+	if (g_TestFailures)
+		printf("%s : %u checks failed\n", name, g_TestFailures);
+	else
+		printf("%s : passed\n", name);
+	return g_TestFailures ? 1 : 0;
+}
\ No newline at end of file